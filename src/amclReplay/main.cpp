@@ -0,0 +1,537 @@
+/*
+* Copyright (C) 2006-2020 Istituto Italiano di Tecnologia (IIT)
+* All rights reserved.
+*
+* This software may be modified and distributed under the terms of the
+* BSD-3-Clause license. See the accompanying LICENSE file for details.
+*/
+
+/**
+ * \section amclReplay
+ * Offline replay of the amclLocalizer particle filter.
+ * It reads the laser scans and the odometry recorded by yarpdatadumper, and feeds
+ * them into the same pf / AMCLOdom / AMCLLaser stack used by amclLocalizer, as fast
+ * as possible. At the end it prints the time spent in each stage of the filter
+ * (action, sensor, resample, cluster), the CPU time per update and, if a reference
+ * track is available, the error of the estimated pose.
+ *
+ * Usage:
+ * amclReplay --from amclLocalizer.ini --map map.map --laser_log laser/data.log --odometry_log odometry/data.log
+ *            [--reference_log reference/data.log] [--output poses.txt] [--use_tx_time]
+ *
+ * The configuration file uses the [AMCL], [INITIAL_POS] and [LASER] groups of amclLocalizer.
+ * The reference log holds "x y theta_deg" poses (optionally preceded by the map name),
+ * e.g. the output of gazeboLocalizer.
+ */
+
+#include <yarp/os/Network.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/dev/MapGrid2D.h>
+#include <math.h>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "amcl/map/map.h"
+#include "amcl/pf/pf.h"
+#include "amcl/sensors/amcl_odom.h"
+#include "amcl/sensors/amcl_laser.h"
+#include "amclMapConversion.h"
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::dev::Nav2D;
+using namespace amcl;
+
+YARP_LOG_COMPONENT(AMCL_REPLAY, "navigation.amclReplay")
+
+#ifndef DEG2RAD
+#define DEG2RAD M_PI/180
+#endif
+#ifndef RAD2DEG
+#define RAD2DEG 180/M_PI
+#endif
+
+struct pose_sample_t
+{
+    double t;
+    double x;
+    double y;
+    double theta; //degrees
+};
+
+struct scan_sample_t
+{
+    double t;
+    double angle_min; //degrees
+    double angle_max; //degrees
+    double range_min;
+    double range_max;
+    vector<double> ranges;
+};
+
+// Statistics of a stage of the filter
+struct stage_stats_t
+{
+    const char* name;
+    size_t count = 0;
+    double total = 0;
+    double max = 0;
+    void add(double dt) { count++; total += dt; max = std::max(max, dt); }
+};
+
+static double angle_diff(double a, double b)
+{
+    double d = fmod(a - b + 3 * M_PI, 2 * M_PI) - M_PI;
+    return d;
+}
+
+static double now_s()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Each line of a yarpdatadumper log is: <counter> <time> [<tx time>] <data>
+static bool parse_log_line(const string& line, bool use_tx_time, double& t, Bottle& data)
+{
+    Bottle b;
+    b.fromString(line);
+    size_t first = use_tx_time ? 3 : 2;
+    if (b.size() <= first)
+    {
+        return false;
+    }
+    t = b.get(use_tx_time ? 2 : 1).asFloat64();
+    data.clear();
+    for (size_t i = first; i < b.size(); i++)
+    {
+        data.add(b.get(i));
+    }
+    return true;
+}
+
+// The first three numbers of the data, skipping an optional map name:
+// works with Map2DLocation and with OdometryData (x y theta first)
+static bool parse_pose(const Bottle& data, pose_sample_t& p)
+{
+    size_t i = (data.size() > 0 && data.get(0).isString()) ? 1 : 0;
+    if (data.size() < i + 3)
+    {
+        return false;
+    }
+    p.x = data.get(i).asFloat64();
+    p.y = data.get(i + 1).asFloat64();
+    p.theta = data.get(i + 2).asFloat64();
+    return true;
+}
+
+// LaserScan2D: angle_min angle_max range_min range_max (scans) status
+static bool parse_scan(const Bottle& data, scan_sample_t& s)
+{
+    if (data.size() < 5 || data.get(4).isList() == false)
+    {
+        return false;
+    }
+    s.angle_min = data.get(0).asFloat64();
+    s.angle_max = data.get(1).asFloat64();
+    s.range_min = data.get(2).asFloat64();
+    s.range_max = data.get(3).asFloat64();
+    Bottle* r = data.get(4).asList();
+    s.ranges.resize(r->size());
+    for (size_t i = 0; i < r->size(); i++)
+    {
+        s.ranges[i] = r->get(i).asFloat64();
+    }
+    return s.ranges.empty() == false;
+}
+
+template <class T>
+static bool load_log(const string& filename, bool use_tx_time, bool (*parse)(const Bottle&, T&), vector<T>& samples)
+{
+    ifstream file(filename);
+    if (!file.is_open())
+    {
+        yCError(AMCL_REPLAY) << "Unable to open" << filename;
+        return false;
+    }
+    string line;
+    while (getline(file, line))
+    {
+        double t;
+        Bottle data;
+        T sample;
+        if (parse_log_line(line, use_tx_time, t, data) && parse(data, sample))
+        {
+            sample.t = t;
+            samples.push_back(sample);
+        }
+    }
+    sort(samples.begin(), samples.end(), [](const T& a, const T& b) { return a.t < b.t; });
+    yCInfo(AMCL_REPLAY) << samples.size() << "samples read from" << filename;
+    return samples.empty() == false;
+}
+
+// Linear interpolation of a track. False if t is outside the track.
+static bool interpolate(const vector<pose_sample_t>& track, double t, pose_sample_t& p)
+{
+    if (track.empty() || t < track.front().t || t > track.back().t)
+    {
+        return false;
+    }
+    auto next = lower_bound(track.begin(), track.end(), t, [](const pose_sample_t& s, double v) { return s.t < v; });
+    if (next == track.begin())
+    {
+        p = *next;
+        return true;
+    }
+    auto prev = next - 1;
+    double dt = next->t - prev->t;
+    double k = (dt > 0) ? (t - prev->t) / dt : 1.0;
+    p.t = t;
+    p.x = prev->x + k * (next->x - prev->x);
+    p.y = prev->y + k * (next->y - prev->y);
+    p.theta = prev->theta + k * angle_diff(next->theta * DEG2RAD, prev->theta * DEG2RAD) * RAD2DEG;
+    return true;
+}
+
+static pf_vector_t uniform_pose_generator(void* arg, pf_rng_t* rng)
+{
+    map_t* map = (map_t*)arg;
+    pf_vector_t p;
+    for (size_t k = 0; k < 10000; k++)
+    {
+        p.v[0] = map->origin_x + (pf_rng_uniform(rng) - 0.5) * map->size_x * map->scale;
+        p.v[1] = map->origin_y + (pf_rng_uniform(rng) - 0.5) * map->size_y * map->scale;
+        p.v[2] = pf_rng_uniform(rng) * 2 * M_PI - M_PI;
+        int i = MAP_GXWX(map, p.v[0]);
+        int j = MAP_GYWY(map, p.v[1]);
+        if (MAP_VALID(map, i, j) && map->cells[MAP_INDEX(map, i, j)].occ_state == -1)
+        {
+            break;
+        }
+    }
+    return p;
+}
+
+int main(int argc, char* argv[])
+{
+    Network::init(); //only for the logger and the resource finder, no ports are used
+
+    ResourceFinder rf;
+    rf.setDefaultConfigFile("amclLocalizer.ini");
+    rf.configure(argc, argv);
+
+    string map_file = rf.check("map", Value("")).asString();
+    string laser_log = rf.check("laser_log", Value("")).asString();
+    string odometry_log = rf.check("odometry_log", Value("")).asString();
+    string reference_log = rf.check("reference_log", Value("")).asString();
+    string output_file = rf.check("output", Value("")).asString();
+    bool use_tx_time = rf.check("use_tx_time");
+    if (map_file.empty() || laser_log.empty() || odometry_log.empty())
+    {
+        yCError(AMCL_REPLAY) << "Usage: amclReplay --from <amcl.ini> --map <file.map> --laser_log <log> --odometry_log <log> [--reference_log <log>] [--output <file>] [--use_tx_time]";
+        return 1;
+    }
+
+    //configuration, same keys and defaults of amclLocalizer
+    Bottle& amcl_group = rf.findGroup("AMCL");
+    Bottle& initial_group = rf.findGroup("INITIAL_POS");
+    Bottle& laser_group = rf.findGroup("LASER");
+    int min_particles = amcl_group.check("min_particles", Value(100)).asInt32();
+    int max_particles = amcl_group.check("max_particles", Value(5000)).asInt32();
+    double laser_min_range = amcl_group.check("laser_min_range", Value(-1.0)).asFloat64();
+    double laser_max_range = amcl_group.check("laser_max_range", Value(-1.0)).asFloat64();
+    double max_beams = amcl_group.check("laser_max_beams", Value(30)).asFloat64();
+    double z_hit = amcl_group.check("laser_z_hit", Value(0.95)).asFloat64();
+    double z_short = amcl_group.check("laser_z_short", Value(0.1)).asFloat64();
+    double z_max = amcl_group.check("laser_z_max", Value(0.05)).asFloat64();
+    double z_rand = amcl_group.check("laser_z_rand", Value(0.05)).asFloat64();
+    double sigma_hit = amcl_group.check("laser_sigma_hit", Value(0.2)).asFloat64();
+    double lambda_short = amcl_group.check("laser_lambda_short", Value(0.1)).asFloat64();
+    double likelihood_max_dist = amcl_group.check("laser_likelihood_max_dist", Value(2.0)).asFloat64();
+    int range_table_angles = amcl_group.check("laser_range_table_angles", Value(0)).asInt32();
+    string laser_model = amcl_group.check("laser_model_type", Value("likelihood_field")).asString();
+    string odom_model = amcl_group.check("odom_model_type", Value("diff")).asString();
+    double d_thresh = amcl_group.check("update_min_d", Value(0.2)).asFloat64();
+    double a_thresh = amcl_group.check("update_min_a", Value(M_PI / 6.0)).asFloat64();
+    int resample_interval = std::max(1, (int)amcl_group.check("resample_interval", Value(2)).asFloat64());
+    double alpha_slow = amcl_group.check("recovery_alpha_slow", Value(0.001)).asFloat64();
+    double alpha_fast = amcl_group.check("recovery_alpha_fast", Value(0.1)).asFloat64();
+    int rng_seed = amcl_group.check("rng_seed", Value(1)).asInt32();
+
+    //map
+    MapGrid2D yarp_map;
+    if (yarp_map.loadFromFile(map_file) == false)
+    {
+        yCError(AMCL_REPLAY) << "Unable to load map" << map_file;
+        return 1;
+    }
+    map_t* map = amclConvertMap(yarp_map);
+
+    //logs
+    vector<scan_sample_t> scans;
+    vector<pose_sample_t> odometry;
+    vector<pose_sample_t> reference;
+    if (!load_log(laser_log, use_tx_time, parse_scan, scans) ||
+        !load_log(odometry_log, use_tx_time, parse_pose, odometry))
+    {
+        return 1;
+    }
+    if (!reference_log.empty() && !load_log(reference_log, use_tx_time, parse_pose, reference))
+    {
+        return 1;
+    }
+
+    //filter
+    double t_start = now_s();
+    pf_t* pf = pf_alloc(min_particles, max_particles, alpha_slow, alpha_fast, uniform_pose_generator, (void*)map);
+    pf->pop_err = amcl_group.check("kld_err", Value(0.01)).asFloat64();
+    pf->pop_z = amcl_group.check("kld_z", Value(0.99)).asFloat64();
+    string resample_type = amcl_group.check("resample_type", Value("systematic")).asString();
+    pf->resample_type = (resample_type == "stratified") ? PF_RESAMPLE_STRATIFIED :
+                        (resample_type == "residual") ? PF_RESAMPLE_RESIDUAL : PF_RESAMPLE_SYSTEMATIC;
+    pf_set_seed(pf, rng_seed);
+
+    pf_vector_t init_mean = pf_vector_zero();
+    pf_matrix_t init_cov = pf_matrix_zero();
+    pose_sample_t init_pose;
+    if (initial_group.check("initial_x"))
+    {
+        init_mean.v[0] = initial_group.find("initial_x").asFloat64();
+        init_mean.v[1] = initial_group.find("initial_y").asFloat64();
+        init_mean.v[2] = initial_group.find("initial_theta").asFloat64() * DEG2RAD;
+    }
+    if (interpolate(reference, scans.front().t, init_pose) && !rf.check("ignore_reference_start"))
+    {
+        //the reference knows where the recording starts
+        init_mean.v[0] = init_pose.x;
+        init_mean.v[1] = init_pose.y;
+        init_mean.v[2] = init_pose.theta * DEG2RAD;
+    }
+    init_cov.m[0][0] = 0.25;
+    init_cov.m[1][1] = 0.25;
+    init_cov.m[2][2] = 0.06853891945200942;
+    pf_init(pf, init_mean, init_cov);
+
+    AMCLOdom odom_model_handler;
+    odom_model_t odom_type = (odom_model == "omni") ? ODOM_MODEL_OMNI :
+                             (odom_model == "diff-corrected") ? ODOM_MODEL_DIFF_CORRECTED :
+                             (odom_model == "omni-corrected") ? ODOM_MODEL_OMNI_CORRECTED : ODOM_MODEL_DIFF;
+    odom_model_handler.SetModel(odom_type,
+                                amcl_group.check("odom_alpha1", Value(0.2)).asFloat64(),
+                                amcl_group.check("odom_alpha2", Value(0.2)).asFloat64(),
+                                amcl_group.check("odom_alpha3", Value(0.2)).asFloat64(),
+                                amcl_group.check("odom_alpha4", Value(0.2)).asFloat64(),
+                                amcl_group.check("odom_alpha5", Value(0.2)).asFloat64());
+
+    AMCLLaser laser_model_handler((size_t)max_beams, map);
+    if (laser_model == "beam")
+    {
+        laser_model_handler.SetModelBeam(z_hit, z_short, z_max, z_rand, sigma_hit, lambda_short, 0.0, range_table_angles);
+    }
+    else if (laser_model == "likelihood_field_prob")
+    {
+        laser_model_handler.SetModelLikelihoodFieldProb(z_hit, z_rand, sigma_hit, likelihood_max_dist,
+            amcl_group.check("do_beamskip", Value(false)).asBool(),
+            amcl_group.check("beam_skip_distance", Value(0.5)).asFloat64(),
+            amcl_group.check("beam_skip_threshold", Value(0.3)).asFloat64(),
+            amcl_group.check("beam_skip_error_threshold", Value(0.9)).asFloat64());
+    }
+    else
+    {
+        laser_model_handler.SetModelLikelihoodField(z_hit, z_rand, sigma_hit, likelihood_max_dist);
+    }
+    pf_vector_t laser_pose = pf_vector_zero();
+    Bottle* laser_pose_list = laser_group.find("laser_pose").asList();
+    if (laser_pose_list && laser_pose_list->size() > 0)
+    {
+        Bottle* p = laser_pose_list->get(0).isList() ? laser_pose_list->get(0).asList() : laser_pose_list;
+        if (p->size() == 3)
+        {
+            laser_pose.v[0] = p->get(0).asFloat64();
+            laser_pose.v[1] = p->get(1).asFloat64();
+            laser_pose.v[2] = p->get(2).asFloat64() * DEG2RAD;
+        }
+    }
+    laser_model_handler.SetLaserPose(laser_pose);
+    double t_setup = now_s() - t_start;
+
+    //replay
+    stage_stats_t st_action; st_action.name = "action";
+    stage_stats_t st_sensor; st_sensor.name = "sensor";
+    stage_stats_t st_resample; st_resample.name = "resample";
+    stage_stats_t st_cluster; st_cluster.name = "cluster";
+    stage_stats_t st_cpu; st_cpu.name = "cpu/update";
+    size_t err_count = 0;
+    double err_sum2 = 0, err_max = 0, err_theta_sum2 = 0, err_theta_max = 0;
+    size_t particle_sum = 0;
+    ofstream out;
+    if (!output_file.empty())
+    {
+        out.open(output_file);
+    }
+
+    bool initialized = false;
+    pf_vector_t last_odom_pose = pf_vector_zero();
+    int resample_count = 0;
+    size_t updates = 0;
+    double t_replay_start = now_s();
+    for (const auto& scan : scans)
+    {
+        pose_sample_t o;
+        if (!interpolate(odometry, scan.t, o))
+        {
+            continue;
+        }
+        pf_vector_t pose;
+        pose.v[0] = o.x;
+        pose.v[1] = o.y;
+        pose.v[2] = o.theta * DEG2RAD;
+
+        bool update = false;
+        bool publish = false;
+        pf_vector_t delta = pf_vector_zero();
+        if (!initialized)
+        {
+            last_odom_pose = pose;
+            initialized = true;
+            update = true;
+            publish = true;
+        }
+        else
+        {
+            delta.v[0] = pose.v[0] - last_odom_pose.v[0];
+            delta.v[1] = pose.v[1] - last_odom_pose.v[1];
+            delta.v[2] = angle_diff(pose.v[2], last_odom_pose.v[2]);
+            update = fabs(delta.v[0]) > d_thresh || fabs(delta.v[1]) > d_thresh || fabs(delta.v[2]) > a_thresh;
+            if (!update)
+            {
+                continue;
+            }
+        }
+
+        std::clock_t cpu0 = std::clock();
+        double t0 = now_s();
+        if (updates > 0)
+        {
+            AMCLOdomData odata;
+            odata.pose = pose;
+            odata.delta = delta;
+            odom_model_handler.UpdateAction(pf, (AMCLSensorData*)&odata);
+        }
+        double t1 = now_s();
+
+        AMCLLaserData ldata;
+        ldata.sensor = &laser_model_handler;
+        ldata.range_count = (int)scan.ranges.size();
+        ldata.range_max = (laser_max_range > 0) ? std::min(scan.range_max, laser_max_range) : scan.range_max;
+        double range_min = (laser_min_range > 0) ? std::max(scan.range_min, laser_min_range) : scan.range_min;
+        double angle_min = scan.angle_min * DEG2RAD;
+        double angle_increment = (scan.angle_max - scan.angle_min) / scan.ranges.size() * DEG2RAD;
+        ldata.ranges = new double[ldata.range_count][2];
+        for (int i = 0; i < ldata.range_count; i++)
+        {
+            double rho = scan.ranges[i];
+            ldata.ranges[i][0] = (rho <= range_min || std::isfinite(rho) == false) ? ldata.range_max : rho;
+            ldata.ranges[i][1] = angle_min + i * angle_increment;
+        }
+        laser_model_handler.UpdateSensor(pf, (AMCLSensorData*)&ldata);
+        last_odom_pose = pose;
+        double t2 = now_s();
+
+        bool resampled = false;
+        if (!(++resample_count % resample_interval))
+        {
+            pf_update_resample_samples(pf);
+            resampled = true;
+            publish = true;
+        }
+        double t3 = now_s();
+
+        //the clustering, done by pf_update_resample() in amclLocalizer, is timed on its own
+        if (resampled)
+        {
+            pf_cluster_stats(pf, pf->sets + pf->current_set);
+        }
+        double t4 = now_s();
+
+        pf_vector_t best = pf_vector_zero();
+        double best_weight = 0;
+        if (publish)
+        {
+            pf_sample_set_t* set = pf->sets + pf->current_set;
+            for (int c = 0; c < set->cluster_count; c++)
+            {
+                double weight;
+                pf_vector_t mean;
+                pf_matrix_t cov;
+                if (pf_get_cluster_stats(pf, c, &weight, &mean, &cov) && weight > best_weight)
+                {
+                    best_weight = weight;
+                    best = mean;
+                }
+            }
+        }
+        std::clock_t cpu1 = std::clock();
+
+        updates++;
+        particle_sum += pf->sets[pf->current_set].sample_count;
+        st_action.add(t1 - t0);
+        st_sensor.add(t2 - t1);
+        if (resampled) { st_resample.add(t3 - t2); }
+        if (resampled) { st_cluster.add(t4 - t3); }
+        st_cpu.add(double(cpu1 - cpu0) / CLOCKS_PER_SEC);
+
+        if (best_weight > 0)
+        {
+            if (out.is_open())
+            {
+                out << scan.t << " " << best.v[0] << " " << best.v[1] << " " << best.v[2] * RAD2DEG << "\n";
+            }
+            pose_sample_t ref;
+            if (interpolate(reference, scan.t, ref))
+            {
+                double e = hypot(best.v[0] - ref.x, best.v[1] - ref.y);
+                double et = fabs(angle_diff(best.v[2], ref.theta * DEG2RAD)) * RAD2DEG;
+                err_count++;
+                err_sum2 += e * e;
+                err_theta_sum2 += et * et;
+                err_max = std::max(err_max, e);
+                err_theta_max = std::max(err_theta_max, et);
+            }
+        }
+    }
+    double t_replay = now_s() - t_replay_start;
+    double t_log = scans.back().t - scans.front().t;
+
+    //report
+    yCInfo(AMCL_REPLAY) << "---------------------------------------------";
+    yCInfo(AMCL_REPLAY, "setup (map and sensor models): %.3f s", t_setup);
+    yCInfo(AMCL_REPLAY, "replayed %.1f s of log in %.3f s (%.1fx real time), %zu scans, %zu filter updates",
+        t_log, t_replay, (t_replay > 0) ? t_log / t_replay : 0.0, scans.size(), updates);
+    if (updates > 0)
+    {
+        yCInfo(AMCL_REPLAY, "mean particle count: %.1f", (double)particle_sum / updates);
+    }
+    for (const stage_stats_t* s : { &st_action, &st_sensor, &st_resample, &st_cluster, &st_cpu })
+    {
+        if (s->count > 0)
+        {
+            yCInfo(AMCL_REPLAY, "%-10s calls: %6zu  mean: %8.3f ms  max: %8.3f ms", s->name, s->count, 1000 * s->total / s->count, 1000 * s->max);
+        }
+    }
+    if (err_count > 0)
+    {
+        yCInfo(AMCL_REPLAY, "pose error vs reference (%zu poses): rms %.3f m, max %.3f m, rms %.2f deg, max %.2f deg",
+            err_count, sqrt(err_sum2 / err_count), err_max, sqrt(err_theta_sum2 / err_count), err_theta_max);
+    }
+
+    pf_free(pf);
+    map_free(map);
+    Network::fini();
+    return 0;
+}
@@ -218,6 +218,9 @@ bool CtrlModule::respond(const Bottle& command, Bottle& reply)
         reply.addString("change_pid <identif> <kp> <ki> <kd>");
         reply.addString("change_ctrl_mode <type_string>");
         reply.addString("set_debug_mode 0/1");
+        reply.addString("get_timing [total]");
+        reply.addString("reset_timing");
+        reply.addString("dump_timing <filename>");
         return true;
     }
     else if (command.get(0).asString() == "set_max_lin_vel")
@@ -335,10 +338,41 @@ bool CtrlModule::respond(const Bottle& command, Bottle& reply)
         return true;
     }
     else if (command.get(0).asString()=="reset_odometry")
+    {
+        if (control_thr && control_thr->get_odometry_handler())
+        {
+            control_thr->get_odometry_handler()->reset_odometry();
+            reply.addString("Odometry reset done.");
+        }
+        else
+        {
+            reply.addString("No Odometry available.");
+        }
+        return true;
+    }
+    else if (command.get(0).asString()=="get_timing")
+    {
+        if (control_thr)
+        {
+            control_thr->get_timing(reply, command.get(1).asString() == "total");
+        }
+        return true;
+    }
+    else if (command.get(0).asString()=="reset_timing")
+    {
+        if (control_thr)
+        {
+            control_thr->reset_timing();
+            reply.addString("Timing statistics reset.");
+        }
+        return true;
+    }
+    else if (command.get(0).asString()=="dump_timing")
     {
         if (control_thr)
         {
-            {reply.addString("No Odometry available.");}
+            bool ret = control_thr->dump_timing(command.get(1).asString());
+            reply.addString(ret ? "Timing histograms saved." : "Unable to save the timing histograms.");
         }
         return true;
     }
@@ -373,6 +407,8 @@ bool   CtrlModule::updateModule()
         control_thr->get_motor_handler()->updateControlMode();
         if (verbose_print) control_thr->get_motor_handler()->printStats();
         if (verbose_print) control_thr->get_input_handler()->printStats();
+        if (verbose_print && control_thr->get_odometry_handler()) control_thr->get_odometry_handler()->printStats();
+        control_thr->broadcast_timing();
     }
     else
     {
@@ -77,7 +77,7 @@ bool CER_MotorControl::open(const Property &_options)
     return true;
 }
 
-CER_MotorControl::CER_MotorControl(PolyDriver* _driver) : MotorControl(_driver)
+CER_MotorControl::CER_MotorControl(PolyDriver* _driver, double _period) : MotorControl(_driver, _period)
 {
     control_board_driver = _driver;
     motors_num=2;
@@ -108,14 +108,10 @@ void CER_MotorControl::execute_speed(double appl_linear_speed, double appl_desir
 
     //yCDebug() << appl_linear_speed << appl_linear_speed_to_wheels;
     //Use a low pass filter to obtain smooth control
-    for (size_t i=0; i < F.size(); i++)
-    {
-        apply_motor_filter(i);
-    }
+    apply_motor_filter();
 
     //Apply the commands
-    ivel->velocityMove(0,F[0]);
-    ivel->velocityMove(1,F[1]);
+    send_velocity_refs(F.data());
     //yCDebug() << F[0] << F[1];
 }
 
@@ -123,20 +119,16 @@ void CER_MotorControl::execute_openloop(double appl_linear_speed, double appl_de
 {
     decouple(appl_linear_speed, appl_desired_direction, appl_angular_speed);
     //Use a low pass filter to obtain smooth control
-    for (size_t i=0; i < F.size(); i++)
-    {
-        apply_motor_filter(i);
-    }
+    apply_motor_filter();
 
     //Apply the commands
-    ipwm->setRefDutyCycle(0, F[0]);
-    ipwm->setRefDutyCycle(1, F[1]);
+    send_pwm_refs(F.data());
 }
 
 void CER_MotorControl::execute_none()
 {
-    ipwm->setRefDutyCycle(0, 0);
-    ipwm->setRefDutyCycle(1, 0);
+    std::fill(motors_refs.begin(), motors_refs.end(), 0.0);
+    send_pwm_refs(motors_refs.data());
 }
 
 double CER_MotorControl::get_vlin_coeff()
@@ -38,8 +38,9 @@ public:
     /**
     * Constructor
     * @param _driver is a pointer to a remoteControlBoard driver.
+    * @param _period the period of the control thread [s]
     */
-    CER_MotorControl(PolyDriver* _driver);
+    CER_MotorControl(PolyDriver* _driver, double _period);
 
     /**
     * Destructor
@@ -53,7 +54,6 @@ public:
     void execute_speed(double appl_linear_speed, double appl_desired_direction, double appl_angular_speed);
     void decouple(double appl_linear_speed, double appl_desired_direction, double appl_angular_speed);
     void close();
-    void set_motors_filter(filter_frequency b) {motors_filter_enabled=b;}
     double get_vlin_coeff();
     double get_vang_coeff();
 };
@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "cer_odometry.h"
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+
+YARP_LOG_COMPONENT(CER_ODOM, "navigation.baseControl.cerOdometry")
+
+CER_Odometry::CER_Odometry(double _period) : Odometry(2, _period)
+{
+}
+
+CER_Odometry::~CER_Odometry()
+{
+}
+
+bool CER_Odometry::open(const Property &_options)
+{
+    //get robot geometry
+    Bottle geometry_group = _options.findGroup("ROBOT_GEOMETRY");
+    if (geometry_group.isNull())
+    {
+        yCError(CER_ODOM,"Unable to find ROBOT_GEOMETRY group!");
+        return false;
+    }
+    if (!geometry_group.check("geom_r"))
+    {
+        yCError(CER_ODOM,"Missing param geom_r in [ROBOT_GEOMETRY] group");
+        return false;
+    }
+    if (!geometry_group.check("geom_L"))
+    {
+        yCError(CER_ODOM,"Missing param geom_L in [ROBOT_GEOMETRY] group");
+        return false;
+    }
+    geom_r = geometry_group.find("geom_r").asFloat64();
+    geom_L = geometry_group.find("geom_L").asFloat64();
+
+    //the base class open
+    if (!Odometry::open(_options))
+    {
+        yCError(CER_ODOM) << "Error in Odometry::open()"; return false;
+    }
+    return true;
+}
+
+void CER_Odometry::compute_base_velocity(const double* speeds, double& vel_x, double& vel_y, double& vel_theta)
+{
+    //inverse of CER_MotorControl::decouple()
+    vel_x     = (speeds[0] + speeds[1]) / 2 * DEG2RAD * geom_r;
+    vel_y     = 0;
+    vel_theta = (speeds[1] - speeds[0]) * geom_r / geom_L;
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef CER_ODOMETRY_H
+#define CER_ODOMETRY_H
+
+#include "../odometry.h"
+
+class CER_Odometry : public Odometry
+{
+public:
+    /**
+    * Constructor
+    * @param _period the period of the control thread [s]
+    */
+    CER_Odometry(double _period);
+
+    /**
+    * Destructor
+    */
+    virtual ~CER_Odometry();
+
+    //The following methods are documented in base class odometry.h
+    bool open(const Property &_options);
+
+protected:
+    void compute_base_velocity(const double* speeds, double& vel_x, double& vel_y, double& vel_theta);
+};
+
+#endif
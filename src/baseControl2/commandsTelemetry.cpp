@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "commandsTelemetry.h"
+#include <yarp/os/Bottle.h>
+#include <algorithm>
+
+void commandsTelemetry::set_capacity(size_t samples)
+{
+    data.assign(std::max(samples, (size_t)1) * SAMPLE_SIZE, 0.0);
+    count = 0;
+}
+
+void commandsTelemetry::add(double linear_speed, double angular_speed, double desired_direction, double pwm_gain, double timestamp)
+{
+    if (full())
+    {
+        return;
+    }
+    double* s = data.data() + count * SAMPLE_SIZE;
+    s[0] = linear_speed;
+    s[1] = angular_speed;
+    s[2] = desired_direction;
+    s[3] = pwm_gain;
+    s[4] = timestamp;
+    count++;
+}
+
+void commandsTelemetry::copy_from(const commandsTelemetry& other)
+{
+    if (data.size() != other.data.size())
+    {
+        data.resize(other.data.size());
+    }
+    std::copy(other.data.begin(), other.data.begin() + other.count * SAMPLE_SIZE, data.begin());
+    count = other.count;
+}
+
+bool commandsTelemetry::write(yarp::os::ConnectionWriter& connection) const
+{
+    //same encoding of a yarp::sig::Vector
+    size_t n = count * SAMPLE_SIZE;
+    connection.appendInt32(BOTTLE_TAG_LIST + BOTTLE_TAG_FLOAT64);
+    connection.appendInt32((int32_t)n);
+    connection.appendBlock((const char*)data.data(), n * sizeof(double));
+    connection.convertTextMode();
+    return !connection.isError();
+}
+
+bool commandsTelemetry::read(yarp::os::ConnectionReader& connection)
+{
+    connection.convertTextMode();
+    if (connection.expectInt32() != BOTTLE_TAG_LIST + BOTTLE_TAG_FLOAT64)
+    {
+        return false;
+    }
+    int32_t n = connection.expectInt32();
+    if (n < 0 || n % SAMPLE_SIZE != 0)
+    {
+        return false;
+    }
+    if (data.size() < (size_t)n)
+    {
+        data.resize((size_t)n);
+    }
+    count = (size_t)n / SAMPLE_SIZE;
+    if (n > 0 && !connection.expectBlock((char*)data.data(), (size_t)n * sizeof(double)))
+    {
+        return false;
+    }
+    return !connection.isError();
+}
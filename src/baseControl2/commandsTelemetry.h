@@ -0,0 +1,39 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef COMMANDS_TELEMETRY_H
+#define COMMANDS_TELEMETRY_H
+
+#include <yarp/os/Portable.h>
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/ConnectionWriter.h>
+#include <cstddef>
+#include <vector>
+
+// The commands of the control loop, streamed as a fixed layout binary message.
+// Each sample is (linear_speed [m/s], angular_speed [deg/s], desired_direction [deg], pwm_gain, timestamp [s]),
+// a message holds one or more consecutive samples. It is encoded as a list of float64,
+// so it can also be read as a Bottle: get(0) and get(1) are the speeds of the first sample.
+class commandsTelemetry : public yarp::os::Portable
+{
+public:
+    static const size_t SAMPLE_SIZE = 5;
+
+    std::vector<double> data;    //SAMPLE_SIZE values per sample, preallocated by set_capacity()
+    size_t              count = 0;
+
+    void   set_capacity(size_t samples);
+    size_t capacity() const { return data.size() / SAMPLE_SIZE; }
+    bool   full() const     { return count >= capacity(); }
+    void   clear()          { count = 0; }
+    void   add(double linear_speed, double angular_speed, double desired_direction, double pwm_gain, double timestamp);
+    //copies the samples, without allocating if the capacity is the same
+    void   copy_from(const commandsTelemetry& other);
+
+    bool read(yarp::os::ConnectionReader& connection) override;
+    bool write(yarp::os::ConnectionWriter& connection) const override;
+};
+
+#endif
@@ -7,6 +7,8 @@
 #include "filters.h"
 #include "cer/cer_motors.h"
 #include "ikart/ikart_motors.h"
+#include "cer/cer_odometry.h"
+#include "ikart/ikart_odometry.h"
 
 YARP_LOG_COMPONENT(CONTROL_THRD, "navigation.baseControl.controlThread")
 
@@ -20,6 +22,7 @@ void ControlThread::afterStart(bool s)
 
 void ControlThread::threadRelease()
 {
+    if (m_odometry_handler)  {delete m_odometry_handler; m_odometry_handler = 0; }
     if (m_motor_handler)     {delete m_motor_handler; m_motor_handler=0;}
     if (m_input_handler)     {delete m_input_handler; m_input_handler = 0; }
 
@@ -39,13 +42,19 @@ void ControlThread::threadRelease()
     port_filtered_commands.close();
     port_unfiltered_commands.interrupt();
     port_unfiltered_commands.close();
+    port_timing.interrupt();
+    port_timing.close();
 
+    if (timing_dump_file != "")
+    {
+        timing.dump(timing_dump_file);
+    }
 }
 
 double ControlThread::get_max_linear_vel()  { return max_linear_vel; }
 double ControlThread::get_max_angular_vel() { return max_angular_vel; }
 
-ControlThread::ControlThread (double _period, ResourceFinder &_rf, Property options) : PeriodicThread(_period), rf(_rf), ctrl_options(options)
+ControlThread::ControlThread (double _period, ResourceFinder &_rf, Property options) : PeriodicThread(_period), rf(_rf), ctrl_options(options), timing(_period)
 {
     control_board_driver     = 0;
     thread_timeout_counter   = 0;
@@ -58,6 +67,7 @@ ControlThread::ControlThread (double _period, ResourceFinder &_rf, Property opti
     debug_enabled            = false;
     both_lin_ang_enabled     = true;
     thread_period            = _period;
+    input_filter.resize(3);
 
     input_linear_speed       = 0;
     input_angular_speed      = 0;
@@ -106,51 +116,60 @@ void ControlThread::apply_ratio_limiter (double max, double& linear_speed, doubl
 void ControlThread::apply_acceleration_limiter(double& linear_speed, double& angular_speed, double& desired_direction)
 {
     double period = this->getPeriod();
-    angular_speed = control_filters::ratelim_filter_0(angular_speed, 7, max_angular_acc_pos*period, max_angular_acc_neg * period, get_max_angular_vel(), -get_max_angular_vel());
-#if 0
-    linear_speed = control_filters::ratelim_filter_0(linear_speed, 8, max_linear_acc*period);
-    //the following line is not numerically correct because of max_linear_acc, but it prevents jerky motions
-    desired_direction = control_filters::ratelim_filter_0(desired_direction, 9, max_linear_acc*period);
-#else
+    angular_speed = angular_acc_limiter.filter(angular_speed, max_angular_acc_pos, max_angular_acc_neg, get_max_angular_vel(), -get_max_angular_vel(), period);
+
+    //the linear velocity is limited along the two axes, to keep the direction of the motion
     double xcomp = linear_speed * sin(desired_direction*DEG2RAD);
     double ycomp = linear_speed * cos(desired_direction*DEG2RAD);
-    xcomp = control_filters::ratelim_filter_0(xcomp, 8, max_linear_acc_pos*period, max_linear_acc_neg * period, get_max_linear_vel(), -get_max_linear_vel());
-    ycomp = control_filters::ratelim_filter_0(ycomp, 9, max_linear_acc_pos*period, max_linear_acc_neg * period, get_max_linear_vel(), -get_max_linear_vel());
+    xcomp = xvel_acc_limiter.filter(xcomp, max_linear_acc_pos, max_linear_acc_neg, get_max_linear_vel(), -get_max_linear_vel(), period);
+    ycomp = yvel_acc_limiter.filter(ycomp, max_linear_acc_pos, max_linear_acc_neg, get_max_linear_vel(), -get_max_linear_vel(), period);
     linear_speed = sqrt(xcomp * xcomp+ ycomp * ycomp);
     desired_direction = atan2(xcomp, ycomp) * RAD2DEG;
-#endif
 
     #if DEBUG_LIMTER
     yCDebug()<<angular_speed<<linear_speed;
     #endif
 }
 
+void ControlThread::apply_velocity_smoother(double& linear_speed, double& angular_speed, double& desired_direction)
+{
+    double period = this->getPeriod();
+    angular_speed = angular_smoother.filter(angular_speed, max_angular_acc_pos, max_angular_acc_neg, max_angular_jerk, get_max_angular_vel(), -get_max_angular_vel(), period);
+
+    //as in apply_acceleration_limiter(), the linear velocity is smoothed along the two axes
+    double xcomp = linear_speed * sin(desired_direction*DEG2RAD);
+    double ycomp = linear_speed * cos(desired_direction*DEG2RAD);
+    xcomp = xvel_smoother.filter(xcomp, max_linear_acc_pos, max_linear_acc_neg, max_linear_jerk, get_max_linear_vel(), -get_max_linear_vel(), period);
+    ycomp = yvel_smoother.filter(ycomp, max_linear_acc_pos, max_linear_acc_neg, max_linear_jerk, get_max_linear_vel(), -get_max_linear_vel(), period);
+    linear_speed = sqrt(xcomp * xcomp+ ycomp * ycomp);
+    desired_direction = atan2(xcomp, ycomp) * RAD2DEG;
+}
+
 void ControlThread::apply_input_filter (double& linear_speed, double& angular_speed, double& desired_direction)
 {
-    if (input_filter_enabled == 8)
-    {
-        angular_speed = control_filters::lp_filter_8Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_8Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_8Hz(desired_direction, 9);
-    }
-    else if (input_filter_enabled == 4)
-    {
-        angular_speed = control_filters::lp_filter_4Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_4Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_4Hz(desired_direction, 9);
-    }
-    else if(input_filter_enabled == 2)
-    {
-        angular_speed = control_filters::lp_filter_2Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_2Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_2Hz(desired_direction, 9);
-    }
-    else if(input_filter_enabled == 1)
+    int b = input_filter_request.exchange(-1);
+    if (b >= 0)
     {
-        angular_speed = control_filters::lp_filter_1Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_1Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_1Hz(desired_direction, 9);
+        if (input_filter.set(b, thread_period) == false)
+        {
+            yCWarning(CONTROL_THRD, "Input filter at %dHz is too high for a period of %.3fs, filter disabled", b, thread_period);
+            b = 0;
+        }
+        input_filter_enabled = b;
     }
+
+    //when disabled, the filter just tracks the input
+    double commands[3] = { angular_speed, linear_speed, desired_direction };
+    input_filter.filter(commands);
+    angular_speed = commands[0];
+    linear_speed = commands[1];
+    desired_direction = commands[2];
+}
+
+void ControlThread::set_input_filter(int b)
+{
+    //the coefficients are used by run(), they are changed by apply_input_filter()
+    input_filter_request = (b > 0) ? b : 0;
 }
 
 void ControlThread::enable_debug(bool b)
@@ -252,14 +271,41 @@ void ControlThread::apply_control_openloop_pid(double& pidout_linear_throttle, d
     }
 }
 
+void ControlThread::publish_commands(BufferedPort<commandsTelemetry>& port, commandsTelemetry& batch, double timestamp)
+{
+    if (port.getOutputCount() == 0)
+    {
+        batch.clear();
+        return;
+    }
+    batch.add(input_linear_speed, input_angular_speed, input_desired_direction, input_pwm_gain, timestamp);
+    if (batch.full())
+    {
+        commandsTelemetry& msg = port.prepare();
+        msg.copy_from(batch);
+        port.write();
+        batch.clear();
+    }
+}
+
 void ControlThread::run()
 {
     double pidout_linear_throttle = 0;
     double pidout_angular_throttle = 0;
     double pidout_direction     = 0;
 
+    timing.start_cycle();
+
+    //odometry, integrated at each new sample of the encoders
+    if (m_odometry_handler && m_odometry_handler->update(m_motor_handler))
+    {
+        m_odometry_handler->broadcast();
+    }
+    timing.end_stage(STAGE_ODOMETRY);
+
     //read inputs (input_linear_speed in m/s, input_angular_speed in deg/s...)
     this->m_input_handler->read_inputs(input_linear_speed, input_angular_speed, input_desired_direction, input_pwm_gain);
+    timing.add_input_age(this->m_input_handler->get_input_age());
 
     if (input_linear_speed < 0)
     {
@@ -275,20 +321,23 @@ void ControlThread::run()
     }
 
     //debug block: outputs unfiltered commands
-    static double otime = yarp::os::Time::now();
     double ctime = yarp::os::Time::now();
-    Bottle &uncoms = port_unfiltered_commands.prepare();
-    uncoms.clear();
-    uncoms.addFloat64(input_linear_speed);
-    uncoms.addFloat64(input_angular_speed);
-    uncoms.addFloat64(ctime-otime);
-    port_unfiltered_commands.write();
+    publish_commands(port_unfiltered_commands, unfiltered_commands, ctime);
+    timing.end_stage(STAGE_INPUT);
     
     //low pass filter
     apply_input_filter(input_linear_speed, input_angular_speed, input_desired_direction);
+    timing.end_stage(STAGE_FILTER);
 
-    //acceleration_limiter
-    apply_acceleration_limiter(input_linear_speed, input_angular_speed, input_desired_direction);
+    //acceleration_limiter, or acceleration and jerk limiter
+    if (smoother_enabled)
+    {
+        apply_velocity_smoother(input_linear_speed, input_angular_speed, input_desired_direction);
+    }
+    else
+    {
+        apply_acceleration_limiter(input_linear_speed, input_angular_speed, input_desired_direction);
+    }
 
     //apply limiter
     if (input_linear_speed  > get_max_linear_vel())   input_linear_speed  = get_max_linear_vel();
@@ -300,13 +349,8 @@ void ControlThread::run()
     if (ratio_limiter_enabled) apply_ratio_limiter(input_linear_speed, input_angular_speed);
 
     //debug block: outputs filtered commands
-    Bottle &coms = port_filtered_commands.prepare();
-    coms.clear();
-    coms.addFloat64(input_linear_speed);
-    coms.addFloat64(input_angular_speed);
-    coms.addFloat64(ctime-otime);
-    port_filtered_commands.write();
-    otime=ctime;
+    publish_commands(port_filtered_commands, filtered_commands, ctime);
+    timing.end_stage(STAGE_LIMITER);
     
 
     /*
@@ -326,6 +370,7 @@ void ControlThread::run()
         pidout_linear_throttle = input_linear_speed / this->max_linear_vel * this->m_motor_handler->get_max_motor_pwm()/2 * exec_pwm_gain;
         pidout_angular_throttle = input_angular_speed / this->max_angular_vel * this->m_motor_handler->get_max_motor_pwm()/2 * exec_pwm_gain;
         pidout_direction = input_desired_direction;
+        timing.end_stage(STAGE_PID);
         this->m_motor_handler->execute_openloop(pidout_linear_throttle, pidout_direction, pidout_angular_throttle);
     }
     else if (base_control_type == BASE_CONTROL_VELOCITY_NO_PID)
@@ -334,6 +379,7 @@ void ControlThread::run()
         pidout_linear_throttle = input_linear_speed * exec_pwm_gain;
         pidout_angular_throttle = input_angular_speed * exec_pwm_gain;
         pidout_direction     = input_desired_direction;
+        timing.end_stage(STAGE_PID);
         this->m_motor_handler->execute_speed(pidout_linear_throttle, pidout_direction, pidout_angular_throttle);
     }
     else if (base_control_type == BASE_CONTROL_OPENLOOP_PID)
@@ -342,6 +388,7 @@ void ControlThread::run()
         apply_control_openloop_pid(pidout_linear_throttle, pidout_angular_throttle,
             (input_linear_speed * exec_pwm_gain),
             (input_angular_speed * exec_pwm_gain));
+        timing.end_stage(STAGE_PID);
         this->m_motor_handler->execute_speed(pidout_linear_throttle, pidout_direction, pidout_angular_throttle);
     }
     else if (base_control_type == BASE_CONTROL_VELOCITY_PID)
@@ -350,19 +397,51 @@ void ControlThread::run()
         apply_control_speed_pid(pidout_linear_throttle, pidout_angular_throttle,
             (input_linear_speed * exec_pwm_gain),
             (input_angular_speed * exec_pwm_gain));
+        timing.end_stage(STAGE_PID);
         this->m_motor_handler->execute_speed(pidout_linear_throttle, pidout_direction, pidout_angular_throttle);
     }
     else
     {
         yCError (CONTROL_THRD,"Unknown control mode!");
+        timing.end_stage(STAGE_PID);
         this->m_motor_handler->execute_none();
-}
+    }
+    timing.end_stage(STAGE_MOTORS);
+    timing.end_cycle();
 }
 
 void ControlThread::printStats()
 {
     yCInfo (CONTROL_THRD, "* Control thread:\n");
     yCInfo (CONTROL_THRD, "Input command: %+5.2f %+5.2f %+5.2f  %+5.2f      ", input_linear_speed, input_angular_speed, input_desired_direction, input_pwm_gain);
+    timing.print_stats();
+}
+
+void ControlThread::broadcast_timing()
+{
+    if (port_timing.getOutputCount() > 0)
+    {
+        Bottle& b = port_timing.prepare();
+        b.clear();
+        timing.get_stats(b, false);
+        port_timing.write();
+    }
+    timing.reset_window();
+}
+
+void ControlThread::get_timing(Bottle& b, bool total)
+{
+    timing.get_stats(b, total);
+}
+
+void ControlThread::reset_timing()
+{
+    timing.reset();
+}
+
+bool ControlThread::dump_timing(string filename)
+{
+    return timing.dump(filename);
 }
 
 bool ControlThread::set_control_type (string s)
@@ -409,6 +488,7 @@ bool ControlThread::threadInit()
     ratio_limiter_enabled = general_options.check("ratio_limiter_enabled", Value(0),     "1=enabled, 0 = disabled").asInt32()==1;
     lin_ang_ratio         = general_options.check("linear_angular_ratio", Value(0.7),    "ratio (<1.0) between the maximum linear speed and the maximum angular speed.").asFloat64();
     robot_type_s          = general_options.check("robot_type",           Value("none"), "geometry of the robot").asString();
+    set_input_filter(input_filter_enabled);
 
     //max velocities
     {
@@ -462,6 +542,30 @@ bool ControlThread::threadInit()
     {
        yCError(CONTROL_THRD) << "Invalid max_linear_acc_neg"; return false;
     }
+
+    //velocity smoother
+    {
+        string smoother = general_options.check("velocity_smoother", Value("none"), "none/jerk").asString();
+        if (smoother == "jerk")
+        {
+            smoother_enabled = true;
+            max_linear_jerk = general_options.check("max_linear_jerk", Value(0), "maximum linear jerk of the platform [m/s^3]").asFloat64();
+            max_angular_jerk = general_options.check("max_angular_jerk", Value(0), "maximum angular jerk of the platform [deg/s^3]").asFloat64();
+            if (max_linear_jerk <= 0)
+            {
+                yCError(CONTROL_THRD) << "Invalid max_linear_jerk"; return false;
+            }
+            if (max_angular_jerk <= 0)
+            {
+                yCError(CONTROL_THRD) << "Invalid max_angular_jerk"; return false;
+            }
+            yCInfo(CONTROL_THRD, "Using the jerk limited velocity smoother (%.2fm/s^3, %.1fdeg/s^3)", max_linear_jerk, max_angular_jerk);
+        }
+        else if (smoother != "none")
+        {
+            yCError(CONTROL_THRD) << "Invalid velocity_smoother param:" << smoother << "(valid values: none, jerk)"; return false;
+        }
+    }
     
     // open the control board driver
     yCInfo(CONTROL_THRD, "Opening the motors interface...\n");
@@ -519,22 +623,25 @@ bool ControlThread::threadInit()
     {
         yCInfo(CONTROL_THRD, "Using cer robot type");
         robot_type = ROBOT_TYPE_DIFFERENTIAL;
-        m_motor_handler    = new CER_MotorControl(control_board_driver);
+        m_motor_handler    = new CER_MotorControl(control_board_driver, thread_period);
         m_input_handler    = new Input();
+        if (odometry_enabled) m_odometry_handler = new CER_Odometry(thread_period);
     }
     else if (robot_type_s == "ikart_V1")
     {
         yCInfo(CONTROL_THRD, "Using ikart_V1 robot type");
         robot_type       = ROBOT_TYPE_THREE_ROTOCASTER;
-        m_motor_handler    = new iKart_MotorControl(control_board_driver);
+        m_motor_handler    = new iKart_MotorControl(control_board_driver, thread_period);
         m_input_handler    = new Input();
+        if (odometry_enabled) m_odometry_handler = new iKart_Odometry(thread_period);
     }
     else if (robot_type_s == "ikart_V2")
     {
         yCInfo(CONTROL_THRD, "Using ikart_V2 robot type");
         robot_type       = ROBOT_TYPE_THREE_MECHANUM;
-        m_motor_handler    = new iKart_MotorControl(control_board_driver);
+        m_motor_handler    = new iKart_MotorControl(control_board_driver, thread_period);
         m_input_handler    = new Input();
+        if (odometry_enabled) m_odometry_handler = new iKart_Odometry(thread_period);
     }
     else
     {
@@ -556,6 +663,12 @@ bool ControlThread::threadInit()
         return false;
     }
 
+    if (m_odometry_handler && m_odometry_handler->open(ctrl_options) == false)
+    {
+        yCError(CONTROL_THRD) << "Problem occurred while opening odometry handler";
+        return false;
+    }
+
     yCInfo(CONTROL_THRD, "%s", ctrl_options.toString().c_str());
 
     //create the pid controllers
@@ -620,6 +733,11 @@ bool ControlThread::threadInit()
     }
     port_filtered_commands.open((localName + "/filtered_commands:o").c_str());
     port_unfiltered_commands.open((localName + "/unfiltered_commands:o").c_str());
+    int batch = general_options.check("commands_batch", Value(1), "number of samples sent in each message of the commands ports").asInt32();
+    filtered_commands.set_capacity(batch > 0 ? batch : 1);
+    unfiltered_commands.set_capacity(batch > 0 ? batch : 1);
+    port_timing.open((localName + "/timing:o").c_str());
+    timing_dump_file = rf.check("timing_dump", Value(""), "file where the loop timing histograms are saved on shutdown").asString();
 
     //start the motors
     if (rf.check("no_start"))
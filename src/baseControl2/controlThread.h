@@ -23,10 +23,15 @@
 #include <yarp/math/Math.h>
 #include <iCub/ctrl/pids.h>
 #include <string>
+#include <atomic>
 #include <math.h>
 
 #include "motors.h"
 #include "input.h"
+#include "odometry.h"
+#include "loopTiming.h"
+#include "commandsTelemetry.h"
+#include "filters.h"
 
 using namespace std;
 using namespace yarp::os;
@@ -77,6 +82,7 @@ private:
     bool                 both_lin_ang_enabled;
     bool                 ratio_limiter_enabled;
     int                  input_filter_enabled;
+    std::atomic<int>     input_filter_request{-1}; //set by set_input_filter(), applied by the control thread (-1 = none)
     bool                 debug_enabled;
     double               max_angular_vel=0;
     double               max_linear_vel=0;
@@ -84,6 +90,23 @@ private:
     double               max_angular_acc_neg = 0;
     double               max_linear_acc_pos = 0;
     double               max_linear_acc_neg = 0;
+    bool                 smoother_enabled = false;
+    double               max_angular_jerk = 0;
+    double               max_linear_jerk = 0;
+
+    //filters of the input commands, their coefficients depend on thread_period
+    control_filters::lp_filter_multi input_filter;  //angular speed, linear speed, direction
+    control_filters::ratelim_filter  angular_acc_limiter;
+    control_filters::ratelim_filter  xvel_acc_limiter;
+    control_filters::ratelim_filter  yvel_acc_limiter;
+    //jerk limited smoother, used instead of the acceleration limiters if velocity_smoother is 'jerk'
+    control_filters::jerk_filter     angular_smoother;
+    control_filters::jerk_filter     xvel_smoother;
+    control_filters::jerk_filter     yvel_smoother;
+
+    //timing of the control loop
+    LoopTiming           timing;
+    string               timing_dump_file;
 
 protected:
     ResourceFinder       &rf;
@@ -91,20 +114,26 @@ protected:
 
     BufferedPort<Bottle> port_debug_linear;
     BufferedPort<Bottle> port_debug_angular;
-    BufferedPort<Bottle> port_filtered_commands;
-    BufferedPort<Bottle> port_unfiltered_commands;
+    //the commands before and after the filters, written only while someone is connected
+    BufferedPort<commandsTelemetry> port_filtered_commands;
+    BufferedPort<commandsTelemetry> port_unfiltered_commands;
+    commandsTelemetry    filtered_commands;
+    commandsTelemetry    unfiltered_commands;
+    BufferedPort<Bottle> port_timing;
 
     MotorControl*        m_motor_handler = nullptr;
     Input*               m_input_handler = nullptr;
+    Odometry*            m_odometry_handler = nullptr;
 
     string               remoteName;
     string               localName;
     bool                 odometry_enabled;
 
 public:
-    //MotorControl and Input are instantiated by ControlThread.
+    //MotorControl, Input and Odometry are instantiated by ControlThread.
     MotorControl* const  get_motor_handler()    { return m_motor_handler;}
     Input* const         get_input_handler()    { return m_input_handler; }
+    Odometry* const      get_odometry_handler() { return m_odometry_handler; }
     void                 enable_debug(bool b);
     void                 set_max_ang_vel(double val) { max_angular_vel = val;}
     void                 set_max_lin_vel(double val) { max_linear_vel = val; }
@@ -144,6 +173,29 @@ public:
     */
     void printStats();
 
+    /**
+    * Publishes the timing statistics of the control loop since the last call, then starts a new window.
+    */
+    void broadcast_timing();
+
+    /**
+    * Gets the timing statistics of the control loop.
+    * @param b the bottle to which the statistics are appended
+    * @param total if true the statistics since the start (or the last reset_timing()), otherwise the ones of the current window
+    */
+    void get_timing(Bottle& b, bool total);
+
+    /**
+    * Resets the timing statistics of the control loop.
+    */
+    void reset_timing();
+
+    /**
+    * Saves the timing histograms of the control loop to a text file.
+    * @return false if the file cannot be written.
+    */
+    bool dump_timing(string filename);
+
     /**
     * Sets the PID control gains if the current control mode is: velocity_pid, openloop_pid.
     */
@@ -152,9 +204,10 @@ public:
     /**
     * Sets an low pass filter on input commands.
     * @param b is a code which specifies the filter type. Can be one of the following: 0 (disabled) or
-    * 1,2,4,8 for a first order low-pass filter with a cut-off frequency of 1,2,4,8Hz.
+    * the cut-off frequency (e.g. 1,2,4,8Hz) of a first order low-pass filter. It must be lower than half the thread rate.
+    * The filter is changed by the control thread at its next cycle, so this can be called from any thread.
     */
-    void set_input_filter    (int b) {input_filter_enabled=b;}
+    void set_input_filter    (int b);
 
     /**
     * Gets robot max linear velocity.
@@ -173,9 +226,12 @@ protected:
     void apply_ratio_limiter (double max, double& linear_speed, double& angular_speed);
     void apply_ratio_limiter (double& linear_speed, double& angular_speed);
     void apply_acceleration_limiter (double& linear_speed, double& angular_speed, double& desired_direction);
+    void apply_velocity_smoother (double& linear_speed, double& angular_speed, double& desired_direction);
     void apply_input_filter  (double& linear_speed, double& angular_speed, double& desired_direction);
     void apply_control_openloop_pid(double& pidout_linear_throttle, double& pidout_angular_throttle, const double ref_linear_speed, const double ref_angular_speed);
     void apply_control_speed_pid(double& pidout_linear_throttle, double& pidout_angular_throttle, const double ref_linear_speed, const double ref_angular_speed);
+    //Adds a sample to the batch of a commands port and writes it when full. For internal use only.
+    void publish_commands(BufferedPort<commandsTelemetry>& port, commandsTelemetry& batch, double timestamp);
 };
 
 #endif
@@ -6,140 +6,157 @@
 #include "filters.h"
 #include "yarp/os/Log.h"
 #include "yarp/os/LogStream.h"
+#include <algorithm>
 
-double control_filters::lp_filter_8Hz(double input, int i)
+//Coefficients of the first order butterworth low pass filter, bilinear transform:
+//y[k] = b * (x[k] + x[k-1]) + a * y[k-1]
+static bool lp_coefficients(double cutoff_hz, double period, double& b, double& a)
 {
-    //This is a butterworth low pass first order, with a cut off frequency of 2Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input / 2.818993247e+00;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.2905268567   * yv[0][i]);
-    return yv[1][i];
+    if (cutoff_hz <= 0 || period <= 0 || cutoff_hz * period >= 0.5)
+    {
+        b = 1;
+        a = 0;
+        return false;
+    }
+    double k = tan(M_PI * cutoff_hz * period);
+    b = k / (1 + k);
+    a = (1 - k) / (1 + k);
+    return true;
 }
 
-double control_filters::lp_filter_4Hz(double input, int i)
+bool control_filters::lp_filter::set(double cutoff_hz, double period)
 {
-    //This is a butterworth low pass first order, with a cut off frequency of 4Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /4.894742855e+00;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.5913983514  * yv[0][i]);
-    return yv[1][i];
+    bool ret = lp_coefficients(cutoff_hz, period, m_b, m_a);
+    m_cutoff = ret ? cutoff_hz : 0;
+    return ret || cutoff_hz <= 0;
 }
 
-double control_filters::lp_filter_2Hz(double input, int i)
+void control_filters::lp_filter::reset(double value)
 {
-    //This is a butterworth low pass first order, with a cut off frequency of 2Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /8.915815088e+00;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.7756795110 * yv[0][i]);
-    return yv[1][i];
+    m_x_prev = value;
+    m_y_prev = value;
 }
 
-double control_filters::lp_filter_1Hz(double input, int i)
+double control_filters::lp_filter::filter(double input)
 {
-    //This is a butterworth low pass first order, with a cut off frequency of 1Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /1.689454484e+01;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.8816185924 * yv[0][i]);
-    return yv[1][i];
+    if (m_cutoff <= 0)
+    {
+        reset(input);
+        return input;
+    }
+    m_y_prev = m_b * (input + m_x_prev) + m_a * m_y_prev;
+    m_x_prev = input;
+    return m_y_prev;
 }
 
-double control_filters::lp_filter_0_5Hz(double input, int i)
+void control_filters::lp_filter_multi::resize(size_t channels)
 {
-    //This is a butterworth low pass first order, with a cut off frequency of 0.5Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /3.282051595e+01;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.9390625058 * yv[0][i]);
-    return yv[1][i];
+    m_x_prev.assign(channels, 0.0);
+    m_y_prev.assign(channels, 0.0);
 }
 
-double control_filters::ratelim_filter_0(double input, int i, double rate_pos, double rate_neg, double max_val, double min_val)
+bool control_filters::lp_filter_multi::set(double cutoff_hz, double period)
 {
-    //This is a rate limiter filter. 
-    static double prev[10];
-
-//    if (i==9) {yCDebug() << "9>>>" << input << rate_pos << rate_neg << prev[9];} //print lin vel along x axis
-    
-    if (prev[i]>max_val) prev[i]=max_val;
-    if (prev[i]<min_val) prev[i]=min_val;
-    
-    if (input*prev[i]>=0)
+    bool ret = lp_coefficients(cutoff_hz, period, m_b, m_a);
+    m_cutoff = ret ? cutoff_hz : 0;
+    return ret || cutoff_hz <= 0;
+}
+
+void control_filters::lp_filter_multi::reset(double value)
+{
+    std::fill(m_x_prev.begin(), m_x_prev.end(), value);
+    std::fill(m_y_prev.begin(), m_y_prev.end(), value);
+}
+
+void control_filters::lp_filter_multi::filter(double* data)
+{
+    const size_t n = m_x_prev.size();
+    double* x = m_x_prev.data();
+    double* y = m_y_prev.data();
+    if (m_cutoff <= 0)
     {
-        if (input > 0)
-        {
-            if (abs(input) > abs(prev[i]))
-            {
-                if (abs(input - prev[i]) > rate_pos) prev[i] = prev[i] + rate_pos;
-                else     prev[i] = input;
-                return prev[i];
-            }
-            else
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] - rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
-        }
-        if (input < 0)
-        {
-        
-            if (abs(input) > abs(prev[i]))
-            {
-                if (abs(input - prev[i]) > rate_pos) prev[i] = prev[i] - rate_pos;
-                else     prev[i] = input;
-                return prev[i];
-            }
-            else
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] + rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
-        }
-        if (input == 0)
+        for (size_t i = 0; i < n; i++)
         {
-            if (prev[i]>0)
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] - rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
-            else
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] + rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
+            x[i] = data[i];
+            y[i] = data[i];
         }
+        return;
+    }
+    const double b = m_b;
+    const double a = m_a;
+    for (size_t i = 0; i < n; i++)
+    {
+        double out = b * (data[i] + x[i]) + a * y[i];
+        x[i] = data[i];
+        y[i] = out;
+        data[i] = out;
+    }
+}
+
+double control_filters::ratelim_filter::filter(double input, double rate_pos, double rate_neg, double max_val, double min_val, double period)
+{
+    if (m_prev > max_val) m_prev = max_val;
+    if (m_prev < min_val) m_prev = min_val;
+
+    //rate_pos while the absolute value grows, rate_neg while it decreases.
+    //When the sign changes, rate_pos towards positive values, rate_neg towards negative ones.
+    double rate;
+    if (input * m_prev >= 0)
+    {
+        rate = (fabs(input) > fabs(m_prev)) ? rate_pos : rate_neg;
     }
     else
     {
-        if (input > 0)
-        {
+        rate = (input > 0) ? rate_pos : rate_neg;
+    }
+    double step = rate * period;
 
-            if (abs(input - prev[i]) > rate_pos) prev[i] = prev[i] + rate_pos;
-            else     prev[i] = input;
-            return prev[i];
-        }
-        else
-        {
-            if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] - rate_neg;
-            else     prev[i] = input;
-            return prev[i];
-        }
+    if (fabs(input - m_prev) > step)
+    {
+        m_prev = (input > m_prev) ? m_prev + step : m_prev - step;
     }
+    else
+    {
+        m_prev = input;
+    }
+    return m_prev;
+}
+
+double control_filters::jerk_filter::filter(double input, double acc_pos, double acc_neg, double jerk, double max_val, double min_val, double period)
+{
+    if (input > max_val) input = max_val;
+    if (input < min_val) input = min_val;
+    if (jerk <= 0 || period <= 0)
+    {
+        return m_vel;
+    }
+
+    double err = input - m_vel;
+    double acc_max = (err * m_vel >= 0) ? acc_pos : acc_neg;
+    double jerk_step = jerk * period;
+
+    //the acceleration a from which, decreasing it by jerk_step at each step, the velocity changes by err:
+    //(a + (a-jerk_step) + ... + (a-n*jerk_step)) * period = |err|, with 0 <= a-n*jerk_step < jerk_step
+    double steps_err = fabs(err) / period;
+    double n = floor((sqrt(1 + 8 * steps_err / jerk_step) - 1) / 2);
+    double acc_target = steps_err / (n + 1) + jerk_step * n / 2;
+    if (acc_target > acc_max) acc_target = acc_max;
+    if (err < 0) acc_target = -acc_target;
+
+    double acc = m_acc + std::max(-jerk_step, std::min(jerk_step, acc_target - m_acc));
+    double vel = m_vel + acc * period;
+
+    //the reference can be reached within this step, with an acceleration which can be zeroed in the next one
+    double acc_land = err / period;
+    if (fabs(acc_land - m_acc) <= jerk_step && fabs(acc_land) <= std::min(jerk_step, acc_max))
+    {
+        vel = input;
+        acc = acc_land;
+    }
+
+    if (vel > max_val) { vel = max_val; acc = 0; }
+    if (vel < min_val) { vel = min_val; acc = 0; }
+    m_vel = vel;
+    m_acc = acc;
+    return m_vel;
 }
@@ -7,29 +7,138 @@
 #define FILTERS_H
 
 #include <math.h>
+#include <vector>
+#include <stddef.h>
 
 namespace control_filters
 {
     /**
-    * These functions implement a butterworth low pass first order, with a cut off frequency of 0.5-8Hz.
-    * Coefficients have been computed in order to be used with a sampling frequency of 50Hz (20ms)
-    * @param input the value to be filtered
-    * @param i the joint number (0-9)
-    * @return the filtered value
+    * Butterworth low pass filter, first order, discretized with the bilinear transform.
+    * Each object keeps its own state, and its coefficients are computed from the cut off
+    * frequency and from the sampling period, so it can be used at any control rate.
+    * A filter which has not been set (or with a cut off frequency <= 0) outputs its input.
     */
-    double lp_filter_8Hz    (double input, int i);
-    double lp_filter_4Hz    (double input, int i);
-    double lp_filter_2Hz    (double input, int i);
-    double lp_filter_1Hz    (double input, int i);
-    double lp_filter_0_5Hz  (double input, int i);
+    class lp_filter
+    {
+    public:
+        lp_filter() {}
+        lp_filter(double cutoff_hz, double period) { set(cutoff_hz, period); }
+
+        /**
+        * Computes the coefficients. The state of the filter is kept.
+        * @param cutoff_hz the cut off frequency [Hz], <= 0 to disable the filter
+        * @param period the sampling period [s]
+        * @return false if the cut off frequency is not below the Nyquist frequency (the filter is disabled)
+        */
+        bool   set(double cutoff_hz, double period);
+        /**
+        * Sets the state of the filter as if it had always received the given value
+        */
+        void   reset(double value = 0);
+        /**
+        * @param input the value to be filtered
+        * @return the filtered value
+        */
+        double filter(double input);
+        double get_cutoff() const { return m_cutoff; }
+        bool   is_enabled() const { return m_cutoff > 0; }
+
+    private:
+        double m_cutoff = 0;
+        double m_b = 1;    //input gain
+        double m_a = 0;    //pole
+        double m_x_prev = 0;
+        double m_y_prev = 0;
+    };
+
+    /**
+    * The same low pass filter applied to several channels (e.g. all the wheels of the robot).
+    * The coefficients are shared and the state of the channels is stored in contiguous arrays.
+    */
+    class lp_filter_multi
+    {
+    public:
+        lp_filter_multi(size_t channels = 0) { resize(channels); }
+
+        /**
+        * Sets the number of channels, resetting their state
+        */
+        void   resize(size_t channels);
+        size_t size() const { return m_x_prev.size(); }
+        //see lp_filter::set()
+        bool   set(double cutoff_hz, double period);
+        void   reset(double value = 0);
+        double get_cutoff() const { return m_cutoff; }
+        bool   is_enabled() const { return m_cutoff > 0; }
+
+        /**
+        * Filters in place size() values
+        * @param data the value of each channel
+        */
+        void   filter(double* data);
+        void   filter(std::vector<double>& data) { filter(data.data()); }
+
+    private:
+        double m_cutoff = 0;
+        double m_b = 1;
+        double m_a = 0;
+        std::vector<double> m_x_prev;
+        std::vector<double> m_y_prev;
+    };
 
     /**
-    * This function implements a rate limiter filter.
-    * @param input the value to be filtered
-    * @param i the joint number
-    * @param rate the maximum change rate
-    * @return the filtered value
+    * Rate limiter: limits the variation of a value (e.g. the acceleration of a velocity command)
+    * and its range. Each object keeps its own state.
     */
-    double ratelim_filter_0 (double input, int i, double rate_pos, double rate_neg, double max_val, double min_val);
+    class ratelim_filter
+    {
+    public:
+        void   reset(double value = 0) { m_prev = value; }
+
+        /**
+        * @param input the value to be filtered
+        * @param rate_pos the maximum rate [units/s] when the absolute value increases
+        * @param rate_neg the maximum rate [units/s] when the absolute value decreases
+        * @param max_val the maximum output
+        * @param min_val the minimum output
+        * @param period the time elapsed since the previous call [s]
+        * @return the filtered value
+        */
+        double filter(double input, double rate_pos, double rate_neg, double max_val, double min_val, double period);
+
+    private:
+        double m_prev = 0;
+    };
+
+    /**
+    * Velocity smoother which enforces the velocity, acceleration and jerk limits together.
+    * At each step it applies the first step of the minimum time profile which brings the velocity
+    * to the reference (receding horizon): the acceleration moves, at the maximum jerk, towards the
+    * largest value from which the jerk limit still brings it back to zero when the reference is
+    * reached, so the reference is reached without overshoot. The solution is closed-form.
+    * Each object keeps its own state (velocity and acceleration).
+    */
+    class jerk_filter
+    {
+    public:
+        void   reset(double value = 0) { m_vel = value; m_acc = 0; }
+        double get_acc() const { return m_acc; }
+
+        /**
+        * @param input the velocity reference
+        * @param acc_pos the maximum acceleration [units/s^2] when the absolute velocity increases
+        * @param acc_neg the maximum acceleration [units/s^2] when the absolute velocity decreases
+        * @param jerk the maximum jerk [units/s^3]
+        * @param max_val the maximum output
+        * @param min_val the minimum output
+        * @param period the time elapsed since the previous call [s]
+        * @return the smoothed velocity
+        */
+        double filter(double input, double acc_pos, double acc_neg, double jerk, double max_val, double min_val, double period);
+
+    private:
+        double m_vel = 0;
+        double m_acc = 0;
+    };
 }
 #endif
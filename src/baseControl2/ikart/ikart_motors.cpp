@@ -82,7 +82,7 @@ bool iKart_MotorControl::open(const Property &_options)
     return true;
 }
 
-iKart_MotorControl::iKart_MotorControl(PolyDriver* _driver) : MotorControl(_driver)
+iKart_MotorControl::iKart_MotorControl(PolyDriver* _driver, double _period) : MotorControl(_driver, _period)
 {
     control_board_driver = _driver;
     motors_num=3;
@@ -116,15 +116,10 @@ void iKart_MotorControl::execute_speed(double appl_linear_speed, double appl_des
     decouple(appl_linear_speed_to_wheels, appl_desired_direction, appl_angular_speed_to_wheels);
 
     //Use a low pass filter to obtain smooth control
-    for (size_t i=0; i < F.size(); i++)
-    {
-        apply_motor_filter(i);
-    }
+    apply_motor_filter();
 
     //Apply the commands
-    ivel->velocityMove(0, F[0]);
-    ivel->velocityMove(1, F[1]);
-    ivel->velocityMove(2, F[2]);
+    send_velocity_refs(F.data());
 }
 
 void iKart_MotorControl::execute_openloop(double appl_linear_speed, double appl_desired_direction, double appl_angular_speed)
@@ -132,23 +127,20 @@ void iKart_MotorControl::execute_openloop(double appl_linear_speed, double appl_
     decouple(appl_linear_speed, appl_desired_direction,appl_angular_speed);
 
     //Use a low pass filter to obtain smooth control
-    //Use a low pass filter to obtain smooth control
-    for (size_t i=0; i < F.size(); i++)
-    {
-        apply_motor_filter(i);
-    }
+    apply_motor_filter();
 
     //Apply the commands
-    ipwm->setRefDutyCycle(0, -F[0]);
-    ipwm->setRefDutyCycle(1, -F[1]);
-    ipwm->setRefDutyCycle(2, -F[2]);
+    for (int i = 0; i < motors_num; i++)
+    {
+        motors_refs[i] = -F[i];
+    }
+    send_pwm_refs(motors_refs.data());
 }
 
 void iKart_MotorControl::execute_none()
 {
-    ipwm->setRefDutyCycle(0, 0);
-    ipwm->setRefDutyCycle(1, 0);
-    ipwm->setRefDutyCycle(2, 0);
+    std::fill(motors_refs.begin(), motors_refs.end(), 0.0);
+    send_pwm_refs(motors_refs.data());
 }
 
 double iKart_MotorControl::get_vlin_coeff()
@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "ikart_odometry.h"
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+
+YARP_LOG_COMPONENT(IKART_ODOM, "navigation.baseControl.ikartOdometry")
+
+//orientation of the wheels, as in iKart_MotorControl::decouple()
+static const double wheels_angle[3] = { -30 - 120, -30, -30 + 120 };
+
+iKart_Odometry::iKart_Odometry(double _period) : Odometry(3, _period)
+{
+}
+
+iKart_Odometry::~iKart_Odometry()
+{
+}
+
+bool iKart_Odometry::open(const Property &_options)
+{
+    //get robot geometry
+    Bottle geometry_group = _options.findGroup("ROBOT_GEOMETRY");
+    if (geometry_group.isNull())
+    {
+        yCError(IKART_ODOM,"Unable to find ROBOT_GEOMETRY group!");
+        return false;
+    }
+    if (!geometry_group.check("geom_r"))
+    {
+        yCError(IKART_ODOM,"Missing param geom_r in [ROBOT_GEOMETRY] group");
+        return false;
+    }
+    if (!geometry_group.check("geom_L"))
+    {
+        yCError(IKART_ODOM,"Missing param geom_L in [ROBOT_GEOMETRY] group");
+        return false;
+    }
+    geom_r = geometry_group.find("geom_r").asFloat64();
+    geom_L = geometry_group.find("geom_L").asFloat64();
+
+    //the base class open
+    if (!Odometry::open(_options))
+    {
+        yCError(IKART_ODOM) << "Error in Odometry::open()"; return false;
+    }
+    return true;
+}
+
+void iKart_Odometry::compute_base_velocity(const double* speeds, double& vel_x, double& vel_y, double& vel_theta)
+{
+    //inverse of iKart_MotorControl::decouple(): F[i] = -vx*cos(a[i]) + vy*sin(a[i]) - w.
+    //The three wheels are 120deg apart, so the sums of cos(a[i]) and sin(a[i]) are null.
+    double sum = 0, sum_c = 0, sum_s = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        sum   += speeds[i];
+        sum_c += speeds[i] * cos(wheels_angle[i] * DEG2RAD);
+        sum_s += speeds[i] * sin(wheels_angle[i] * DEG2RAD);
+    }
+    vel_x     = -2.0 / 3.0 * sum_c * DEG2RAD * geom_r;
+    vel_y     =  2.0 / 3.0 * sum_s * DEG2RAD * geom_r;
+    vel_theta = -sum / 3.0 * geom_r / geom_L;
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef IKART_ODOMETRY_H
+#define IKART_ODOMETRY_H
+
+#include "../odometry.h"
+
+class iKart_Odometry : public Odometry
+{
+public:
+    /**
+    * Constructor
+    * @param _period the period of the control thread [s]
+    */
+    iKart_Odometry(double _period);
+
+    /**
+    * Destructor
+    */
+    virtual ~iKart_Odometry();
+
+    //The following methods are documented in base class odometry.h
+    bool open(const Property &_options);
+
+protected:
+    void compute_base_velocity(const double* speeds, double& vel_x, double& vel_y, double& vel_theta);
+};
+
+#endif
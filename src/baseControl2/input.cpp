@@ -10,6 +10,7 @@
 #include <navigation_defines.h>
 #include <yarp/dev/IWrapper.h>
 #include <yarp/dev/INavigation2D.h>
+#include <algorithm>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -33,6 +34,15 @@ void Input::printStats()
         ss = ss + ":" + std::to_string(it->m_timeout_counter) + ")";
     }
     yCInfo(INPUT_HND) << ss;
+
+    ss = "commands received:";
+    for (auto it = m_input.begin(); it != m_input.end(); it++)
+    {
+        ss = ss + " (" + it->m_name + ":" + std::to_string(it->m_last_sequence) + ")";
+    }
+    ss = ss + " active input: " + ((m_active_input >= 0) ? m_input[m_active_input].m_name : string("none"));
+    ss = ss + " switches: " + std::to_string(m_input_switches);
+    yCInfo(INPUT_HND) << ss;
 }
 
 void Input::close()
@@ -49,7 +59,12 @@ void Input::close()
             it->m_inputmanager_dd->close();
             delete it->m_inputmanager_dd;
         }
+        if (it->m_shm)
+        {
+            delete it->m_shm;
+        }
     }
+    m_input.clear();
 }
 
 Input::~Input()
@@ -79,6 +94,15 @@ bool Input::open(Property &_options)
         return false;
     }
 
+    string policy = general_options.check("input_arbitration", Value("priority"), "priority/newest").asString();
+    if (policy == "priority") { m_arbitration_policy = ARBITRATION_PRIORITY; }
+    else if (policy == "newest") { m_arbitration_policy = ARBITRATION_NEWEST; }
+    else
+    {
+        yCError(INPUT_HND) << "Invalid `input_arbitration` param:" << policy << "(valid values: priority, newest)";
+        return false;
+    }
+
     //read section [BASECTRL_INPUTS_XXX]
     for (size_t i=0; i< input_size; i++)
     {
@@ -91,10 +115,11 @@ bool Input::open(Property &_options)
         }
         yarp::os::Bottle& input_options = ctrl_options.findGroup(buff);
 
-        //read param nws_name
+        //read param nws_name, or shm_name
         std::string nws_device_name; //should be something like: mobileBaseVelocityControl_nws_yarp
         nws_device_name = input_options.find("nws_name").asString();
-        if (nws_device_name.empty()) {
+        std::string shm_name = input_options.find("shm_name").asString();
+        if (nws_device_name.empty() && shm_name.empty()) {
             yCError(INPUT_HND) << "Missing or invalid `nws_device_name` parameter";
             return false;
         }
@@ -113,8 +138,33 @@ bool Input::open(Property &_options)
             max_timeout = input_options.find("max_timeout").asFloat64();
         }
 
-        //open the nws
+        //arbitration: by default, the inputs listed first win
         inputManager anInputM;
+        anInputM.m_max_timeout = max_timeout;
+        anInputM.m_priority = input_options.check("priority", Value((int)i), "lower values win").asInt32();
+        anInputM.m_hold_time = input_options.check("hold_time", Value(2.0), "time [s] the input keeps the control after its last command").asFloat64();
+        if (anInputM.m_hold_time < 0)
+        {
+            yCError(INPUT_HND) << "Invalid `hold_time` parameter: it must be >= 0";
+            return false;
+        }
+
+        //the commands are read directly from a shared memory segment written by the sender
+        if (!shm_name.empty())
+        {
+            anInputM.m_name = input_name;
+            anInputM.m_shm = new velocity_shm();
+            if (anInputM.m_shm->open(shm_name) == false)
+            {
+                yCError(INPUT_HND) << "Unable to open the shared memory input" << shm_name;
+                delete anInputM.m_shm;
+                return false;
+            }
+            this->m_input.push_back(anInputM);
+            continue;
+        }
+
+        //open the nws
         Property nws_options;
         nws_options.fromString(input_options.toString());
         nws_options.put("device", nws_device_name);
@@ -132,21 +182,17 @@ bool Input::open(Property &_options)
             return false;
         }
 
-        //open the input manager
+        //open the mailbox which receives the commands from the nws
         Property inputManager_options;
-        inputManager_options.put("device", "velocityInputHandler");
         inputManager_options.put("max_timeout", max_timeout);
         inputManager_options.put("local", input_name);
+        anInputM.m_mailbox = new InputMailbox();
+        anInputM.m_mailbox->open(inputManager_options);
         anInputM.m_inputmanager_dd = new yarp::dev::PolyDriver();
-        if (anInputM.m_inputmanager_dd->open(inputManager_options) == false)
+        if (anInputM.m_inputmanager_dd->give(anInputM.m_mailbox, true) == false)
         {
-            yCError(INPUT_HND) << "Unable to open the input device `velocityInputHandler`";
-            return false;
-        }
-        anInputM.m_inputmanager_dd->view(anInputM.m_iVel);
-        if (anInputM.m_inputmanager_dd->isValid() == false || anInputM.m_iVel == nullptr)
-        {
-            yCError(INPUT_HND) << "Unable to view input interface";
+            yCError(INPUT_HND) << "Unable to open the input mailbox";
+            delete anInputM.m_mailbox;
             return false;
         }
 
@@ -162,6 +208,14 @@ bool Input::open(Property &_options)
         this->m_input.push_back(anInputM);
     }
 
+    std::stable_sort(m_input.begin(), m_input.end(),
+                     [](const inputManager& a, const inputManager& b) { return a.m_priority < b.m_priority; });
+    for (size_t i = 0; i < m_input.size(); i++)
+    {
+        yCInfo(INPUT_HND, "input %zu: %s, priority %d, max_timeout %.3fs, hold_time %.3fs", i, m_input[i].m_name.c_str(),
+               m_input[i].m_priority, m_input[i].m_max_timeout, m_input[i].m_hold_time);
+    }
+
     return true;
 }
 
@@ -204,69 +258,118 @@ void Input::read_speed_polar(const Bottle *b, double& des_dir, double& lin_spd,
 
 void Input::read_speed_cart(const Bottle *b, double& des_dir, double& lin_spd, double& ang_spd, double& pwm_gain)
 {
-     double x_speed = b->get(1).asFloat64();
-     double y_speed = b->get(2).asFloat64();
-     double t_speed = b->get(3).asFloat64();
+     speed_cart(b->get(1).asFloat64(), b->get(2).asFloat64(), b->get(3).asFloat64(), des_dir, lin_spd, ang_spd);
+     pwm_gain = b->get(4).asFloat64();
+}
+
+void Input::speed_cart(double x_speed, double y_speed, double t_speed, double& des_dir, double& lin_spd, double& ang_spd)
+{
      des_dir        = atan2(y_speed, x_speed) * RAD2DEG;
      lin_spd        = sqrt (x_speed*x_speed+y_speed*y_speed);
      ang_spd        = t_speed;
-     pwm_gain = b->get(4).asFloat64();
+}
+
+bool Input::read_command(const inputManager& input, velocity_command_t& cmd)
+{
+    if (input.m_shm)
+    {
+        velocity_shm_command c;
+        if (input.m_shm->read(c) == false)
+        {
+            return false;
+        }
+        cmd.x_vel = c.x_vel;
+        cmd.y_vel = c.y_vel;
+        cmd.theta_vel = c.theta_vel;
+        cmd.timeout = c.timeout;
+        cmd.timestamp = c.timestamp;
+        cmd.sequence = c.sequence;
+        return true;
+    }
+    return input.m_mailbox->read(cmd);
+}
+
+double Input::get_input_age()
+{
+    if (m_active_input < 0)
+    {
+        return -1;
+    }
+    return Time::now() - m_input[m_active_input].m_last_timestamp;
 }
 
 void Input::read_inputs(double& linear_speed,double& angular_speed,double& desired_direction, double& pwm_gain)
 {
+    double now = Time::now();
+
     //- - - read data - - -
+    //the mailboxes never block: each input is written by the thread of its nws
     for (auto it = m_input.begin(); it!=m_input.end(); it++)
     {
-        if (it->m_iVel)
+        velocity_command_t cmd;
+        bool rec = read_command(*it, cmd) && (now - cmd.timestamp <= it->m_max_timeout);
+        if (rec)
         {
-            double x=0;
-            double y=0;
-            double t=0;
-            bool rec = it->m_iVel->getLastVelocityCommand(x,y,t);
-            if (rec)
-            {
-                Bottle b;
-                b.addInt32(3);
-                b.addFloat64(x);
-                b.addFloat64(y);
-                b.addFloat64(t);
-                b.addFloat64(100);
-                read_speed_cart(&b, it->m_desired_direction,
-                                    it->m_linear_speed,
-                                    it->m_angular_speed,
-                                    it->m_pwm_gain);
-                it->data_received=100;
-            }
-            else
-            {
-                it->m_desired_direction=0;
-                it->m_linear_speed=0;
-                it->m_angular_speed=0;
-                it->m_pwm_gain=0;
-                //counting the TOTAL of timeouts. The counter NEVER resets.
-                it->m_timeout_counter++;
-            }
-
-            //countdown
-            if (it->data_received > 0)
-            {
-                it->data_received--;
-            }
+            speed_cart(cmd.x_vel, cmd.y_vel, cmd.theta_vel, it->m_desired_direction,
+                                                            it->m_linear_speed,
+                                                            it->m_angular_speed);
+            it->m_pwm_gain = 100;
+            it->m_last_valid = now;
+            it->m_last_timestamp = cmd.timestamp;
+            it->m_last_sequence = cmd.sequence;
+        }
+        else
+        {
+            it->m_desired_direction=0;
+            it->m_linear_speed=0;
+            it->m_angular_speed=0;
+            it->m_pwm_gain=0;
+            //counting the TOTAL of timeouts. The counter NEVER resets.
+            it->m_timeout_counter++;
         }
     }
 
-    //- - - priority test - - -
-    for (auto it = m_input.begin(); it != m_input.end(); it++)
+    //- - - arbitration - - -
+    //an input has the control for hold_time after its last valid command (with zero velocity
+    //after the command expires), so that a lower priority input does not take over immediately.
+    //With hold_time 0 it has the control only in the cycles in which it has a valid command
+    int winner = -1;
+    for (size_t i = 0; i < m_input.size(); i++)
     {
-        if (it->data_received > 0)
+        const inputManager& in = m_input[i];
+        if (in.m_last_valid < 0 || now - in.m_last_valid > in.m_hold_time)
+        {
+            continue;
+        }
+        if (winner < 0)
         {
-            desired_direction = it->m_desired_direction;
-            linear_speed = it->m_linear_speed;
-            angular_speed = it->m_angular_speed;
-            pwm_gain = it->m_pwm_gain;
-            break;
+            winner = (int)i;
+            if (m_arbitration_policy == ARBITRATION_PRIORITY) break;
         }
+        else if (in.m_last_timestamp > m_input[winner].m_last_timestamp)
+        {
+            winner = (int)i;
+        }
+    }
+    if (winner != m_active_input)
+    {
+        m_input_switches++;
+        m_active_input = winner;
+    }
+    if (winner >= 0)
+    {
+        desired_direction = m_input[winner].m_desired_direction;
+        linear_speed = m_input[winner].m_linear_speed;
+        angular_speed = m_input[winner].m_angular_speed;
+        pwm_gain = m_input[winner].m_pwm_gain;
+    }
+    else
+    {
+        //no input has the control: the robot must stop
+        desired_direction = 0;
+        linear_speed = 0;
+        angular_speed = 0;
+        pwm_gain = 0;
     }
 
     //thread watchdog
@@ -25,6 +25,8 @@
 #include <yarp/dev/INavigation2D.h>
 #include <string>
 #include <math.h>
+#include "inputMailbox.h"
+#include <velocity_shm.h>
 
 using namespace std;
 using namespace yarp::os;
@@ -49,10 +51,18 @@ protected:
         string                                            m_name;
         yarp::dev::PolyDriver*                            m_nws_dd=nullptr;
         yarp::dev::PolyDriver*                            m_inputmanager_dd = nullptr;
-        yarp::dev::Nav2D::INavigation2DVelocityActions*   m_iVel=nullptr;
+        InputMailbox*                                     m_mailbox = nullptr;
+        velocity_shm*                                     m_shm = nullptr;     //instead of the nws, for the writers on the same machine
+
+        //arbitration parameters
+        int                                               m_priority = 0;     //lower value wins
+        double                                            m_max_timeout = 0.1; //s, a command is valid for this time
+        double                                            m_hold_time = 2.0;  //s, the input keeps the control (stopping the robot) after its last valid command
 
         int                                               m_timeout_counter = 0;
-        int                                               data_received = 0;
+        uint64_t                                          m_last_sequence = 0;
+        double                                            m_last_valid = -1;
+        double                                            m_last_timestamp = -1;
 
         double                                            m_linear_speed = 0;
         double                                            m_angular_speed = 0;
@@ -62,8 +72,19 @@ protected:
         inputManager& operator=(const inputManager&) = default;
         inputManager() = default;
     };
+    //sorted by priority
     std::vector <inputManager>                    m_input;
 
+    //how the command is chosen among the inputs which have the control
+    enum arbitration_policy_enum
+    {
+        ARBITRATION_PRIORITY = 0, //the input with the highest priority
+        ARBITRATION_NEWEST = 1    //the input with the most recent command (priority on ties)
+    };
+    arbitration_policy_enum                       m_arbitration_policy = ARBITRATION_PRIORITY;
+    int                                           m_active_input = -1;
+    int                                           m_input_switches = 0;
+
 public:
 
     /**
@@ -102,14 +123,25 @@ public:
     * @param pwm_gain the pwm gain (0-100). Joypad emergency button typically sets this value to zero to stop the robot. User modules, instead, do not use this value (always set to 100)/
     */
     void   read_inputs        (double& linear_speed, double& angular_speed, double& desired_direction, double& pwm_gain);
+
+    /**
+    * Returns the age of the command of the active input, i.e. the time since it has been received.
+    * @return the age [s], or -1 if no input has the control.
+    */
+    double get_input_age();
     
 private:
 
+    //Copies the latest command of an input, from its mailbox or its shared memory segment
+    bool   read_command       (const inputManager& input, velocity_command_t& cmd);
+
     //Internal functions to extract velocity commands from a given bottle or from a joypad descriptor
     void   read_percent_polar (const Bottle *b, double& des_dir, double& lin_spd, double& ang_spd, double& pwm_gain);
     void   read_percent_cart  (const Bottle *b, double& des_dir, double& lin_spd, double& ang_spd, double& pwm_gain);
     void   read_speed_polar   (const Bottle *b, double& des_dir, double& lin_spd, double& ang_spd, double& pwm_gain);
     void   read_speed_cart    (const Bottle *b, double& des_dir, double& lin_spd, double& ang_spd, double& pwm_gain);
+    //Converts a cartesian velocity command (as received by the mailboxes) into polar coordinates
+    void   speed_cart         (double x_speed, double y_speed, double t_speed, double& des_dir, double& lin_spd, double& ang_spd);
 
     //Performs conversion from joypad stick units to metric units
     double get_linear_vel_at_100_joy()   { return linear_vel_at_100_joy; }
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "inputMailbox.h"
+#include <yarp/os/Time.h>
+
+using namespace yarp::dev;
+
+InputMailbox::InputMailbox()
+{
+    m_localName = "InputMailbox_defaultName";
+    m_slot.clear();
+}
+
+bool InputMailbox::open(yarp::os::Searchable& config)
+{
+    if (config.check("max_timeout"))
+    {
+        m_max_timeout = config.find("max_timeout").asFloat64();
+    }
+    if (config.check("local"))
+    {
+        m_localName = config.find("local").asString();
+    }
+    return true;
+}
+
+bool InputMailbox::close()
+{
+    return true;
+}
+
+ReturnValue InputMailbox::applyVelocityCommand(double x_vel, double y_vel, double theta_vel, double timeout)
+{
+    //the nws may call this method from more threads (e.g. streaming and rpc ports)
+    const double values[WORDS] = { x_vel, y_vel, theta_vel, timeout, yarp::os::Time::now() };
+    if (m_slot.write(values) == false)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
+    return ReturnValue_ok;
+}
+
+bool InputMailbox::read(velocity_command_t& cmd) const
+{
+    double values[WORDS];
+    if (m_slot.read(values, cmd.sequence) == false)
+    {
+        return false;
+    }
+    cmd.x_vel = values[0];
+    cmd.y_vel = values[1];
+    cmd.theta_vel = values[2];
+    cmd.timeout = values[3];
+    cmd.timestamp = values[4];
+    return true;
+}
+
+uint64_t InputMailbox::sequence() const
+{
+    return m_slot.sequence();
+}
+
+ReturnValue InputMailbox::getLastVelocityCommand(double& x_vel, double& y_vel, double& theta_vel)
+{
+    velocity_command_t cmd;
+    if (read(cmd) == false || yarp::os::Time::now() - cmd.timestamp > m_max_timeout)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
+    x_vel = cmd.x_vel;
+    y_vel = cmd.y_vel;
+    theta_vel = cmd.theta_vel;
+    return ReturnValue_ok;
+}
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef INPUT_MAILBOX_H
+#define INPUT_MAILBOX_H
+
+#include <yarp/dev/DeviceDriver.h>
+#include <yarp/dev/INavigation2D.h>
+#include <seqlock_slot.h>
+#include <cstdint>
+#include <string>
+
+/**
+* A velocity command received by an input, with its reception time
+*/
+struct velocity_command_t
+{
+    double   x_vel = 0;
+    double   y_vel = 0;
+    double   theta_vel = 0;
+    double   timeout = 0;       //as given by the sender
+    double   timestamp = -1;    //reception time
+    uint64_t sequence = 0;      //number of commands received so far, 0 = none
+};
+
+/**
+* Single slot mailbox holding the latest velocity command of an input.
+* The nws of the input attaches to it and writes each command from its own thread
+* (applyVelocityCommand); the control thread reads the latest one with read(),
+* which takes no locks: it just copies the slot again if a command arrived
+* meanwhile (sequence lock). While a command is being written it waits for it,
+* at most SEQLOCK_SLOT_MAX_WAIT seconds.
+*/
+class InputMailbox : public yarp::dev::DeviceDriver,
+                     public yarp::dev::Nav2D::INavigation2DVelocityActions
+{
+public:
+    InputMailbox();
+
+    //DeviceDriver
+    bool open(yarp::os::Searchable& config) override;
+    bool close() override;
+
+    //INavigation2DVelocityActions
+    yarp::dev::ReturnValue applyVelocityCommand(double x_vel, double y_vel, double theta_vel, double timeout = 0.1) override;
+    //fails if no command has been received in the last max_timeout seconds
+    yarp::dev::ReturnValue getLastVelocityCommand(double& x_vel, double& y_vel, double& theta_vel) override;
+
+    /**
+    * Copies the latest command, without locks.
+    * @return false if no command has been received yet, or if a write did not complete in time
+    */
+    bool     read(velocity_command_t& cmd) const;
+    uint64_t sequence() const;
+
+private:
+    static const size_t WORDS = 5;
+
+    std::string           m_localName;
+    double                m_max_timeout = 0.1;
+
+    //x_vel, y_vel, theta_vel, timeout, timestamp
+    seqlock_slot<WORDS>   m_slot;
+};
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "loopTiming.h"
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <fstream>
+#include <cstdio>
+
+YARP_LOG_COMPONENT(LOOP_TIMING, "navigation.baseControl.loopTiming")
+
+using namespace yarp::os;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+LoopHistogram::LoopHistogram(std::string name, double min, double bin_width) :
+    m_name(name), m_min(min), m_bin_width(bin_width)
+{
+    reset();
+}
+
+void LoopHistogram::add(double value)
+{
+    double pos = (value - m_min) / m_bin_width;
+    size_t i = 0;
+    if (pos < 0)                  i = 0;
+    else if (pos >= (double)BINS) i = BINS + 1;
+    else                          i = (size_t)pos + 1;
+    m_window[i].fetch_add(1, std::memory_order_relaxed);
+    m_total[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LoopHistogram::reset_window()
+{
+    for (auto& c : m_window) c.store(0, std::memory_order_relaxed);
+}
+
+void LoopHistogram::reset()
+{
+    reset_window();
+    for (auto& c : m_total) c.store(0, std::memory_order_relaxed);
+}
+
+void LoopHistogram::toBottle(Bottle& b, bool total) const
+{
+    const std::atomic<uint32_t>* counts = total ? m_total : m_window;
+    Bottle& h = b.addList();
+    h.addString(m_name);
+    h.addFloat64(m_min);
+    h.addFloat64(m_bin_width);
+    Bottle& c = h.addList();
+    for (size_t i = 0; i < BINS + 2; i++)
+    {
+        c.addInt32((int32_t)counts[i].load(std::memory_order_relaxed));
+    }
+}
+
+std::string LoopHistogram::toString(bool total) const
+{
+    const std::atomic<uint32_t>* counts = total ? m_total : m_window;
+    std::string s = "# " + m_name + "\n";
+    s += "< " + std::to_string(m_min) + " " + std::to_string(counts[0].load(std::memory_order_relaxed)) + "\n";
+    for (size_t i = 0; i < BINS; i++)
+    {
+        s += std::to_string(m_min + i * m_bin_width) + " " + std::to_string(counts[i + 1].load(std::memory_order_relaxed)) + "\n";
+    }
+    s += ">= " + std::to_string(m_min + BINS * m_bin_width) + " " + std::to_string(counts[BINS + 1].load(std::memory_order_relaxed)) + "\n";
+    return s;
+}
+
+double LoopHistogram::percentile(double fraction, bool total) const
+{
+    const std::atomic<uint32_t>* counts = total ? m_total : m_window;
+    uint32_t values[BINS + 2];
+    uint64_t sum = 0;
+    for (size_t i = 0; i < BINS + 2; i++)
+    {
+        values[i] = counts[i].load(std::memory_order_relaxed);
+        sum += values[i];
+    }
+    if (sum == 0)
+    {
+        return 0;
+    }
+    uint64_t acc = 0;
+    for (size_t i = 0; i < BINS + 2; i++)
+    {
+        acc += values[i];
+        if (acc >= fraction * sum)
+        {
+            return m_min + i * m_bin_width;
+        }
+    }
+    return m_min + (BINS + 1) * m_bin_width;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+LoopTiming::LoopTiming(double _period) :
+    m_period(_period),
+    m_first_cycle(true),
+    m_jitter("jitter", -_period * 1000.0, _period * 1000.0 / 25),
+    m_latency("latency", 0, _period * 1000.0 / 50),
+    m_input_age("input_age", 0, 2.0)
+{
+    reset();
+}
+
+const char* LoopTiming::stage_name(loop_stage_enum stage)
+{
+    switch (stage)
+    {
+        case STAGE_ODOMETRY: return "odometry";
+        case STAGE_INPUT:    return "input";
+        case STAGE_FILTER:   return "filter";
+        case STAGE_LIMITER:  return "limiter";
+        case STAGE_PID:      return "pid";
+        case STAGE_MOTORS:   return "motors";
+        default:             return "unknown";
+    }
+}
+
+void LoopTiming::update(stage_stats& s, uint64_t ns)
+{
+    s.count.fetch_add(1, std::memory_order_relaxed);
+    s.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t m = s.max_ns.load(std::memory_order_relaxed);
+    while (ns > m && !s.max_ns.compare_exchange_weak(m, ns, std::memory_order_relaxed)) {}
+}
+
+void LoopTiming::start_cycle()
+{
+    clock::time_point now = clock::now();
+    if (!m_first_cycle)
+    {
+        double period = std::chrono::duration<double>(now - m_cycle_start).count();
+        m_jitter.add((period - m_period) * 1000.0);
+        if (period - m_period > m_period / 2)
+        {
+            m_late_starts.fetch_add(1, std::memory_order_relaxed);
+            m_total_late_starts.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    m_first_cycle = false;
+    m_cycle_start = now;
+    m_stage_start = now;
+}
+
+void LoopTiming::end_stage(loop_stage_enum stage)
+{
+    clock::time_point now = clock::now();
+    update(m_stages[stage], std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_stage_start).count());
+    m_stage_start = now;
+}
+
+void LoopTiming::end_cycle()
+{
+    clock::time_point now = clock::now();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_cycle_start).count();
+    update(m_loop, ns);
+    m_latency.add(ns / 1.0e6);
+    m_total_cycles.fetch_add(1, std::memory_order_relaxed);
+    if (ns / 1.0e9 > m_period)
+    {
+        m_overruns.fetch_add(1, std::memory_order_relaxed);
+        m_total_overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LoopTiming::add_input_age(double age)
+{
+    if (age >= 0)
+    {
+        m_input_age.add(age * 1000.0);
+    }
+}
+
+void LoopTiming::get_stats(Bottle& b, bool total)
+{
+    Bottle& p = b.addList();
+    p.addString("period");
+    p.addFloat64(m_period);
+
+    Bottle& c = b.addList();
+    c.addString("cycles");
+    c.addInt32((int32_t)(total ? m_total_cycles.load(std::memory_order_relaxed) : m_loop.count.load(std::memory_order_relaxed)));
+
+    Bottle& o = b.addList();
+    o.addString("overruns");
+    o.addInt32((int32_t)(total ? m_total_overruns.load(std::memory_order_relaxed) : m_overruns.load(std::memory_order_relaxed)));
+
+    Bottle& l = b.addList();
+    l.addString("late_starts");
+    l.addInt32((int32_t)(total ? m_total_late_starts.load(std::memory_order_relaxed) : m_late_starts.load(std::memory_order_relaxed)));
+
+    //mean and max duration [ms] of each stage, since the last reset_window()
+    Bottle& s = b.addList();
+    s.addString("stages");
+    for (int i = 0; i < STAGE_NUM; i++)
+    {
+        uint32_t count = m_stages[i].count.load(std::memory_order_relaxed);
+        Bottle& si = s.addList();
+        si.addString(stage_name((loop_stage_enum)i));
+        si.addFloat64(count ? m_stages[i].sum_ns.load(std::memory_order_relaxed) / 1.0e6 / count : 0.0);
+        si.addFloat64(m_stages[i].max_ns.load(std::memory_order_relaxed) / 1.0e6);
+    }
+
+    Bottle& h = b.addList();
+    h.addString("histograms");
+    m_jitter.toBottle(h, total);
+    m_latency.toBottle(h, total);
+    m_input_age.toBottle(h, total);
+}
+
+void LoopTiming::print_stats()
+{
+    uint32_t count = m_loop.count.load(std::memory_order_relaxed);
+    if (count == 0)
+    {
+        return;
+    }
+    yCInfo(LOOP_TIMING, "loop: %u cycles, mean %.3fms max %.3fms, overruns: %u, late starts: %u\n", count,
+           m_loop.sum_ns.load(std::memory_order_relaxed) / 1.0e6 / count, m_loop.max_ns.load(std::memory_order_relaxed) / 1.0e6,
+           m_overruns.load(std::memory_order_relaxed), m_late_starts.load(std::memory_order_relaxed));
+    std::string ss = "stages (mean/max ms):";
+    for (int i = 0; i < STAGE_NUM; i++)
+    {
+        uint32_t n = m_stages[i].count.load(std::memory_order_relaxed);
+        char buff[64];
+        snprintf(buff, sizeof(buff), " %s %.3f/%.3f", stage_name((loop_stage_enum)i),
+                 n ? m_stages[i].sum_ns.load(std::memory_order_relaxed) / 1.0e6 / n : 0.0,
+                 m_stages[i].max_ns.load(std::memory_order_relaxed) / 1.0e6);
+        ss += buff;
+    }
+    yCInfo(LOOP_TIMING) << ss;
+    yCInfo(LOOP_TIMING, "jitter p50/p99: %+.2f/%+.2fms, input age p50/p99: %.1f/%.1fms\n",
+           m_jitter.percentile(0.5, false), m_jitter.percentile(0.99, false),
+           m_input_age.percentile(0.5, false), m_input_age.percentile(0.99, false));
+}
+
+void LoopTiming::reset_window()
+{
+    for (auto& s : m_stages)
+    {
+        s.count.store(0, std::memory_order_relaxed);
+        s.sum_ns.store(0, std::memory_order_relaxed);
+        s.max_ns.store(0, std::memory_order_relaxed);
+    }
+    m_loop.count.store(0, std::memory_order_relaxed);
+    m_loop.sum_ns.store(0, std::memory_order_relaxed);
+    m_loop.max_ns.store(0, std::memory_order_relaxed);
+    m_overruns.store(0, std::memory_order_relaxed);
+    m_late_starts.store(0, std::memory_order_relaxed);
+    m_jitter.reset_window();
+    m_latency.reset_window();
+    m_input_age.reset_window();
+}
+
+void LoopTiming::reset()
+{
+    reset_window();
+    m_total_cycles.store(0, std::memory_order_relaxed);
+    m_total_overruns.store(0, std::memory_order_relaxed);
+    m_total_late_starts.store(0, std::memory_order_relaxed);
+    m_jitter.reset();
+    m_latency.reset();
+    m_input_age.reset();
+}
+
+bool LoopTiming::dump(const std::string& filename)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        yCError(LOOP_TIMING) << "Unable to open" << filename;
+        return false;
+    }
+    file << "# period " << m_period << "s, cycles " << m_total_cycles.load(std::memory_order_relaxed)
+         << ", overruns " << m_total_overruns.load(std::memory_order_relaxed)
+         << ", late starts " << m_total_late_starts.load(std::memory_order_relaxed) << "\n";
+    file << "# histograms [ms]: lower edge of the bin, samples\n";
+    file << m_jitter.toString(true);
+    file << m_latency.toString(true);
+    file << m_input_age.toString(true);
+    yCInfo(LOOP_TIMING) << "Loop timing histograms saved to" << filename;
+    return true;
+}
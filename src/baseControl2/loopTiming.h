@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LOOP_TIMING_H
+#define LOOP_TIMING_H
+
+#include <yarp/os/Bottle.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//the stages of ControlThread::run()
+enum loop_stage_enum
+{
+    STAGE_ODOMETRY = 0,
+    STAGE_INPUT = 1,
+    STAGE_FILTER = 2,
+    STAGE_LIMITER = 3,
+    STAGE_PID = 4,
+    STAGE_MOTORS = 5,
+    STAGE_NUM = 6
+};
+
+/**
+* Histogram with fixed bins, plus an underflow and an overflow bin.
+* It is filled by a single thread and can be read by other threads without locks.
+* It counts the samples both since the last reset_window() and since the last reset().
+*/
+class LoopHistogram
+{
+public:
+    static const size_t BINS = 100;
+
+    LoopHistogram(std::string name, double min, double bin_width);
+
+    void add(double value);
+    void reset_window();
+    void reset();
+
+    /**
+    * Appends the histogram to a bottle, as (name min bin_width (underflow bins... overflow))
+    * @param total if true the samples since the last reset(), otherwise the ones since the last reset_window()
+    */
+    void toBottle(yarp::os::Bottle& b, bool total) const;
+    std::string toString(bool total) const;
+    //the value below which the given fraction of the samples lies, approximated to the upper edge of its bin
+    double percentile(double fraction, bool total) const;
+
+private:
+    std::string           m_name;
+    double                m_min;
+    double                m_bin_width;
+    std::atomic<uint32_t> m_window[BINS + 2];
+    std::atomic<uint32_t> m_total[BINS + 2];
+};
+
+/**
+* Timing instrumentation of the control loop: the time spent in each stage, the period jitter,
+* the duration of the loop and the age of the command.
+* The control thread records the samples, the other threads (rpc, module) read them: there are
+* no locks, each counter is an atomic updated with relaxed ordering.
+*/
+class LoopTiming
+{
+public:
+    /**
+    * Constructor
+    * @param _period the nominal period of the control thread [s]
+    */
+    LoopTiming(double _period);
+
+    //called by the control thread
+    void start_cycle();
+    void end_stage(loop_stage_enum stage);
+    void end_cycle();
+    void add_input_age(double age);
+
+    //called by the other threads
+    /**
+    * Appends the statistics to a bottle: the stages timings, the overruns and the histograms
+    * @param total if true the statistics since the last reset(), otherwise the ones since the last reset_window()
+    */
+    void get_stats(yarp::os::Bottle& b, bool total);
+    void print_stats();
+    void reset_window();
+    void reset();
+
+    /**
+    * Writes the histograms since the last reset() to a text file.
+    * @return false if the file cannot be written.
+    */
+    bool dump(const std::string& filename);
+
+    static const char* stage_name(loop_stage_enum stage);
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct stage_stats
+    {
+        std::atomic<uint32_t> count;
+        std::atomic<uint64_t> sum_ns;
+        std::atomic<uint64_t> max_ns;
+    };
+
+    void update(stage_stats& s, uint64_t ns);
+
+    double            m_period;
+
+    //used by the control thread only
+    clock::time_point m_cycle_start;
+    clock::time_point m_stage_start;
+    bool              m_first_cycle;
+
+    stage_stats           m_stages[STAGE_NUM];
+    stage_stats           m_loop;
+    std::atomic<uint32_t> m_overruns;       //loop longer than the period
+    std::atomic<uint32_t> m_late_starts;    //cycle started more than half a period late
+    std::atomic<uint32_t> m_total_cycles;
+    std::atomic<uint32_t> m_total_overruns;
+    std::atomic<uint32_t> m_total_late_starts;
+
+    LoopHistogram     m_jitter;     //actual period - nominal period [ms]
+    LoopHistogram     m_latency;    //duration of the loop [ms]
+    LoopHistogram     m_input_age;  //age of the command of the active input [ms]
+};
+
+#endif
@@ -59,6 +59,8 @@ int main(int argc, char *argv[])
         yCInfo(BASECONTROL_MAIN, "'no_filter' disables command filtering.");
         yCInfo(BASECONTROL_MAIN, "'no_motors' motor interface will not be opened.");
         yCInfo(BASECONTROL_MAIN, "'no_start' do not automatically enables pwm.");
+        yCInfo(BASECONTROL_MAIN, "'timing_dump <file>' saves the histograms of the control loop timing to <file> on shutdown.");
+        yCInfo(BASECONTROL_MAIN, "'no_odometry' the odometry is not computed nor published on /<local>/odometry:o.");
         yCInfo(BASECONTROL_MAIN, "'joystick_connect' tries to automatically connect to the joystickCtrl output.");
         yCInfo(BASECONTROL_MAIN, "'skip_robot_interface_check' does not connect to robotInterface/rpc (useful for simulator)");
         return 0;
@@ -25,28 +25,38 @@ void MotorControl::execute_speed(double appl_linear_speed, double appl_desired_d
 {
 }
 
-void  MotorControl::apply_motor_filter(int joint)
+void  MotorControl::apply_motor_filter()
 {
-    if (motors_filter_enabled == HZ_1)
+    int request = motors_filter_request.exchange(-1);
+    if (request >= 0)
     {
-        F[joint] = control_filters::lp_filter_1Hz(F[joint], joint);
-    }
-    else if (motors_filter_enabled == HZ_2)
-    {
-        F[joint] = control_filters::lp_filter_2Hz(F[joint], joint);
-    }
-    else if (motors_filter_enabled == HZ_4) //default
-    {
-        F[joint] = control_filters::lp_filter_4Hz(F[joint], joint);
-    }
-    else if (motors_filter_enabled == HZ_8)
-    {
-        F[joint] = control_filters::lp_filter_8Hz(F[joint], joint);
+        filter_frequency freq = (filter_frequency)request;
+        double cutoff = 0;
+        if (freq == HZ_05)     cutoff = 0.5;
+        else if (freq == HZ_1) cutoff = 1;
+        else if (freq == HZ_2) cutoff = 2;
+        else if (freq == HZ_4) cutoff = 4; //default
+        else if (freq == HZ_8) cutoff = 8;
+
+        if (motors_filter.set(cutoff, thread_period) == false)
+        {
+            yCWarning(MOTOR_CTRL, "Motors filter at %.1fHz is too high for a period of %.3fs, filter disabled", cutoff, thread_period);
+            freq = DISABLED;
+        }
+        motors_filter_enabled = freq;
     }
-    else if (motors_filter_enabled == HZ_05)
+
+    if (motors_filter.size() != F.size())
     {
-        F[joint] = control_filters::lp_filter_0_5Hz(F[joint], joint);
+        motors_filter.resize(F.size());
     }
+    motors_filter.filter(F);
+}
+
+void MotorControl::set_motors_filter(filter_frequency freq)
+{
+    //the coefficients are used by the control thread, they are changed by apply_motor_filter()
+    motors_filter_request = freq;
 }
 
 bool MotorControl::open(const Property &_options)
@@ -58,6 +68,7 @@ bool MotorControl::open(const Property &_options)
     bool ok = true;
     ok = ok & control_board_driver->view(ivel);
     ok = ok & control_board_driver->view(ienc);
+    ok = ok & control_board_driver->view(ienct);
     ok = ok & control_board_driver->view(ipwm);
     ok = ok & control_board_driver->view(ipid);
     ok = ok & control_board_driver->view(iamp);
@@ -104,11 +115,12 @@ bool MotorControl::open(const Property &_options)
     }
 
     int f = motors_options.check("motors_filter_enabled", Value(4), "motors filter frequency (1/2/4/8Hz, 0 = disabled)").asInt32();
-    motors_filter_enabled = DISABLED;
-    if (f==1) motors_filter_enabled = HZ_1;
-    else if (f==2) motors_filter_enabled = HZ_2;
-    else if (f==4) motors_filter_enabled = HZ_4;
-    else if (f==8) motors_filter_enabled = HZ_8;
+    motors_filter.resize(F.size());
+    if (f==1) set_motors_filter(HZ_1);
+    else if (f==2) set_motors_filter(HZ_2);
+    else if (f==4) set_motors_filter(HZ_4);
+    else if (f==8) set_motors_filter(HZ_8);
+    else set_motors_filter(DISABLED);
     max_motor_pwm = motors_options.check("max_motor_pwm", Value(0), "max_motor_pwm").asFloat64();
     max_motor_vel = motors_options.check("max_motor_vel", Value(0), "max_motor_vel").asFloat64();
 
@@ -121,23 +133,122 @@ bool MotorControl::open(const Property &_options)
         return false;
     }
 
+    motors_joints.resize(motors_num);
+    for (int i = 0; i < motors_num; i++)
+    {
+        motors_joints[i] = i;
+    }
+    motors_refs.assign(motors_num, 0.0);
+    int board_axes = 0;
+    ienc->getAxes(&board_axes);
+    board_axes = std::max(board_axes, motors_num);
+    motors_encs.assign(board_axes, 0.0);
+    motors_speeds.assign(board_axes, 0.0);
+    motors_times.assign(board_axes, 0.0);
+    //IPWMControl can only set all the motors of the board at once
+    int pwm_motors = 0;
+    pwm_all_axes = ipwm->getNumberOfMotors(&pwm_motors) && pwm_motors == motors_num;
+    if (pwm_all_axes == false)
+    {
+        yCWarning(MOTOR_CTRL, "The control board has %d motors instead of %d, the PWM references will be sent one at a time", pwm_motors, motors_num);
+    }
+
     return true;
 }
 
-MotorControl::MotorControl(PolyDriver* _driver)
+MotorControl::MotorControl(PolyDriver* _driver, double _period)
 {
     control_board_driver = _driver;
+    thread_period = _period;
+    motors_filter_enabled = DISABLED;
     motors_num=0;
     thread_timeout_counter = 0;
 
     max_motor_vel = 0;
     max_motor_pwm = 0;
+
+    ipid = nullptr;
+    ivel = nullptr;
+    ienc = nullptr;
+    ienct = nullptr;
+    iamp = nullptr;
+    ipwm = nullptr;
+    icmd = nullptr;
+    pwm_all_axes = false;
+    cmd_count = 0;
+    cmd_failures = 0;
+    cmd_time_sum = 0;
+    cmd_time_max = 0;
+}
+
+bool MotorControl::send_velocity_refs(const double* refs)
+{
+    double t0 = yarp::os::Time::now();
+    bool ret = ivel->velocityMove(motors_num, motors_joints.data(), refs);
+    double dt = yarp::os::Time::now() - t0;
+
+    cmd_count++;
+    cmd_time_sum += dt;
+    if (dt > cmd_time_max) cmd_time_max = dt;
+    if (!ret) cmd_failures++;
+    return ret;
+}
+
+bool MotorControl::send_pwm_refs(const double* refs)
+{
+    double t0 = yarp::os::Time::now();
+    bool ret = true;
+    if (pwm_all_axes)
+    {
+        ret = ipwm->setRefDutyCycles(refs);
+    }
+    else
+    {
+        for (int i = 0; i < motors_num; i++)
+        {
+            ret &= ipwm->setRefDutyCycle(i, refs[i]);
+        }
+    }
+    double dt = yarp::os::Time::now() - t0;
+
+    cmd_count++;
+    cmd_time_sum += dt;
+    if (dt > cmd_time_max) cmd_time_max = dt;
+    if (!ret) cmd_failures++;
+    return ret;
+}
+
+bool MotorControl::read_wheels_speeds(double* speeds, double& timestamp)
+{
+    //the timestamps of the speeds are the ones of the encoders, which are streamed together
+    if (ienct->getEncodersTimed(motors_encs.data(), motors_times.data()) == false ||
+        ienc->getEncoderSpeeds(motors_speeds.data()) == false)
+    {
+        return false;
+    }
+    std::copy(motors_speeds.begin(), motors_speeds.begin() + motors_num, speeds);
+    timestamp = *std::max_element(motors_times.begin(), motors_times.begin() + motors_num);
+    if (timestamp <= 0)
+    {
+        //the control board does not provide timestamps
+        timestamp = yarp::os::Time::now();
+    }
+    return true;
 }
 
 void MotorControl::printStats()
 {
     yCInfo(MOTOR_CTRL,"* Motor thread:\n");
     yCInfo(MOTOR_CTRL, "timeouts: %d\n", thread_timeout_counter);
+    if (cmd_count > 0)
+    {
+        yCInfo(MOTOR_CTRL, "commands: %d (%d failed), time mean: %.3fms max: %.3fms\n",
+               cmd_count, cmd_failures, cmd_time_sum / cmd_count * 1000.0, cmd_time_max * 1000.0);
+    }
+    cmd_count = 0;
+    cmd_failures = 0;
+    cmd_time_sum = 0;
+    cmd_time_max = 0;
 
     double val = 0;
     for (int i=0; i<motors_num; i++)
@@ -225,9 +336,9 @@ void MotorControl::updateControlMode()
 {
     board_control_modes_last = board_control_modes;
     
+    icmd->getControlModes(motors_num, motors_joints.data(), board_control_modes.data());
     for (int i = 0; i < motors_num; i++)
     {
-        icmd->getControlMode(i, &board_control_modes[i]);
         if (board_control_modes[i] == VOCAB_CM_HW_FAULT && board_control_modes_last[i] != VOCAB_CM_HW_FAULT)
         {
             yCWarning(MOTOR_CTRL,"One motor is in fault status. Turning off control.");
@@ -23,6 +23,9 @@
 #include <string>
 #include <math.h>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include "filters.h"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -51,12 +54,15 @@ protected:
 
     double              max_motor_pwm;
     double              max_motor_vel;
+    double              thread_period;
 
 public:
     enum filter_frequency {DISABLED=0, HZ_05=1, HZ_1=2, HZ_2=3, HZ_4=4, HZ_8=5};
 
 protected:
     filter_frequency           motors_filter_enabled;
+    std::atomic<int>           motors_filter_request{-1}; //set by set_motors_filter(), applied by apply_motor_filter() (-1 = none)
+    control_filters::lp_filter_multi motors_filter;
     string                     localName;
     BufferedPort<Bottle>       port_status;
 
@@ -65,11 +71,43 @@ protected:
     IPidControl           *ipid;
     IVelocityControl      *ivel;
     IEncoders             *ienc;
+    IEncodersTimed        *ienct;
     IAmplifierControl     *iamp;
     IPWMControl           *ipwm;
     IControlMode          *icmd;
 
+    //the references of all the wheels are sent with a single multi-joint call
+    std::vector<int>      motors_joints;
+    std::vector<double>   motors_refs;
+    bool                  pwm_all_axes;
+
+    //buffers of read_wheels_speeds(), sized as the axes of the control board
+    std::vector<double>   motors_encs;
+    std::vector<double>   motors_speeds;
+    std::vector<double>   motors_times;
+
+    //duration of the calls sending the references to the control board, since the last printStats()
+    int                   cmd_count;
+    int                   cmd_failures;
+    double                cmd_time_sum;
+    double                cmd_time_max;
+
 protected:
+    /**
+    * Sends the velocity references of all the motors to the control board, in a single call.
+    * @param refs the reference of each motor (motors_num values)
+    * @return true if the command was accepted.
+    */
+    bool send_velocity_refs(const double* refs);
+
+    /**
+    * Sends the PWM references of all the motors to the control board, in a single call
+    * if the control board has no other motors.
+    * @param refs the reference of each motor (motors_num values)
+    * @return true if the command was accepted.
+    */
+    bool send_pwm_refs(const double* refs);
+
     /**
     * Decouples the control, i.e. computes the individual motor commands, given the robot velocity command in the cartesian space.
     * @param appl_linear_speed the mobile base linear speed
@@ -82,8 +120,9 @@ public:
     /**
     * Constructor
     * @param _driver is a pointer to a remoteControlBoard driver.
+    * @param _period the period of the control thread [s], used to compute the coefficients of the motors filter.
     */
-    MotorControl(PolyDriver* _driver);
+    MotorControl(PolyDriver* _driver, double _period);
 
     /**
     * Destructor
@@ -160,8 +199,9 @@ public:
     /**
     * Enable/Disable/Sets the frequency of the motor output low pass filter. Filtering is performed by apply_motor_filter()
     * @param freq the low pass filter frequency (or filter_frequency::DISABLED) to turn off the filter
+    * The filter is changed by the control thread at its next call to apply_motor_filter(), so this can be called from any thread.
     */
-    virtual void set_motors_filter(filter_frequency freq) {motors_filter_enabled=freq;}
+    virtual void set_motors_filter(filter_frequency freq);
 
     /**
     * Return the maximum value of joint velocity, as defined in the configuration parameters.
@@ -176,10 +216,17 @@ public:
     virtual double get_max_motor_pwm()   {return max_motor_pwm;}
 
     /**
-    * Apply a low pass filter to motor output. The frequency is defined by motors_filter_enabled variable.
-    * @param joint the joint number
+    * Reads the speeds of all the motors, as measured by the encoders of the control board.
+    * @param speeds the speed of each motor [deg/s] (motors_num values)
+    * @param timestamp the time of the encoders sample, as sent by the control board
+    * @return true if the speeds have been read.
+    */
+    bool read_wheels_speeds(double* speeds, double& timestamp);
+
+    /**
+    * Apply a low pass filter to the output of all the motors. The frequency is defined by motors_filter_enabled variable.
     */
-    virtual void  apply_motor_filter(int joint);
+    virtual void  apply_motor_filter();
 };
 
 #endif
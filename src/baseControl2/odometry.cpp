@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "odometry.h"
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+
+YARP_LOG_COMPONENT(ODOMETRY, "navigation.baseControl.odometry")
+
+Odometry::Odometry(int _wheels_num, double _period)
+{
+    wheels_num = _wheels_num;
+    thread_period = _period;
+    wheels_speeds.resize(wheels_num, 0.0);
+
+    geom_r = 0;
+    geom_L = 0;
+
+    odom_theta_rad = 0;
+    last_base_vel[0] = last_base_vel[1] = last_base_vel[2] = 0;
+    last_timestamp = -1;
+
+    samples_count = 0;
+    skipped_count = 0;
+    dt_max = 0;
+}
+
+Odometry::~Odometry()
+{
+    close();
+}
+
+bool Odometry::open(const Property &_options)
+{
+    ctrl_options = _options;
+    localName = ctrl_options.find("local").asString();
+
+    bool ret = port_odometry.open((localName + "/odometry:o").c_str());
+    if (ret == false)
+    {
+        yCError(ODOMETRY) << "Unable to open module ports";
+        return false;
+    }
+    return true;
+}
+
+void Odometry::close()
+{
+    port_odometry.interrupt();
+    port_odometry.close();
+}
+
+void Odometry::integrate(double dt, const double* base_vel)
+{
+    //the base velocity at the beginning, in the middle and at the end of the interval
+    double vx[3] = { last_base_vel[0], (last_base_vel[0] + base_vel[0]) / 2, base_vel[0] };
+    double vy[3] = { last_base_vel[1], (last_base_vel[1] + base_vel[1]) / 2, base_vel[1] };
+    double vt[3] = { last_base_vel[2] * DEG2RAD, (last_base_vel[2] + base_vel[2]) / 2 * DEG2RAD, base_vel[2] * DEG2RAD };
+
+    //the heading does not depend on the position, so k2 and k3 share the same velocity sample
+    double t1 = odom_theta_rad;
+    double t2 = odom_theta_rad + dt / 2 * vt[0];
+    double t3 = odom_theta_rad + dt / 2 * vt[1];
+    double t4 = odom_theta_rad + dt * vt[1];
+
+    double k1x = vx[0] * cos(t1) - vy[0] * sin(t1);
+    double k1y = vx[0] * sin(t1) + vy[0] * cos(t1);
+    double k2x = vx[1] * cos(t2) - vy[1] * sin(t2);
+    double k2y = vx[1] * sin(t2) + vy[1] * cos(t2);
+    double k3x = vx[1] * cos(t3) - vy[1] * sin(t3);
+    double k3y = vx[1] * sin(t3) + vy[1] * cos(t3);
+    double k4x = vx[2] * cos(t4) - vy[2] * sin(t4);
+    double k4y = vx[2] * sin(t4) + vy[2] * cos(t4);
+
+    odom_data.odom_x += dt / 6 * (k1x + 2 * k2x + 2 * k3x + k4x);
+    odom_data.odom_y += dt / 6 * (k1y + 2 * k2y + 2 * k3y + k4y);
+    odom_theta_rad   += dt / 6 * (vt[0] + 4 * vt[1] + vt[2]);
+}
+
+bool Odometry::update(MotorControl* motors)
+{
+    double timestamp = 0;
+    if (motors->read_wheels_speeds(wheels_speeds.data(), timestamp) == false)
+    {
+        return false;
+    }
+
+    double base_vel[3];
+    compute_base_velocity(wheels_speeds.data(), base_vel[0], base_vel[1], base_vel[2]);
+
+    std::lock_guard<std::mutex> lock(data_mutex);
+    double dt = timestamp - last_timestamp;
+    if (last_timestamp >= 0 && dt <= 0)
+    {
+        //the control board has not sent a new sample yet
+        return false;
+    }
+    if (last_timestamp < 0 || dt > 5 * thread_period)
+    {
+        //first sample, or the encoders stream has been interrupted: restart from the current velocity
+        if (last_timestamp >= 0) skipped_count++;
+        dt = 0;
+    }
+    else
+    {
+        integrate(dt, base_vel);
+    }
+    last_timestamp = timestamp;
+    last_base_vel[0] = base_vel[0];
+    last_base_vel[1] = base_vel[1];
+    last_base_vel[2] = base_vel[2];
+
+    samples_count++;
+    if (dt > dt_max) dt_max = dt;
+
+    if (odom_theta_rad >= M_PI)  odom_theta_rad -= 2 * M_PI;
+    if (odom_theta_rad < -M_PI)  odom_theta_rad += 2 * M_PI;
+    double c = cos(odom_theta_rad);
+    double s = sin(odom_theta_rad);
+    odom_data.odom_theta     = odom_theta_rad * RAD2DEG;
+    odom_data.base_vel_x     = base_vel[0];
+    odom_data.base_vel_y     = base_vel[1];
+    odom_data.base_vel_theta = base_vel[2];
+    odom_data.odom_vel_x     = base_vel[0] * c - base_vel[1] * s;
+    odom_data.odom_vel_y     = base_vel[0] * s + base_vel[1] * c;
+    odom_data.odom_vel_theta = base_vel[2];
+    timeStamp.update(timestamp);
+    return true;
+}
+
+void Odometry::broadcast()
+{
+    if (port_odometry.getOutputCount() == 0)
+    {
+        return;
+    }
+    OdometryData& b = port_odometry.prepare();
+    {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        b = odom_data;
+        port_odometry.setEnvelope(timeStamp);
+    }
+    port_odometry.write();
+}
+
+void Odometry::reset_odometry()
+{
+    std::lock_guard<std::mutex> lock(data_mutex);
+    odom_data.odom_x = 0;
+    odom_data.odom_y = 0;
+    odom_data.odom_theta = 0;
+    odom_theta_rad = 0;
+    yCInfo(ODOMETRY, "Odometry reset done");
+}
+
+OdometryData Odometry::get_odometry()
+{
+    std::lock_guard<std::mutex> lock(data_mutex);
+    return odom_data;
+}
+
+void Odometry::printStats()
+{
+    std::lock_guard<std::mutex> lock(data_mutex);
+    yCInfo(ODOMETRY, "* Odometry:\n");
+    yCInfo(ODOMETRY, "pose: %+.3f %+.3f %+.2f  velocity: %+.3f %+.3f %+.2f\n",
+           odom_data.odom_x, odom_data.odom_y, odom_data.odom_theta,
+           odom_data.base_vel_x, odom_data.base_vel_y, odom_data.base_vel_theta);
+    yCInfo(ODOMETRY, "samples: %d, interruptions: %d, max interval: %.3fms\n", samples_count, skipped_count, dt_max * 1000.0);
+    samples_count = 0;
+    skipped_count = 0;
+    dt_max = 0;
+}
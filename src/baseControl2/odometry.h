@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/dev/OdometryData.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "motors.h"
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::dev;
+
+class Odometry
+{
+protected:
+    Property                          ctrl_options;
+    string                            localName;
+    double                            thread_period;
+    std::mutex                        data_mutex;
+
+    //the wheels speeds [deg/s], read from the encoders of the control board
+    int                               wheels_num;
+    std::vector<double>               wheels_speeds;
+
+    //robot geometry
+    double                            geom_r;
+    double                            geom_L;
+
+    //the integrated pose (odom_x, odom_y [m], odom_theta [deg]) and the velocities
+    OdometryData                      odom_data;
+    double                            odom_theta_rad;
+    double                            last_base_vel[3];    //vel_x, vel_y [m/s], vel_theta [deg/s] of the previous sample
+    double                            last_timestamp;      //<0 until the first sample
+
+    //samples since the last printStats()
+    int                               samples_count;
+    int                               skipped_count;
+    double                            dt_max;
+
+    Stamp                             timeStamp;
+    BufferedPort<OdometryData>        port_odometry;
+
+protected:
+    /**
+    * Computes the velocity of the base, expressed in the robot reference frame, from the wheels speeds.
+    * @param speeds the wheels speeds [deg/s] (wheels_num values)
+    * @param vel_x the forward velocity [m/s]
+    * @param vel_y the lateral velocity [m/s]
+    * @param vel_theta the angular velocity [deg/s]
+    */
+    virtual void compute_base_velocity(const double* speeds, double& vel_x, double& vel_y, double& vel_theta) = 0;
+
+    /**
+    * Integrates the pose over dt with a fourth order Runge-Kutta, assuming that the base velocity
+    * changes linearly from the previous sample to the current one.
+    */
+    void integrate(double dt, const double* base_vel);
+
+public:
+    /**
+    * Constructor
+    * @param _wheels_num the number of wheels of the robot.
+    * @param _period the period of the control thread [s].
+    */
+    Odometry(int _wheels_num, double _period);
+
+    /**
+    * Destructor
+    */
+    virtual ~Odometry();
+
+    /**
+    * Opens the odometry module, parsing the given options
+    * @param _options the configuration option for the module
+    * @return true if the odometry module opened successfully. False if a mandatory parameter is missing or invalid.
+    */
+    virtual bool open(const Property &_options);
+
+    /**
+    * Closes the odometry module.
+    */
+    virtual void close();
+
+    /**
+    * Reads the wheels speeds and integrates the odometry up to their timestamp.
+    * @param motors the motor handler which owns the control board interfaces.
+    * @return true if a new sample has been integrated.
+    */
+    bool update(MotorControl* motors);
+
+    /**
+    * Publishes the current odometry, stamped with the time of the encoders sample.
+    */
+    void broadcast();
+
+    /**
+    * Resets the integrated pose to zero.
+    */
+    void reset_odometry();
+
+    /**
+    * Returns a copy of the current odometry.
+    */
+    OdometryData get_odometry();
+
+    /**
+    * Print stats about the current internal status.
+    */
+    void printStats();
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "deadline_command.h"
+
+deadline_command::deadline_command()
+{
+    m_slot.clear();
+}
+
+bool deadline_command::post(double x_vel, double y_vel, double theta_vel, double timeout, double now)
+{
+    const double values[WORDS] = { x_vel, y_vel, theta_vel, now, now + timeout };
+    return m_slot.write(values);
+}
+
+bool deadline_command::read(deadline_command_data& cmd) const
+{
+    double values[WORDS];
+    if (m_slot.read(values, cmd.sequence) == false)
+    {
+        return false;
+    }
+    cmd.x_vel = values[0];
+    cmd.y_vel = values[1];
+    cmd.theta_vel = values[2];
+    cmd.timestamp = values[3];
+    cmd.expiry = values[4];
+    return true;
+}
+
+uint64_t deadline_command::sequence() const
+{
+    return m_slot.sequence();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+deadline_command_reader::deadline_command_reader() : m_last_sequence(0), m_expired_sequence(0)
+{
+}
+
+deadline_event_enum deadline_command_reader::poll(const deadline_command& channel, double now, deadline_command_data& cmd)
+{
+    if (channel.read(cmd) == false)
+    {
+        return DEADLINE_EMPTY;
+    }
+    if (cmd.expired(now))
+    {
+        m_last_sequence.store(cmd.sequence, std::memory_order_relaxed);
+        if (m_expired_sequence.exchange(cmd.sequence, std::memory_order_relaxed) != cmd.sequence)
+        {
+            return DEADLINE_EXPIRED;
+        }
+        return DEADLINE_STALE;
+    }
+    if (m_last_sequence.exchange(cmd.sequence, std::memory_order_relaxed) != cmd.sequence)
+    {
+        return DEADLINE_CHANGED;
+    }
+    return DEADLINE_UNCHANGED;
+}
+
+void deadline_command_reader::reset()
+{
+    m_last_sequence.store(0, std::memory_order_relaxed);
+    m_expired_sequence.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef NAVIGATION_DEADLINE_COMMAND_H
+#define NAVIGATION_DEADLINE_COMMAND_H
+
+#include <seqlock_slot.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A velocity command, as read from a deadline_command
+struct deadline_command_data
+{
+    double   x_vel = 0;         //m/s
+    double   y_vel = 0;         //m/s
+    double   theta_vel = 0;     //deg/s
+    double   timestamp = -1;    //time of the post()
+    double   expiry = -1;       //absolute time after which the command must not be applied anymore (inf = never)
+    uint64_t sequence = 0;      //0 = nothing posted yet
+
+    bool expired(double now) const { return now >= expiry; }
+};
+
+// Single slot channel holding the latest velocity command together with its absolute expiry time,
+// so that each layer does not have to resend it periodically nor to keep its own timeout logic.
+// post() is called by the producers (e.g. applyVelocityCommand()) from any thread; the consumers
+// copy the latest command without locks (seqlock_slot) and, through a
+// deadline_command_reader, handle it only when it changes or when it expires.
+class deadline_command
+{
+public:
+    deadline_command();
+
+    // writer side (any thread)
+    // timeout [s] is relative to now: the command expires at now+timeout (never if timeout is inf)
+    // It returns false if another post() did not complete in time.
+    bool post(double x_vel, double y_vel, double theta_vel, double timeout, double now);
+
+    // reader side (any thread). It returns false if nothing has been posted yet, or if a post() did not complete in time.
+    bool read(deadline_command_data& cmd) const;
+    // number of commands posted so far
+    uint64_t sequence() const;
+
+private:
+    static const size_t   WORDS = 5;     //x_vel, y_vel, theta_vel, timestamp, expiry
+
+    seqlock_slot<WORDS>   m_slot;
+};
+
+enum deadline_event_enum
+{
+    DEADLINE_EMPTY = 0,         //nothing posted yet
+    DEADLINE_CHANGED = 1,       //a command not seen before, still valid
+    DEADLINE_UNCHANGED = 2,     //the same command of the previous poll(), still valid
+    DEADLINE_EXPIRED = 3,       //the command has just expired: reported once per command
+    DEADLINE_STALE = 4          //the command expired, and this has been already reported
+};
+
+// The state of a consumer of a deadline_command: it turns the latest command into events, so
+// that the consumer acts on the changes and on the expiry only.
+// poll() can be called by more threads: each event is reported to one of them.
+class deadline_command_reader
+{
+public:
+    deadline_command_reader();
+
+    deadline_event_enum poll(const deadline_command& channel, double now, deadline_command_data& cmd);
+    // the next poll() reports the current command as CHANGED (or EXPIRED) again
+    void reset();
+
+private:
+    std::atomic<uint64_t> m_last_sequence;
+    std::atomic<uint64_t> m_expired_sequence;
+};
+
+#endif
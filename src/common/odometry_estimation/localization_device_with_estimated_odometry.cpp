@@ -6,6 +6,7 @@
 #define _USE_MATH_DEFINES
 #include "localization_device_with_estimated_odometry.h"
 #include <yarp/math/Math.h>
+#include <cmath>
 
 using namespace yarp::os;
 using namespace yarp::dev::Nav2D;
@@ -20,45 +21,107 @@ using namespace yarp::dev::Nav2D;
 
 
 //////////////////////////
+void velocity_filter_1d::reset(double z)
+{
+    pos = z;
+    vel = 0;
+    P[0][0] = meas_var;
+    P[0][1] = P[1][0] = 0;
+    P[1][1] = acc_var; //unknown velocity, about 1s of acceleration
+}
+
+void velocity_filter_1d::predict(double dt)
+{
+    pos += vel * dt;
+    double dt2 = dt * dt;
+    double p00 = P[0][0] + dt * (P[0][1] + P[1][0]) + dt2 * P[1][1] + acc_var * dt2 * dt2 / 4;
+    double p01 = P[0][1] + dt * P[1][1] + acc_var * dt2 * dt / 2;
+    double p11 = P[1][1] + acc_var * dt2;
+    P[0][0] = p00;
+    P[0][1] = P[1][0] = p01;
+    P[1][1] = p11;
+}
+
+void velocity_filter_1d::update(double residual)
+{
+    double s = P[0][0] + meas_var;
+    double k0 = P[0][0] / s;
+    double k1 = P[1][0] / s;
+    pos += k0 * residual;
+    vel += k1 * residual;
+    double p00 = (1 - k0) * P[0][0];
+    double p01 = (1 - k0) * P[0][1];
+    double p11 = P[1][1] - k1 * P[0][1];
+    P[0][0] = p00;
+    P[0][1] = P[1][0] = p01;
+    P[1][1] = p11;
+}
+
 localization_device_with_estimated_odometry::localization_device_with_estimated_odometry()
 {
-    m_estimator = new iCub::ctrl::AWLinEstimator(3, 3);
+    setOdometryEstimationNoise(0.01, 0.5, 2.0, 90.0);
 }
 
 localization_device_with_estimated_odometry::~localization_device_with_estimated_odometry()
 {
-    delete m_estimator;
-    m_estimator=nullptr;
 }
 
-yarp::dev::OdometryData localization_device_with_estimated_odometry::estimateOdometry(const yarp::dev::Nav2D::Map2DLocation& m_localization_data)
+void localization_device_with_estimated_odometry::setOdometryEstimationNoise(double linear_noise, double angular_noise, double linear_acc, double angular_acc)
+{
+    const std::lock_guard<std::mutex> lock(m_current_odom_mutex);
+    m_filter_x.meas_var = m_filter_y.meas_var = linear_noise * linear_noise;
+    m_filter_x.acc_var = m_filter_y.acc_var = linear_acc * linear_acc;
+    m_filter_theta.meas_var = angular_noise * angular_noise;
+    m_filter_theta.acc_var = angular_acc * angular_acc;
+    m_last_estimate_time = -1;
+}
+
+yarp::dev::OdometryData localization_device_with_estimated_odometry::estimateOdometry(const yarp::dev::Nav2D::Map2DLocation& m_localization_data, double timestamp)
 {
-    m_current_odom_mutex.lock();
+    const std::lock_guard<std::mutex> lock(m_current_odom_mutex);
+    if (timestamp < 0)
+    {
+        timestamp = Time::now();
+    }
+    m_current_odom.odom_x = m_localization_data.x;
+    m_current_odom.odom_y = m_localization_data.y;
+    m_current_odom.odom_theta = m_localization_data.theta;
+
     //m_current_loc is in the world reference frame.
     // hence this velocity is estimated in the world reference frame.
-    iCub::ctrl::AWPolyElement el;
-    el.data = yarp::sig::Vector(3);
-    el.data[0] = m_current_odom.odom_x = m_localization_data.x;
-    el.data[1] = m_current_odom.odom_y = m_localization_data.y;
-    el.data[2] = m_current_odom.odom_theta = m_localization_data.theta;
-    el.time = Time::now();
-    m_odom_vel.resize(3, 0.0);
-    m_odom_vel = m_estimator->estimate(el);
-    m_current_odom.odom_vel_x = m_odom_vel[0];
-    m_current_odom.odom_vel_y = m_odom_vel[1];
-    m_current_odom.odom_vel_theta = m_odom_vel[2];
+    double dt = timestamp - m_last_estimate_time;
+    if (m_last_estimate_time < 0 || dt > m_max_estimate_gap || dt < 0 ||
+        std::isfinite(m_localization_data.x + m_localization_data.y + m_localization_data.theta) == false)
+    {
+        m_filter_x.reset(m_localization_data.x);
+        m_filter_y.reset(m_localization_data.y);
+        m_filter_theta.reset(m_localization_data.theta);
+        m_last_estimate_time = timestamp;
+    }
+    else if (dt > 0)
+    {
+        m_filter_x.predict(dt);
+        m_filter_y.predict(dt);
+        m_filter_theta.predict(dt);
+        m_filter_x.update(m_localization_data.x - m_filter_x.pos);
+        m_filter_y.update(m_localization_data.y - m_filter_y.pos);
+        //the angle residual is wrapped, and the estimated angle is kept close to the measured one
+        m_filter_theta.update(remainder(m_localization_data.theta - m_filter_theta.pos, 360.0));
+        m_filter_theta.pos = m_localization_data.theta + remainder(m_filter_theta.pos - m_localization_data.theta, 360.0);
+        m_last_estimate_time = timestamp;
+    }
+    m_current_odom.odom_vel_x = m_filter_x.vel;
+    m_current_odom.odom_vel_y = m_filter_y.vel;
+    m_current_odom.odom_vel_theta = m_filter_theta.vel;
 
     //this is the velocity in robot reference frame.
     //NB: for a non-holonomic robot robot_vel[1] ~= 0
-    m_robot_vel.resize(3, 0.0);
-    m_robot_vel[0] = m_odom_vel[0] * cos(m_localization_data.theta * DEG2RAD) + m_odom_vel[1] * sin(m_localization_data.theta * DEG2RAD);
-    m_robot_vel[1] = - m_odom_vel[0] * sin(m_localization_data.theta * DEG2RAD) + m_odom_vel[1] * cos(m_localization_data.theta * DEG2RAD);
-    m_robot_vel[2] = m_odom_vel[2];
-    m_current_odom.base_vel_x = m_robot_vel[0];
-    m_current_odom.base_vel_y = m_robot_vel[1];
-    m_current_odom.base_vel_theta = m_robot_vel[2];
-
-    m_current_odom_mutex.unlock();
+    double c = cos(m_localization_data.theta * DEG2RAD);
+    double s = sin(m_localization_data.theta * DEG2RAD);
+    m_current_odom.base_vel_x = m_current_odom.odom_vel_x * c + m_current_odom.odom_vel_y * s;
+    m_current_odom.base_vel_y = - m_current_odom.odom_vel_x * s + m_current_odom.odom_vel_y * c;
+    m_current_odom.base_vel_theta = m_current_odom.odom_vel_theta;
+
     return m_current_odom;
 }
 
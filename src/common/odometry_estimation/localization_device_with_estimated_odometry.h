@@ -16,23 +16,44 @@
 #include <yarp/dev/IFrameTransform.h>
 #include <mutex>
 #include <math.h>
-#include <iCub/ctrl/adaptWinPolyEstimator.h>
 
 using namespace yarp::os;
 
+// Constant velocity Kalman filter of a single coordinate. Each update costs
+// O(1) and handles any interval between two samples.
+struct velocity_filter_1d
+{
+    double pos = 0;
+    double vel = 0;
+    double P[2][2] = { { 0, 0 }, { 0, 0 } };
+    double meas_var = 1e-4;   //variance of the measured position
+    double acc_var = 4.0;     //variance of the (white) acceleration
+
+    void reset(double z);
+    //residual: difference between the measurement and the predicted position
+    //(for angles, already wrapped by the caller)
+    void update(double residual);
+    void predict(double dt);
+};
+
 class localization_device_with_estimated_odometry
 {
 private:
     //velocity estimation
-    yarp::sig::Vector            m_odom_vel;
-    yarp::sig::Vector            m_robot_vel;
-    iCub::ctrl::AWLinEstimator*  m_estimator;
+    velocity_filter_1d           m_filter_x;
+    velocity_filter_1d           m_filter_y;
+    velocity_filter_1d           m_filter_theta;
+    double                       m_last_estimate_time = -1;
+    double                       m_max_estimate_gap = 1.0; //s, the filter restarts after longer gaps
     yarp::dev::OdometryData      m_current_odom;
     std::mutex                   m_current_odom_mutex;
 
 public:
     localization_device_with_estimated_odometry();
     virtual ~localization_device_with_estimated_odometry();
-    yarp::dev::OdometryData estimateOdometry(const yarp::dev::Nav2D::Map2DLocation& m_localization_data);
+    //timestamp < 0 means now
+    yarp::dev::OdometryData estimateOdometry(const yarp::dev::Nav2D::Map2DLocation& m_localization_data, double timestamp = -1);
     yarp::dev::OdometryData getOdometry();
+    //standard deviations of the position noise [m, deg] and of the acceleration [m/s^2, deg/s^2]
+    void setOdometryEstimationNoise(double linear_noise, double angular_noise, double linear_acc, double angular_acc);
 };
@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pose_cell.h"
+#include <cstring>
+#include <thread>
+
+using namespace yarp::dev::Nav2D;
+
+pose_cell::pose_cell() : m_seq(0)
+{
+    for (auto& w : m_data)
+    {
+        w.store(0, std::memory_order_relaxed);
+    }
+}
+
+void pose_cell::store(const payload_t& p)
+{
+    uint64_t words[PAYLOAD_WORDS] = { 0 };
+    memcpy(words, &p, sizeof(payload_t));
+
+    uint64_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < PAYLOAD_WORDS; i++)
+    {
+        m_data[i].store(words[i], std::memory_order_relaxed);
+    }
+    m_seq.store(seq + 2, std::memory_order_release);
+}
+
+uint64_t pose_cell::load(payload_t& p) const
+{
+    uint64_t words[PAYLOAD_WORDS];
+    uint64_t seq0, seq1;
+    do
+    {
+        seq0 = m_seq.load(std::memory_order_acquire);
+        while (seq0 & 1)
+        {
+            std::this_thread::yield();
+            seq0 = m_seq.load(std::memory_order_acquire);
+        }
+        for (size_t i = 0; i < PAYLOAD_WORDS; i++)
+        {
+            words[i] = m_data[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seq1 = m_seq.load(std::memory_order_relaxed);
+    } while (seq0 != seq1);
+
+    memcpy(&p, words, sizeof(payload_t));
+    return seq0 / 2;
+}
+
+void pose_cell::publish(const Map2DLocation& loc, const double cov[9], double timestamp)
+{
+    payload_t p;
+    p.x = loc.x;
+    p.y = loc.y;
+    p.theta = loc.theta;
+    p.timestamp = timestamp;
+    for (size_t i = 0; i < 9; i++)
+    {
+        p.cov[i] = cov[i];
+    }
+    memset(p.map_id, 0, sizeof(p.map_id));
+    strncpy(p.map_id, loc.map_id.c_str(), POSE_CELL_MAP_ID_SIZE - 1);
+    store(p);
+}
+
+void pose_cell::publish(const Map2DLocation& loc, double timestamp)
+{
+    const double cov[9] = { 0 };
+    publish(loc, cov, timestamp);
+}
+
+void pose_cell::publish(const Map2DLocation& loc, const yarp::sig::Matrix& cov, double timestamp)
+{
+    double c[9] = { 0 };
+    for (size_t r = 0; r < 3 && r < cov.rows(); r++)
+    {
+        for (size_t k = 0; k < 3 && k < cov.cols(); k++)
+        {
+            c[r * 3 + k] = cov[r][k];
+        }
+    }
+    publish(loc, c, timestamp);
+}
+
+bool pose_cell::read(pose_cell_snapshot& snapshot) const
+{
+    payload_t p;
+    uint64_t seq = load(p);
+    if (seq == 0)
+    {
+        return false;
+    }
+    snapshot.loc.map_id = p.map_id;
+    snapshot.loc.x = p.x;
+    snapshot.loc.y = p.y;
+    snapshot.loc.theta = p.theta;
+    snapshot.timestamp = p.timestamp;
+    for (size_t i = 0; i < 9; i++)
+    {
+        snapshot.cov[i] = p.cov[i];
+    }
+    snapshot.sequence = seq;
+    return true;
+}
+
+bool pose_cell::read(Map2DLocation& loc) const
+{
+    pose_cell_snapshot snapshot;
+    if (!read(snapshot))
+    {
+        return false;
+    }
+    loc = snapshot.loc;
+    return true;
+}
+
+bool pose_cell::read(Map2DLocation& loc, yarp::sig::Matrix& cov) const
+{
+    pose_cell_snapshot snapshot;
+    if (!read(snapshot))
+    {
+        return false;
+    }
+    loc = snapshot.loc;
+    cov.resize(3, 3);
+    for (size_t r = 0; r < 3; r++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            cov[r][k] = snapshot.cov[r * 3 + k];
+        }
+    }
+    return true;
+}
+
+bool pose_cell::readIfNewer(uint64_t last_sequence, pose_cell_snapshot& snapshot) const
+{
+    //cheap check first, without copying the payload
+    if (sequence() <= last_sequence)
+    {
+        return false;
+    }
+    return read(snapshot) && snapshot.sequence > last_sequence;
+}
+
+uint64_t pose_cell::sequence() const
+{
+    return m_seq.load(std::memory_order_acquire) / 2;
+}
+
+double pose_cell::age(double now) const
+{
+    payload_t p;
+    if (load(p) == 0)
+    {
+        return -1;
+    }
+    return now - p.timestamp;
+}
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef NAVIGATION_POSE_CELL_H
+#define NAVIGATION_POSE_CELL_H
+
+#include <yarp/dev/Map2DLocation.h>
+#include <yarp/sig/Matrix.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// The latest pose estimated by a localizer, as read from a pose_cell
+struct pose_cell_snapshot
+{
+    yarp::dev::Nav2D::Map2DLocation loc;        //theta in degrees
+    double                          timestamp = -1;
+    double                          cov[9] = { 0 }; //3x3, row major (x y theta)
+    uint64_t                        sequence = 0;   //0 = nothing published yet
+};
+
+// Single writer, multiple readers cell holding the latest pose of a localizer
+// (sequence lock). If more threads publish, the caller must serialize them.
+// The localizer publishes each new estimate without ever waiting for the
+// readers; the readers never block the writer, they just copy the data
+// again if a publish() happened meanwhile. Every publish() increments the
+// sequence number, so a reader can tell a new pose from one already seen
+// by comparing it with the previous value of sequence().
+// The map name is stored in a fixed size buffer (POSE_CELL_MAP_ID_SIZE-1 chars).
+class pose_cell
+{
+public:
+    static const size_t POSE_CELL_MAP_ID_SIZE = 128;
+
+    pose_cell();
+
+    // writer side (a single thread)
+    void publish(const yarp::dev::Nav2D::Map2DLocation& loc, double timestamp);
+    void publish(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov, double timestamp);
+    void publish(const yarp::dev::Nav2D::Map2DLocation& loc, const double cov[9], double timestamp);
+
+    // reader side (any thread). They return false if nothing has been published yet.
+    bool read(pose_cell_snapshot& snapshot) const;
+    bool read(yarp::dev::Nav2D::Map2DLocation& loc) const;
+    bool read(yarp::dev::Nav2D::Map2DLocation& loc, yarp::sig::Matrix& cov) const;
+    // Reads the pose only if it is newer than last_sequence
+    bool readIfNewer(uint64_t last_sequence, pose_cell_snapshot& snapshot) const;
+
+    // number of poses published so far
+    uint64_t sequence() const;
+    // age [s] of the latest pose, with respect to now. Negative if nothing has been published.
+    double age(double now) const;
+
+private:
+    struct payload_t
+    {
+        double   x;
+        double   y;
+        double   theta;
+        double   timestamp;
+        double   cov[9];
+        char     map_id[POSE_CELL_MAP_ID_SIZE];
+    };
+    static const size_t PAYLOAD_WORDS = (sizeof(payload_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void store(const payload_t& p);
+    uint64_t load(payload_t& p) const;
+
+    // odd while a publish() is in progress, 2*sequence otherwise
+    std::atomic<uint64_t> m_seq;
+    // the payload is copied word by word through relaxed atomics, so that
+    // concurrent reads and writes are not a data race
+    std::atomic<uint64_t> m_data[PAYLOAD_WORDS];
+};
+
+#endif
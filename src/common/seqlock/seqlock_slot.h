@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef NAVIGATION_SEQLOCK_SLOT_H
+#define NAVIGATION_SEQLOCK_SLOT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+// Default time [s] a reader or a writer waits for a write in progress before giving up
+#define SEQLOCK_SLOT_MAX_WAIT 0.002
+
+// Single slot holding WORDS doubles behind a sequence lock (see pose_cell), shared by the
+// velocity command channels (InputMailbox, velocity_shm, deadline_command).
+// More writers take turns on the sequence itself (CAS); the readers copy the slot without
+// locks and copy it again if a write happened meanwhile. Both wait for a write in progress
+// at most max_wait seconds, and then fail instead of spinning forever: a writer killed in
+// the middle of a write (e.g. on a shared memory segment) leaves the sequence odd, until
+// recover() completes its write.
+// It has no constructor, so that it can be placed in a shared memory segment: call clear()
+// before using it in process memory.
+template <size_t WORDS>
+struct seqlock_slot
+{
+    std::atomic<uint64_t> seq;           //odd while a write is in progress, 2*sequence otherwise
+    std::atomic<uint64_t> data[WORDS];   //the values, stored as raw bits
+
+    void clear()
+    {
+        seq.store(0, std::memory_order_relaxed);
+        for (size_t i = 0; i < WORDS; i++)
+        {
+            data[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // false if another write did not complete within max_wait
+    bool write(const double (&values)[WORDS], double max_wait = SEQLOCK_SLOT_MAX_WAIT)
+    {
+        waiter w(max_wait);
+        uint64_t s = seq.load(std::memory_order_relaxed);
+        do
+        {
+            while (s & 1)
+            {
+                if (w.wait() == false) return false;
+                s = seq.load(std::memory_order_relaxed);
+            }
+        } while (!seq.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed));
+        std::atomic_thread_fence(std::memory_order_release);
+        store(values);
+        seq.store(s + 2, std::memory_order_release);
+        return true;
+    }
+
+    // false if nothing has been written yet, or if a write did not complete within max_wait
+    bool read(double (&values)[WORDS], uint64_t& sequence, double max_wait = SEQLOCK_SLOT_MAX_WAIT) const
+    {
+        waiter w(max_wait);
+        uint64_t words[WORDS];
+        uint64_t s0, s1;
+        do
+        {
+            s0 = seq.load(std::memory_order_acquire);
+            while (s0 & 1)
+            {
+                if (w.wait() == false) return false;
+                s0 = seq.load(std::memory_order_acquire);
+            }
+            for (size_t i = 0; i < WORDS; i++)
+            {
+                words[i] = data[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s1 = seq.load(std::memory_order_relaxed);
+        } while (s0 != s1);
+
+        if (s0 == 0)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < WORDS; i++)
+        {
+            memcpy(&values[i], &words[i], sizeof(double));
+        }
+        sequence = s0 / 2;
+        return true;
+    }
+
+    // number of writes completed so far
+    uint64_t sequence() const
+    {
+        return seq.load(std::memory_order_acquire) / 2;
+    }
+
+    // Completes with the given values a write abandoned by a writer which died.
+    // To be called only once the sequence has been odd for long enough that its writer cannot be alive.
+    // It returns false if no write was in progress.
+    bool recover(const double (&values)[WORDS])
+    {
+        uint64_t s = seq.load(std::memory_order_acquire);
+        if ((s & 1) == 0)
+        {
+            return false;
+        }
+        store(values);
+        return seq.compare_exchange_strong(s, s + 1, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+private:
+    void store(const double (&values)[WORDS])
+    {
+        for (size_t i = 0; i < WORDS; i++)
+        {
+            uint64_t b;
+            memcpy(&b, &values[i], sizeof(b));
+            data[i].store(b, std::memory_order_relaxed);
+        }
+    }
+
+    // yields until max_wait seconds have passed
+    class waiter
+    {
+    public:
+        explicit waiter(double max_wait) : m_max_wait(max_wait) {}
+        bool wait()
+        {
+            if (m_spins++ == 0)
+            {
+                m_start = std::chrono::steady_clock::now();
+            }
+            else if ((m_spins & 63) == 0 &&
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count() > m_max_wait)
+            {
+                return false;
+            }
+            std::this_thread::yield();
+            return true;
+        }
+    private:
+        double                                m_max_wait;
+        uint32_t                              m_spins = 0;
+        std::chrono::steady_clock::time_point m_start;
+    };
+};
+
+#endif
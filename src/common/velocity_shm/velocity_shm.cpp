@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "velocity_shm.h"
+#include <yarp/os/Time.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+YARP_LOG_COMPONENT(VELOCITY_SHM, "navigation.velocity_shm")
+
+// Increased when the layout of the segment changes
+static const uint64_t VELOCITY_SHM_VERSION = 1;
+// A write in progress for longer than this belongs to a writer which died [s]
+static const double   VELOCITY_SHM_ABANDONED_WRITE = 0.1;
+
+velocity_shm::velocity_shm()
+{
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "velocity_shm requires lock free 64 bit atomics");
+}
+
+velocity_shm::~velocity_shm()
+{
+    close();
+}
+
+bool velocity_shm::open(const std::string& name)
+{
+    close();
+#if defined(_WIN32)
+    yCError(VELOCITY_SHM) << "Shared memory channels are not supported on this platform";
+    return false;
+#else
+    m_name = (name.size() > 0 && name[0] == '/') ? name : "/" + name;
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT, 0660);
+    if (fd < 0)
+    {
+        yCError(VELOCITY_SHM) << "Unable to open the shared memory segment" << m_name << ":" << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (st.st_size < (off_t)sizeof(segment_t) && ftruncate(fd, sizeof(segment_t)) != 0))
+    {
+        yCError(VELOCITY_SHM) << "Unable to size the shared memory segment" << m_name << ":" << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, sizeof(segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        yCError(VELOCITY_SHM) << "Unable to map the shared memory segment" << m_name << ":" << strerror(errno);
+        return false;
+    }
+
+    //a new segment is zero filled: the first process sets the version
+    segment_t* s = static_cast<segment_t*>(p);
+    uint64_t version = 0;
+    if (!s->version.compare_exchange_strong(version, VELOCITY_SHM_VERSION) && version != VELOCITY_SHM_VERSION)
+    {
+        yCError(VELOCITY_SHM) << "The shared memory segment" << m_name << "has an incompatible layout (version" << version << ")";
+        munmap(p, sizeof(segment_t));
+        return false;
+    }
+    m_shm = s;
+    recover();
+    return true;
+#endif
+}
+
+bool velocity_shm::recover()
+{
+    if (m_shm == nullptr)
+    {
+        return false;
+    }
+    uint64_t seq = m_shm->slot.seq.load(std::memory_order_acquire);
+    if ((seq & 1) == 0)
+    {
+        return true;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(VELOCITY_SHM_ABANDONED_WRITE));
+    if (m_shm->slot.seq.load(std::memory_order_acquire) != seq)
+    {
+        //the writer is alive
+        return true;
+    }
+    yCWarning(VELOCITY_SHM) << "The shared memory segment" << m_name << "was left locked by a writer, recovering it";
+    const double stop[WORDS] = { 0, 0, 0, 0, 0 };
+    return m_shm->slot.recover(stop);
+}
+
+void velocity_shm::close()
+{
+#if !defined(_WIN32)
+    if (m_shm)
+    {
+        munmap(m_shm, sizeof(segment_t));
+    }
+#endif
+    m_shm = nullptr;
+}
+
+bool velocity_shm::write(double x_vel, double y_vel, double theta_vel, double timeout)
+{
+    if (m_shm == nullptr)
+    {
+        return false;
+    }
+    //called by control threads: a segment left locked is not recovered here, see recover()
+    const double values[WORDS] = { x_vel, y_vel, theta_vel, timeout, yarp::os::Time::now() };
+    return m_shm->slot.write(values);
+}
+
+bool velocity_shm::read(velocity_shm_command& cmd) const
+{
+    if (m_shm == nullptr)
+    {
+        return false;
+    }
+    double values[WORDS];
+    if (m_shm->slot.read(values, cmd.sequence) == false)
+    {
+        return false;
+    }
+    cmd.x_vel = values[0];
+    cmd.y_vel = values[1];
+    cmd.theta_vel = values[2];
+    cmd.timeout = values[3];
+    cmd.timestamp = values[4];
+    return true;
+}
+
+uint64_t velocity_shm::sequence() const
+{
+    if (m_shm == nullptr)
+    {
+        return 0;
+    }
+    return m_shm->slot.sequence();
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef NAVIGATION_VELOCITY_SHM_H
+#define NAVIGATION_VELOCITY_SHM_H
+
+#include <seqlock_slot.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The latest velocity command, as read from a velocity_shm
+struct velocity_shm_command
+{
+    double   x_vel = 0;         //m/s
+    double   y_vel = 0;         //m/s
+    double   theta_vel = 0;     //deg/s
+    double   timeout = 0;       //s, as given by the writer
+    double   timestamp = -1;    //yarp::os::Time::now() of the writer
+    uint64_t sequence = 0;      //0 = nothing written yet
+};
+
+// Velocity command channel between processes running on the same machine (e.g. a navigation
+// device and baseControl2), through a POSIX shared memory segment named /<name>.
+// The segment holds a seqlock_slot: the writers store each command without waiting for the
+// readers, the readers copy the latest one without locks, system calls or serialisation.
+// Either side can be started first: the segment is created by the first open() and it is
+// kept when the processes exit, so that they can be restarted independently.
+// A writer killed in the middle of write() leaves the segment locked: the readers and the
+// writers fail at once (the command times out) until recover() is called, e.g. by the next open().
+// The segment can be opened only by the processes of the same user or group.
+class velocity_shm
+{
+public:
+    velocity_shm();
+    ~velocity_shm();
+
+    bool open(const std::string& name);
+    void close();
+    bool isOpen() const { return m_shm != nullptr; }
+    const std::string& name() const { return m_name; }
+
+    // writer side (any thread). It returns false if another write did not complete in time.
+    bool write(double x_vel, double y_vel, double theta_vel, double timeout = 0.1);
+
+    // reader side (any thread). It returns false if nothing has been written yet.
+    bool read(velocity_shm_command& cmd) const;
+    // number of commands written so far
+    uint64_t sequence() const;
+
+    // Completes the write of a writer which died with a zero, already expired, command.
+    // It waits VELOCITY_SHM_ABANDONED_WRITE to be sure that the writer is not alive, so it must
+    // not be called by a real time thread. It returns false if the segment is still locked.
+    bool recover();
+
+private:
+    static const size_t   WORDS = 5;     //x_vel, y_vel, theta_vel, timeout, timestamp
+
+    struct segment_t
+    {
+        std::atomic<uint64_t> version;   //layout of the segment, set by the process which creates it
+        seqlock_slot<WORDS>   slot;      //zero filled by ftruncate() when the segment is created
+    };
+
+    std::string m_name;
+    segment_t*  m_shm = nullptr;
+};
+
+#endif
@@ -49,9 +49,15 @@ map_t *map_alloc(void)
   map->size_x = 0;
   map->size_y = 0;
   map->scale = 0;
+
+  // No likelihood field yet
+  map->max_occ_dist = 0;
   
   // Allocate storage for main map
   map->cells = (map_cell_t*) NULL;
+
+  // No precomputed ranges
+  map->range_table = NULL;
   
   return map;
 }
@@ -60,6 +66,7 @@ map_t *map_alloc(void)
 // Destroy a map
 void map_free(map_t *map)
 {
+  map_free_range_table(map);
   free(map->cells);
   free(map);
   return;
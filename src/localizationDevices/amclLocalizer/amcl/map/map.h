@@ -57,6 +57,31 @@ typedef struct
 } map_cell_t;
 
 
+// Precomputed ranges (compressed directional distance transform).
+// For each direction in [0, pi) the map is sliced in lines parallel to it,
+// half a cell apart. Each line stores the sorted coordinates along the line of
+// the obstacle cells it crosses. A range query is a search in one line,
+// looking forward or backward according to the beam direction.
+typedef struct
+{
+  // Number of directions in [0, pi)
+  int angle_count;
+
+  // Direction of each slicing
+  double *cos_a, *sin_a;
+
+  // Number of lines for each direction, and offset of the first one
+  int line_count;
+  double line_offset;
+
+  // Obstacle coordinates of line l of direction a are
+  // coords[line_start[a * (line_count + 1) + l] ... line_start[a * (line_count + 1) + l + 1]]
+  int *line_start;
+  float *coords;
+
+} map_range_table_t;
+
+
 // Description for a map
 typedef struct
 {
@@ -75,6 +100,9 @@ typedef struct
   // Max distance at which we care about obstacles, for constructing
   // likelihood field
   double max_occ_dist;
+
+  // Precomputed ranges, NULL if not built (see map_build_range_table)
+  map_range_table_t *range_table;
   
 } map_t;
 
@@ -110,6 +138,17 @@ void map_update_cspace(map_t *map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t *map, double ox, double oy, double oa, double max_range);
 
+// Precompute the ranges along angle_count directions over the whole circle,
+// so that map_lookup_range can replace map_calc_range. Returns 0 on success.
+int map_build_range_table(map_t *map, int angle_count);
+
+// Release the precomputed ranges
+void map_free_range_table(map_t *map);
+
+// Extract a single range reading from the precomputed ranges, with the beam
+// angle quantized to the table directions
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -32,6 +32,10 @@
 
 #include "amcl/map/map.h"
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 // Extract a single range reading from the map.  Unknown cells and/or
 // out-of-bound cells are treated as occupied, which makes it easy to
 // use Stage bitmap files.
@@ -118,3 +122,237 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
   }
   return max_range;
 }
+
+
+// Lines for each cell of width: a ray is looked up in the closest line, so
+// this bounds the lateral error of the lookup to 1/(2*MAP_RANGE_LINES_PER_CELL)
+#define MAP_RANGE_LINES_PER_CELL 2
+
+// Non-free cells, and cells beyond the map border, stop the rays
+static int map_blocks_ray(map_t *map, int i, int j)
+{
+  if (!MAP_VALID(map, i, j))
+    return 1;
+  return map->cells[MAP_INDEX(map, i, j)].occ_state > -1;
+}
+
+// Only the blocking cells next to a free cell can be hit by a ray
+// starting from a free cell
+static int map_is_edge(map_t *map, int i, int j)
+{
+  int di, dj;
+  if (!map_blocks_ray(map, i, j))
+    return 0;
+  for (dj = -1; dj <= 1; dj++)
+    for (di = -1; di <= 1; di++)
+      if (MAP_VALID(map, i + di, j + dj) &&
+          map->cells[MAP_INDEX(map, i + di, j + dj)].occ_state == -1)
+        return 1;
+  return 0;
+}
+
+static int map_compare_coords(const void *a, const void *b)
+{
+  float fa = *(const float*) a;
+  float fb = *(const float*) b;
+  return (fa > fb) - (fa < fb);
+}
+
+// Lines of direction a crossed by a cell: a ray crosses a cell (as in the
+// Bresenham walk of map_calc_range) when the cell center is within half a
+// cell of the ray along the minor axis.
+static void map_cell_lines(map_range_table_t *table, int a, int i, int j,
+                           int *first, int *last, float *coord)
+{
+  double c = table->cos_a[a];
+  double s = table->sin_a[a];
+  double l = -i * s + j * c + table->line_offset;
+  double h = 0.5 * ((fabs(c) > fabs(s)) ? fabs(c) : fabs(s));
+
+  *first = (int) ceil((l - h) * MAP_RANGE_LINES_PER_CELL);
+  *last = (int) floor((l + h) * MAP_RANGE_LINES_PER_CELL);
+  if (*first < 0)
+    *first = 0;
+  if (*last > table->line_count - 1)
+    *last = table->line_count - 1;
+  *coord = (float) (i * c + j * s);
+}
+
+int map_build_range_table(map_t *map, int angle_count)
+{
+  map_range_table_t *table;
+  int a, i, j, l, first, last, size;
+  float coord;
+  int *fill;
+
+  map_free_range_table(map);
+
+  // directions in [0, pi), the opposite ones are searched backward
+  if (angle_count < 2)
+    return -1;
+  table = (map_range_table_t*) calloc(1, sizeof(map_range_table_t));
+  if (!table)
+    return -1;
+  map->range_table = table;
+  table->angle_count = angle_count / 2;
+  table->cos_a = (double*) malloc(sizeof(double) * table->angle_count);
+  table->sin_a = (double*) malloc(sizeof(double) * table->angle_count);
+  if (!table->cos_a || !table->sin_a)
+  {
+    map_free_range_table(map);
+    return -1;
+  }
+  for (a = 0; a < table->angle_count; a++)
+  {
+    table->cos_a[a] = cos(a * M_PI / table->angle_count);
+    table->sin_a[a] = sin(a * M_PI / table->angle_count);
+  }
+
+  // Enough lines for any direction, including the border cells
+  size = (int) ceil(sqrt((double) (map->size_x + 2) * (map->size_x + 2) +
+                         (double) (map->size_y + 2) * (map->size_y + 2)));
+  table->line_offset = size + 1;
+  table->line_count = (2 * size + 3) * MAP_RANGE_LINES_PER_CELL;
+  table->line_start = (int*) calloc((size_t) table->angle_count * (table->line_count + 1), sizeof(int));
+  if (!table->line_start)
+  {
+    map_free_range_table(map);
+    return -1;
+  }
+
+  // First pass: count the obstacles in each line
+  for (j = -1; j <= map->size_y; j++)
+  {
+    for (i = -1; i <= map->size_x; i++)
+    {
+      if (!map_is_edge(map, i, j))
+        continue;
+      for (a = 0; a < table->angle_count; a++)
+      {
+        map_cell_lines(table, a, i, j, &first, &last, &coord);
+        for (l = first; l <= last; l++)
+          table->line_start[a * (table->line_count + 1) + l + 1]++;
+      }
+    }
+  }
+  for (a = 0; a < table->angle_count; a++)
+  {
+    int *start = table->line_start + a * (table->line_count + 1);
+    if (a > 0)
+      start[0] = start[-1];
+    for (l = 0; l < table->line_count; l++)
+      start[l + 1] += start[l];
+  }
+
+  // Second pass: store them
+  size = table->line_start[table->angle_count * (table->line_count + 1) - 1];
+  table->coords = (float*) malloc(sizeof(float) * (size > 0 ? size : 1));
+  fill = (int*) malloc(sizeof(int) * table->angle_count * (table->line_count + 1));
+  if (!table->coords || !fill)
+  {
+    free(fill);
+    map_free_range_table(map);
+    return -1;
+  }
+  memcpy(fill, table->line_start, sizeof(int) * table->angle_count * (table->line_count + 1));
+  for (j = -1; j <= map->size_y; j++)
+  {
+    for (i = -1; i <= map->size_x; i++)
+    {
+      if (!map_is_edge(map, i, j))
+        continue;
+      for (a = 0; a < table->angle_count; a++)
+      {
+        map_cell_lines(table, a, i, j, &first, &last, &coord);
+        for (l = first; l <= last; l++)
+          table->coords[fill[a * (table->line_count + 1) + l]++] = coord;
+      }
+    }
+  }
+  free(fill);
+
+  // Cells are visited in row order, which is not the order along the lines
+  for (a = 0; a < table->angle_count; a++)
+  {
+    int *start = table->line_start + a * (table->line_count + 1);
+    for (l = 0; l < table->line_count; l++)
+    {
+      if (start[l + 1] - start[l] > 1)
+        qsort(table->coords + start[l], start[l + 1] - start[l], sizeof(float), map_compare_coords);
+    }
+  }
+  return 0;
+}
+
+void map_free_range_table(map_t *map)
+{
+  map_range_table_t *table = map->range_table;
+  if (!table)
+    return;
+  free(table->cos_a);
+  free(table->sin_a);
+  free(table->line_start);
+  free(table->coords);
+  free(table);
+  map->range_table = NULL;
+}
+
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range)
+{
+  map_range_table_t *table = map->range_table;
+  int i, j, a, l, lo, hi, mid;
+  int forward = 1;
+  double x, y, s, range;
+  const float *coords;
+
+  // As map_calc_range, rays starting from a non-free cell have zero range
+  i = MAP_GXWX(map, ox);
+  j = MAP_GYWY(map, oy);
+  if (map_blocks_ray(map, i, j))
+    return 0.0;
+
+  // Closest direction, over the whole circle
+  a = (int) floor(oa * table->angle_count / M_PI + 0.5) % (2 * table->angle_count);
+  if (a < 0)
+    a += 2 * table->angle_count;
+  if (a >= table->angle_count)
+  {
+    a -= table->angle_count;
+    forward = 0;
+  }
+
+  // Pose in cells, then along and across the lines
+  x = (ox - map->origin_x) / map->scale + map->size_x / 2;
+  y = (oy - map->origin_y) / map->scale + map->size_y / 2;
+  l = (int) floor((-x * table->sin_a[a] + y * table->cos_a[a] + table->line_offset) * MAP_RANGE_LINES_PER_CELL + 0.5);
+  s = x * table->cos_a[a] + y * table->sin_a[a];
+  if (l < 0 || l >= table->line_count)
+    return 0.0;
+
+  // Binary search of the first obstacle beyond s
+  coords = table->coords;
+  lo = table->line_start[a * (table->line_count + 1) + l];
+  hi = table->line_start[a * (table->line_count + 1) + l + 1];
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (coords[mid] < s)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (forward)
+  {
+    if (lo == table->line_start[a * (table->line_count + 1) + l + 1])
+      return max_range;
+    range = (coords[lo] - s) * map->scale;
+  }
+  else
+  {
+    if (lo == table->line_start[a * (table->line_count + 1) + l])
+      return max_range;
+    range = (s - coords[lo - 1]) * map->scale;
+  }
+  return (range < max_range) ? range : max_range;
+}
@@ -32,36 +32,25 @@
 
 #include "amcl/pf/pf.h"
 #include "amcl/pf/pf_pdf.h"
-#include "amcl/pf/pf_kdtree.h"
+#include "amcl/pf/pf_hist.h"
 
 
 // Compute the required number of samples, given that there are k bins
 // with samples in them.
 static int pf_resample_limit(pf_t *pf, int k);
 
-#ifdef WIN32
-static double drand48()
-{
-    return (rand() / (RAND_MAX + 1.0));
-}
-
-static void srand48(long int seedval)
-{
-    srand(seedval);
-}
-#endif
+// Draw [count] ancestor indices from [set] into [index], according to
+// the filter resampling strategy.
+static void pf_resample_draw(pf_t *pf, pf_sample_set_t *set, int count, int *index);
 
 // Create a new filter
 pf_t *pf_alloc(int min_samples, int max_samples,
                double alpha_slow, double alpha_fast,
-               pf_init_model_fn_t random_pose_fn, void *random_pose_data)
+               pf_random_pose_fn_t random_pose_fn, void *random_pose_data)
 {
-  int i, j;
+  int i, j, k;
   pf_t *pf;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
-  
-  srand48(time(NULL));
 
   pf = calloc(1, sizeof(pf_t));
 
@@ -79,6 +68,10 @@ pf_t *pf_alloc(int min_samples, int max_samples,
   pf->pop_err = 0.01;
   pf->pop_z = 3;
   pf->dist_threshold = 0.5; 
+
+  pf->resample_type = PF_RESAMPLE_SYSTEMATIC;
+  pf_rng_seed(&pf->rng, (uint64_t) time(NULL));
+  pf->resample_index = calloc(max_samples, sizeof(int));
   
   pf->current_set = 0;
   for (j = 0; j < 2; j++)
@@ -86,19 +79,15 @@ pf_t *pf_alloc(int min_samples, int max_samples,
     set = pf->sets + j;
       
     set->sample_count = max_samples;
-    set->samples = calloc(max_samples, sizeof(pf_sample_t));
+    for (k = 0; k < 3; k++)
+      set->poses[k] = calloc(max_samples, sizeof(double));
+    set->weights = calloc(max_samples, sizeof(double));
 
     for (i = 0; i < set->sample_count; i++)
-    {
-      sample = set->samples + i;
-      sample->pose.v[0] = 0.0;
-      sample->pose.v[1] = 0.0;
-      sample->pose.v[2] = 0.0;
-      sample->weight = 1.0 / max_samples;
-    }
+      set->weights[i] = 1.0 / max_samples;
 
-    // HACK: is 3 times max_samples enough?
-    set->kdtree = pf_kdtree_alloc(3 * max_samples);
+    // Every sample occupies at most one new bin
+    set->hist = pf_hist_alloc(max_samples);
 
     set->cluster_count = 0;
     set->cluster_max_count = max_samples;
@@ -123,31 +112,41 @@ pf_t *pf_alloc(int min_samples, int max_samples,
 // Free an existing filter
 void pf_free(pf_t *pf)
 {
-  int i;
+  int i, k;
   
   for (i = 0; i < 2; i++)
   {
     free(pf->sets[i].clusters);
-    pf_kdtree_free(pf->sets[i].kdtree);
-    free(pf->sets[i].samples);
+    pf_hist_free(pf->sets[i].hist);
+    for (k = 0; k < 3; k++)
+      free(pf->sets[i].poses[k]);
+    free(pf->sets[i].weights);
   }
+  free(pf->resample_index);
   free(pf);
   
   return;
 }
 
+// Re-seed the filter random number generator
+void pf_set_seed(pf_t *pf, uint64_t seed)
+{
+  pf_rng_seed(&pf->rng, seed);
+  return;
+}
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
+  pf_vector_t pose;
   pf_pdf_gaussian_t *pdf;
   
   set = pf->sets + pf->current_set;
   
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Clear the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
@@ -156,12 +155,12 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = pf_pdf_gaussian_sample(pdf);
+    pose = pf_pdf_gaussian_sample_rng(pdf, &pf->rng);
+    set->weights[i] = 1.0 / pf->max_samples;
+    pf_sample_put_pose(set, i, pose);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_hist_insert(set->hist, pose, set->weights[i]);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -178,29 +177,102 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
 }
 
 
+// Initialize the filter using a mixture of gaussians
+void pf_init_multi(pf_t *pf, int hyp_count, const pf_vector_t *means,
+                   const double *weights, pf_matrix_t cov)
+{
+  int i, k, best, count;
+  double total;
+  pf_sample_set_t *set;
+  pf_vector_t pose;
+  pf_pdf_gaussian_t *pdf;
+
+  if (hyp_count <= 0)
+    return;
+
+  set = pf->sets + pf->current_set;
+
+  // Clear the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
+
+  set->sample_count = pf->max_samples;
+
+  total = 0.0;
+  best = 0;
+  for (k = 0; k < hyp_count; k++)
+  {
+    total += weights[k];
+    if (weights[k] > weights[best])
+      best = k;
+  }
+
+  // Compute the new sample poses; rounding leftovers go to the best hypothesis
+  i = 0;
+  for (k = 0; k < hyp_count && i < set->sample_count; k++)
+  {
+    if (k == best)
+      continue;
+    if (total > 0.0)
+      count = (int) (set->sample_count * weights[k] / total);
+    else
+      count = set->sample_count / hyp_count;
+    if (count > set->sample_count - i)
+      count = set->sample_count - i;
+    pdf = pf_pdf_gaussian_alloc(means[k], cov);
+    for (; count > 0; count--, i++)
+    {
+      pose = pf_pdf_gaussian_sample_rng(pdf, &pf->rng);
+      set->weights[i] = 1.0 / pf->max_samples;
+      pf_sample_put_pose(set, i, pose);
+      pf_hist_insert(set->hist, pose, set->weights[i]);
+    }
+    pf_pdf_gaussian_free(pdf);
+  }
+  pdf = pf_pdf_gaussian_alloc(means[best], cov);
+  for (; i < set->sample_count; i++)
+  {
+    pose = pf_pdf_gaussian_sample_rng(pdf, &pf->rng);
+    set->weights[i] = 1.0 / pf->max_samples;
+    pf_sample_put_pose(set, i, pose);
+    pf_hist_insert(set->hist, pose, set->weights[i]);
+  }
+  pf_pdf_gaussian_free(pdf);
+
+  pf->w_slow = pf->w_fast = 0.0;
+
+  // Re-compute cluster statistics
+  pf_cluster_stats(pf, set);
+
+  //set converged to 0
+  pf_init_converged(pf);
+
+  return;
+}
+
+
 // Initialize the filter using some model
 void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
+  pf_vector_t pose;
 
   set = pf->sets + pf->current_set;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Clear the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = (*init_fn) (init_data);
+    pose = (*init_fn) (init_data);
+    set->weights[i] = 1.0 / pf->max_samples;
+    pf_sample_put_pose(set, i, pose);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_hist_insert(set->hist, pose, set->weights[i]);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -225,25 +297,20 @@ int pf_update_converged(pf_t *pf)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
-  double total;
 
   set = pf->sets + pf->current_set;
   double mean_x = 0, mean_y = 0;
 
   for (i = 0; i < set->sample_count; i++){
-    sample = set->samples + i;
-
-    mean_x += sample->pose.v[0];
-    mean_y += sample->pose.v[1];
+    mean_x += set->poses[0][i];
+    mean_y += set->poses[1][i];
   }
   mean_x /= set->sample_count;
   mean_y /= set->sample_count;
   
   for (i = 0; i < set->sample_count; i++){
-    sample = set->samples + i;
-    if(fabs(sample->pose.v[0] - mean_x) > pf->dist_threshold || 
-       fabs(sample->pose.v[1] - mean_y) > pf->dist_threshold){
+    if(fabs(set->poses[0][i] - mean_x) > pf->dist_threshold || 
+       fabs(set->poses[1][i] - mean_y) > pf->dist_threshold){
       set->converged = 0; 
       pf->converged = 0; 
       return 0;
@@ -273,7 +340,6 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   double total;
 
   set = pf->sets + pf->current_set;
@@ -287,9 +353,8 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
     double w_avg=0.0;
     for (i = 0; i < set->sample_count; i++)
     {
-      sample = set->samples + i;
-      w_avg += sample->weight;
-      sample->weight /= total;
+      w_avg += set->weights[i];
+      set->weights[i] /= total;
     }
     // Update running averages of likelihood of samples (Prob Rob p258)
     w_avg /= set->sample_count;
@@ -309,8 +374,7 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
     // Handle zero total
     for (i = 0; i < set->sample_count; i++)
     {
-      sample = set->samples + i;
-      sample->weight = 1.0 / set->sample_count;
+      set->weights[i] = 1.0 / set->sample_count;
     }
   }
 
@@ -321,31 +385,39 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 // Resample the distribution
 void pf_update_resample(pf_t *pf)
 {
-  int i;
+  pf_update_resample_samples(pf);
+
+  // Re-compute cluster statistics
+  pf_cluster_stats(pf, pf->sets + pf->current_set);
+
+  return;
+}
+
+
+// Resample the distribution, without the cluster statistics
+void pf_update_resample_samples(pf_t *pf)
+{
+  int i, j, m, tmp;
   double total;
   pf_sample_set_t *set_a, *set_b;
-  pf_sample_t *sample_a, *sample_b;
-
-  //double r,c,U;
-  //int m;
-  //double count_inv;
-  double* c;
+  pf_vector_t pose;
+  int *index;
 
   double w_diff;
 
   set_a = pf->sets + pf->current_set;
   set_b = pf->sets + (pf->current_set + 1) % 2;
 
-  // Build up cumulative probability table for resampling.
-  // TODO: Replace this with a more efficient procedure
-  // (e.g., http://www.network-theory.co.uk/docs/gslref/GeneralDiscreteDistributions.html)
-  c = (double*)malloc(sizeof(double)*(set_a->sample_count+1));
-  c[0] = 0.0;
-  for(i=0;i<set_a->sample_count;i++)
-    c[i+1] = c[i]+set_a->samples[i].weight;
+  // Draw the ancestors of a full-size set in one linear pass.  KLD
+  // adaptive sampling stops after a data-dependent number of samples, so
+  // the ancestors are consumed in random order (a lazy Fisher-Yates
+  // shuffle): any prefix is then an unbiased subset of the full draw.
+  index = pf->resample_index;
+  pf_resample_draw(pf, set_a, pf->max_samples, index);
+  m = 0;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set_b->kdtree);
+  // Clear the histogram for adaptive sampling
+  pf_hist_clear(set_b->hist);
   
   // Draw samples from set a to create set b.
   total = 0;
@@ -356,74 +428,33 @@ void pf_update_resample(pf_t *pf)
     w_diff = 0.0;
   //printf("w_diff: %9.6f\n", w_diff);
 
-  // Can't (easily) combine low-variance sampler with KLD adaptive
-  // sampling, so we'll take the more traditional route.
-  /*
-  // Low-variance resampler, taken from Probabilistic Robotics, p110
-  count_inv = 1.0/set_a->sample_count;
-  r = drand48() * count_inv;
-  c = set_a->samples[0].weight;
-  i = 0;
-  m = 0;
-  */
   while(set_b->sample_count < pf->max_samples)
   {
-    sample_b = set_b->samples + set_b->sample_count++;
+    i = set_b->sample_count++;
 
-    if(drand48() < w_diff)
-      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
+    if(pf_rng_uniform(&pf->rng) < w_diff)
+      pose = (pf->random_pose_fn)(pf->random_pose_data, &pf->rng);
     else
     {
-      // Can't (easily) combine low-variance sampler with KLD adaptive
-      // sampling, so we'll take the more traditional route.
-      /*
-      // Low-variance resampler, taken from Probabilistic Robotics, p110
-      U = r + m * count_inv;
-      while(U>c)
-      {
-        i++;
-        // Handle wrap-around by resetting counters and picking a new random
-        // number
-        if(i >= set_a->sample_count)
-        {
-          r = drand48() * count_inv;
-          c = set_a->samples[0].weight;
-          i = 0;
-          m = 0;
-          U = r + m * count_inv;
-          continue;
-        }
-        c += set_a->samples[i].weight;
-      }
-      m++;
-      */
-
-      // Naive discrete event sampler
-      double r;
-      r = drand48();
-      for(i=0;i<set_a->sample_count;i++)
-      {
-        if((c[i] <= r) && (r < c[i+1]))
-          break;
-      }
-      assert(i<set_a->sample_count);
-
-      sample_a = set_a->samples + i;
-
-      assert(sample_a->weight > 0);
+      // Pick one of the remaining ancestors
+      j = m + (int) (pf_rng_uniform(&pf->rng) * (pf->max_samples - m));
+      tmp = index[j];
+      index[j] = index[m];
+      index[m] = tmp;
 
-      // Add sample to list
-      sample_b->pose = sample_a->pose;
+      pose = pf_sample_get_pose(set_a, index[m++]);
     }
 
-    sample_b->weight = 1.0;
-    total += sample_b->weight;
+    // Add sample to list
+    pf_sample_put_pose(set_b, i, pose);
+    set_b->weights[i] = 1.0;
+    total += set_b->weights[i];
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
+    pf_hist_insert(set_b->hist, pose, set_b->weights[i]);
 
     // See if we have enough samples yet
-    if (set_b->sample_count > pf_resample_limit(pf, set_b->kdtree->leaf_count))
+    if (set_b->sample_count > pf_resample_limit(pf, set_b->hist->bin_count))
       break;
   }
   
@@ -435,20 +466,107 @@ void pf_update_resample(pf_t *pf)
 
   // Normalize weights
   for (i = 0; i < set_b->sample_count; i++)
-  {
-    sample_b = set_b->samples + i;
-    sample_b->weight /= total;
-  }
-  
-  // Re-compute cluster statistics
-  pf_cluster_stats(pf, set_b);
+    set_b->weights[i] /= total;
 
   // Use the newly created sample set
   pf->current_set = (pf->current_set + 1) % 2; 
 
   pf_update_converged(pf);
 
-  free(c);
+  return;
+}
+
+
+// Draw ancestor indices.  Every strategy walks the cumulative weights
+// once, with non-decreasing pointers, so the cost is O(count + sample_count).
+void pf_resample_draw(pf_t *pf, pf_sample_set_t *set, int count, int *index)
+{
+  int i, m, k, last;
+  double total, step, u, c, r;
+  double *weights;
+
+  weights = set->weights;
+  last = set->sample_count - 1;
+
+  total = 0.0;
+  for (i = 0; i < set->sample_count; i++)
+    total += weights[i];
+
+  if (total <= 0.0)
+  {
+    // Degenerate weights: fall back to a uniform draw
+    for (m = 0; m < count; m++)
+      index[m] = m % set->sample_count;
+    return;
+  }
+
+  m = 0;
+  switch (pf->resample_type)
+  {
+    case PF_RESAMPLE_RESIDUAL:
+    {
+      // Deterministic part: floor(count * w) copies of every sample
+      step = count / total;
+      for (i = 0; i < set->sample_count && m < count; i++)
+      {
+        k = (int) floor(weights[i] * step);
+        while (k-- > 0 && m < count)
+          index[m++] = i;
+      }
+
+      // Residual part: systematic draw on the fractional remainders,
+      // which sum to the number of missing samples (spacing 1).
+      u = pf_rng_uniform(&pf->rng);
+      i = 0;
+      r = weights[0] * step;
+      c = r - floor(r);
+      for (; m < count; m++, u += 1.0)
+      {
+        while (u >= c && i < last)
+        {
+          i++;
+          r = weights[i] * step;
+          c += r - floor(r);
+        }
+        index[m] = i;
+      }
+      break;
+    }
+
+    case PF_RESAMPLE_STRATIFIED:
+    {
+      // One uniform draw in each of the [count] strata
+      step = total / count;
+      i = 0;
+      c = weights[0];
+      for (m = 0; m < count; m++)
+      {
+        u = (m + pf_rng_uniform(&pf->rng)) * step;
+        while (u >= c && i < last)
+          c += weights[++i];
+        index[m] = i;
+      }
+      break;
+    }
+
+    case PF_RESAMPLE_SYSTEMATIC:
+    default:
+    {
+      // Low-variance resampler, taken from Probabilistic Robotics, p110
+      step = total / count;
+      u = pf_rng_uniform(&pf->rng) * step;
+      i = 0;
+      c = weights[0];
+      for (m = 0; m < count; m++, u += step)
+      {
+        while (u >= c && i < last)
+          c += weights[++i];
+        index[m] = i;
+      }
+      break;
+    }
+  }
+
   return;
 }
 
@@ -483,7 +601,8 @@ int pf_resample_limit(pf_t *pf, int k)
 void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
 {
   int i, j, k, cidx;
-  pf_sample_t *sample;
+  double w, cs, sn;
+  pf_vector_t pose;
   pf_cluster_t *cluster;
   
   // Workspace
@@ -492,12 +611,13 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
   double weight;
 
   // Cluster the samples
-  pf_kdtree_cluster(set->kdtree);
+  pf_hist_cluster(set->hist);
   
-  // Initialize cluster stats
+  // Initialize cluster stats; labels are consecutive, so only the
+  // clusters found in the histogram need to be reset
   set->cluster_count = 0;
 
-  for (i = 0; i < set->cluster_max_count; i++)
+  for (i = 0; i < set->hist->cluster_count && i < set->cluster_max_count; i++)
   {
     cluster = set->clusters + i;
     cluster->count = 0;
@@ -526,12 +646,13 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
   // Compute cluster stats
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
+    pose = pf_sample_get_pose(set, i);
+    w = set->weights[i];
 
-    //printf("%d %f %f %f\n", i, sample->pose.v[0], sample->pose.v[1], sample->pose.v[2]);
+    //printf("%d %f %f %f\n", i, pose.v[0], pose.v[1], pose.v[2]);
 
     // Get the cluster label for this sample
-    cidx = pf_kdtree_get_cluster(set->kdtree, sample->pose);
+    cidx = pf_hist_get_cluster(set->hist, pose);
     assert(cidx >= 0);
     if (cidx >= set->cluster_max_count)
       continue;
@@ -541,28 +662,31 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
     cluster = set->clusters + cidx;
 
     cluster->count += 1;
-    cluster->weight += sample->weight;
+    cluster->weight += w;
 
     count += 1;
-    weight += sample->weight;
+    weight += w;
 
     // Compute mean
-    cluster->m[0] += sample->weight * sample->pose.v[0];
-    cluster->m[1] += sample->weight * sample->pose.v[1];
-    cluster->m[2] += sample->weight * cos(sample->pose.v[2]);
-    cluster->m[3] += sample->weight * sin(sample->pose.v[2]);
+    cs = cos(pose.v[2]);
+    sn = sin(pose.v[2]);
+
+    cluster->m[0] += w * pose.v[0];
+    cluster->m[1] += w * pose.v[1];
+    cluster->m[2] += w * cs;
+    cluster->m[3] += w * sn;
 
-    m[0] += sample->weight * sample->pose.v[0];
-    m[1] += sample->weight * sample->pose.v[1];
-    m[2] += sample->weight * cos(sample->pose.v[2]);
-    m[3] += sample->weight * sin(sample->pose.v[2]);
+    m[0] += w * pose.v[0];
+    m[1] += w * pose.v[1];
+    m[2] += w * cs;
+    m[3] += w * sn;
 
     // Compute covariance in linear components
     for (j = 0; j < 2; j++)
       for (k = 0; k < 2; k++)
       {
-        cluster->c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
-        c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
+        cluster->c[j][k] += w * pose.v[j] * pose.v[k];
+        c[j][k] += w * pose.v[j] * pose.v[k];
       }
   }
 
@@ -616,8 +740,8 @@ void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var)
 {
   int i;
   double mn, mx, my, mrr;
+  double w, x, y;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   
   set = pf->sets + pf->current_set;
 
@@ -628,13 +752,15 @@ void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var)
   
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-
-    mn += sample->weight;
-    mx += sample->weight * sample->pose.v[0];
-    my += sample->weight * sample->pose.v[1];
-    mrr += sample->weight * sample->pose.v[0] * sample->pose.v[0];
-    mrr += sample->weight * sample->pose.v[1] * sample->pose.v[1];
+    w = set->weights[i];
+    x = set->poses[0][i];
+    y = set->poses[1][i];
+
+    mn += w;
+    mx += w * x;
+    my += w * y;
+    mrr += w * x * x;
+    mrr += w * y * y;
   }
 
   mean->v[0] = mx / mn;
@@ -29,7 +29,8 @@
 #define PF_H
 
 #include "pf_vector.h"
-#include "pf_kdtree.h"
+#include "pf_pdf.h"
+#include "pf_hist.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -44,6 +45,11 @@ struct _pf_sample_set_t;
 // an appropriate distribution.
 typedef pf_vector_t (*pf_init_model_fn_t) (void *init_data);
 
+// Function prototype for the random pose model used by the resampler to add
+// recovery samples; it draws from the filter random number generator [rng],
+// so that a filter seeded with pf_set_seed() is reproducible.
+typedef pf_vector_t (*pf_random_pose_fn_t) (void *random_pose_data, pf_rng_t *rng);
+
 // Function prototype for the action model; generates a sample pose from
 // an appropriate distribution
 typedef void (*pf_action_model_fn_t) (void *action_data, 
@@ -55,16 +61,17 @@ typedef double (*pf_sensor_model_fn_t) (void *sensor_data,
                                         struct _pf_sample_set_t* set);
 
 
-// Information for a single sample
-typedef struct
+// Resampling strategies.  All of them run in linear time in the number
+// of samples.
+typedef enum
 {
-  // Pose represented by this sample
-  pf_vector_t pose;
-
-  // Weight for this pose
-  double weight;
-  
-} pf_sample_t;
+  // One uniform draw, evenly spaced pointers (low-variance sampler)
+  PF_RESAMPLE_SYSTEMATIC,
+  // One uniform draw per stratum
+  PF_RESAMPLE_STRATIFIED,
+  // Deterministic copies of floor(N w), systematic draw on the remainder
+  PF_RESAMPLE_RESIDUAL
+} pf_resample_type_t;
 
 
 // Information for a cluster of samples
@@ -89,12 +96,15 @@ typedef struct
 // Information for a set of samples
 typedef struct _pf_sample_set_t
 {
-  // The samples
+  // The samples, stored as a structure of arrays: poses[k][i] is the
+  // k-th pose component of sample i, weights[i] its weight.  Keeping
+  // each component contiguous lets the models process particles in batches.
   int sample_count;
-  pf_sample_t *samples;
+  double *poses[3];
+  double *weights;
 
-  // A kdtree encoding the histogram
-  pf_kdtree_t *kdtree;
+  // A hash table encoding the histogram
+  pf_hist_t *hist;
 
   // Clusters
   int cluster_count, cluster_max_count;
@@ -107,6 +117,25 @@ typedef struct _pf_sample_set_t
 } pf_sample_set_t;
 
 
+// Read the pose of sample [i]
+static inline pf_vector_t pf_sample_get_pose(const pf_sample_set_t *set, int i)
+{
+  pf_vector_t pose;
+  pose.v[0] = set->poses[0][i];
+  pose.v[1] = set->poses[1][i];
+  pose.v[2] = set->poses[2][i];
+  return pose;
+}
+
+// Write the pose of sample [i]
+static inline void pf_sample_put_pose(pf_sample_set_t *set, int i, pf_vector_t pose)
+{
+  set->poses[0][i] = pose.v[0];
+  set->poses[1][i] = pose.v[1];
+  set->poses[2][i] = pose.v[2];
+}
+
+
 // Information for an entire filter
 typedef struct _pf_t
 {
@@ -128,28 +157,48 @@ typedef struct _pf_t
   double alpha_slow, alpha_fast;
 
   // Function used to draw random pose samples
-  pf_init_model_fn_t random_pose_fn;
+  pf_random_pose_fn_t random_pose_fn;
   void *random_pose_data;
 
   double dist_threshold; //distance threshold in each axis over which the pf is considered to not be converged
   int converged; 
+
+  // Resampling strategy
+  pf_resample_type_t resample_type;
+
+  // Random number generator used by the initialization, the resampler and
+  // the random pose model
+  pf_rng_t rng;
+
+  // Resampling workspace: ancestor indices (max_samples entries)
+  int *resample_index;
 } pf_t;
 
 
 // Create a new filter
 pf_t *pf_alloc(int min_samples, int max_samples,
                double alpha_slow, double alpha_fast,
-               pf_init_model_fn_t random_pose_fn, void *random_pose_data);
+               pf_random_pose_fn_t random_pose_fn, void *random_pose_data);
 
 // Free an existing filter
 void pf_free(pf_t *pf);
 
+// Re-seed the filter random number generator. Every random draw of the filter
+// (pf_init, pf_init_multi, resampling, random poses) and of the odometry model
+// comes from it, so the same seed and inputs give the same samples.
+void pf_set_seed(pf_t *pf, uint64_t seed);
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov);
 
 // Initialize the filter using some model
 void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data);
 
+// Initialize the filter using a mixture of guassians with the same covariance;
+// each hypothesis gets a number of samples proportional to its weight
+void pf_init_multi(pf_t *pf, int hyp_count, const pf_vector_t *means,
+                   const double *weights, pf_matrix_t cov);
+
 // Update the filter with some new action
 void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_data);
 
@@ -159,6 +208,10 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 // Resample the distribution
 void pf_update_resample(pf_t *pf);
 
+// Resample the distribution without re-computing the cluster statistics:
+// pf_update_resample() is this followed by pf_cluster_stats() on the new set
+void pf_update_resample_samples(pf_t *pf);
+
 // Compute the CEP statistics (mean and variance).
 void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var);
 
@@ -174,7 +227,7 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set);
 // Display the sample set
 void pf_draw_samples(pf_t *pf, struct _rtk_fig_t *fig, int max_samples);
 
-// Draw the histogram (kdtree)
+// Draw the histogram
 void pf_draw_hist(pf_t *pf, struct _rtk_fig_t *fig);
 
 // Draw the CEP statistics
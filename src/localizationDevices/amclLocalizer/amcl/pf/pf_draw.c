@@ -36,7 +36,7 @@
 
 #include "pf.h"
 #include "pf_pdf.h"
-#include "pf_kdtree.h"
+#include "pf_hist.h"
 
 
 // Draw the statistics
@@ -49,18 +49,15 @@ void pf_draw_samples(pf_t *pf, rtk_fig_t *fig, int max_samples)
   int i;
   double px, py, pa;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
 
   set = pf->sets + pf->current_set;
   max_samples = MIN(max_samples, set->sample_count);
 
   for (i = 0; i < max_samples; i++)
   {
-    sample = set->samples + i;
-
-    px = sample->pose.v[0];
-    py = sample->pose.v[1];
-    pa = sample->pose.v[2];
+    px = set->poses[0][i];
+    py = set->poses[1][i];
+    pa = set->poses[2][i];
 
     //printf("%f %f\n", px, py);
 
@@ -73,7 +70,7 @@ void pf_draw_samples(pf_t *pf, rtk_fig_t *fig, int max_samples)
 }
 
 
-// Draw the hitogram (kd tree)
+// Draw the hitogram
 void pf_draw_hist(pf_t *pf, rtk_fig_t *fig)
 {
   pf_sample_set_t *set;
@@ -81,7 +78,7 @@ void pf_draw_hist(pf_t *pf, rtk_fig_t *fig)
   set = pf->sets + pf->current_set;
 
   rtk_fig_color(fig, 0.0, 0.0, 1.0);
-  pf_kdtree_draw(set->kdtree, fig);
+  pf_hist_draw(set->hist, fig);
 
   return;
 }
@@ -0,0 +1,308 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Sample histogram for KLD sampling and clustering
+ *************************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "amcl/pf/pf_vector.h"
+#include "amcl/pf/pf_hist.h"
+
+
+// Compute the key of a pose
+static void pf_hist_key(pf_hist_t *self, pf_vector_t pose, int key[]);
+
+// Find the slot holding [key], or the empty slot where it would go
+static int pf_hist_find_slot(pf_hist_t *self, int key[]);
+
+// Union-find root, with path halving
+static int pf_hist_find_root(pf_hist_t *self, int bin);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a histogram
+pf_hist_t *pf_hist_alloc(int max_size)
+{
+  int i;
+  pf_hist_t *self;
+
+  self = calloc(1, sizeof(pf_hist_t));
+
+  self->size[0] = 0.50;
+  self->size[1] = 0.50;
+  self->size[2] = (10 * M_PI / 180);
+
+  // Keep the load factor below 1/2
+  self->table_size = 16;
+  while (self->table_size < 2 * max_size)
+    self->table_size *= 2;
+  self->table = malloc(self->table_size * sizeof(int));
+  for (i = 0; i < self->table_size; i++)
+    self->table[i] = -1;
+
+  self->bin_count = 0;
+  self->bin_max_count = max_size;
+  self->bins = calloc(self->bin_max_count, sizeof(pf_hist_bin_t));
+
+  self->cluster_count = 0;
+
+  return self;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destroy a histogram
+void pf_hist_free(pf_hist_t *self)
+{
+  free(self->bins);
+  free(self->table);
+  free(self);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear all entries from the histogram
+void pf_hist_clear(pf_hist_t *self)
+{
+  int i;
+
+  for (i = 0; i < self->bin_count; i++)
+    self->table[self->bins[i].slot] = -1;
+
+  self->bin_count = 0;
+  self->cluster_count = 0;
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Insert a pose into the histogram
+void pf_hist_insert(pf_hist_t *self, pf_vector_t pose, double value)
+{
+  int key[3];
+  int slot;
+  pf_hist_bin_t *bin;
+
+  pf_hist_key(self, pose, key);
+  slot = pf_hist_find_slot(self, key);
+
+  // Existing bin: accumulate
+  if (self->table[slot] >= 0)
+  {
+    self->bins[self->table[slot]].value += value;
+    return;
+  }
+
+  // New bin
+  assert(self->bin_count < self->bin_max_count);
+  bin = self->bins + self->bin_count;
+  bin->key[0] = key[0];
+  bin->key[1] = key[1];
+  bin->key[2] = key[2];
+  bin->value = value;
+  bin->slot = slot;
+  bin->parent = self->bin_count;
+  bin->cluster = -1;
+
+  self->table[slot] = self->bin_count++;
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the probability estimate for the given pose. TODO: this
+// should do a kernel density estimate rather than a simple histogram.
+double pf_hist_get_prob(pf_hist_t *self, pf_vector_t pose)
+{
+  int key[3];
+  int slot;
+
+  pf_hist_key(self, pose, key);
+  slot = pf_hist_find_slot(self, key);
+  if (self->table[slot] < 0)
+    return 0.0;
+  return self->bins[self->table[slot]].value;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the cluster label for the given pose
+int pf_hist_get_cluster(pf_hist_t *self, pf_vector_t pose)
+{
+  int key[3];
+  int slot;
+
+  pf_hist_key(self, pose, key);
+  slot = pf_hist_find_slot(self, key);
+  if (self->table[slot] < 0)
+    return -1;
+  return self->bins[self->table[slot]].cluster;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Cluster the occupied bins: two bins belong to the same cluster if they
+// are connected through bins touching each other (26-neighbourhood).
+void pf_hist_cluster(pf_hist_t *self)
+{
+  int i, n, slot, root_a, root_b;
+  int nkey[3];
+  pf_hist_bin_t *bin;
+
+  for (i = 0; i < self->bin_count; i++)
+    self->bins[i].parent = i;
+
+  // Only half of the neighbourhood needs to be visited, since adjacency
+  // is symmetric: the 13 offsets that come after (0,0,0) in raster order.
+  for (i = 0; i < self->bin_count; i++)
+  {
+    bin = self->bins + i;
+    for (n = 14; n < 3 * 3 * 3; n++)
+    {
+      nkey[0] = bin->key[0] + (n / 9) - 1;
+      nkey[1] = bin->key[1] + ((n % 9) / 3) - 1;
+      nkey[2] = bin->key[2] + ((n % 9) % 3) - 1;
+
+      slot = pf_hist_find_slot(self, nkey);
+      if (self->table[slot] < 0)
+        continue;
+
+      root_a = pf_hist_find_root(self, i);
+      root_b = pf_hist_find_root(self, self->table[slot]);
+      if (root_a == root_b)
+        continue;
+
+      // Keep the oldest bin as the root
+      if (root_a < root_b)
+        self->bins[root_b].parent = root_a;
+      else
+        self->bins[root_a].parent = root_b;
+    }
+  }
+
+  // Assign consecutive labels to the roots.  Roots are the smallest index
+  // of their component, so they are always labelled before their members.
+  self->cluster_count = 0;
+  for (i = 0; i < self->bin_count; i++)
+  {
+    bin = self->bins + i;
+    root_a = pf_hist_find_root(self, i);
+    if (root_a == i)
+      bin->cluster = self->cluster_count++;
+    else
+      bin->cluster = self->bins[root_a].cluster;
+  }
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compute the key of a pose
+void pf_hist_key(pf_hist_t *self, pf_vector_t pose, int key[])
+{
+  key[0] = floor(pose.v[0] / self->size[0]);
+  key[1] = floor(pose.v[1] / self->size[1]);
+  key[2] = floor(pose.v[2] / self->size[2]);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the slot holding [key], or the empty slot where it would go
+int pf_hist_find_slot(pf_hist_t *self, int key[])
+{
+  unsigned int h;
+  int slot, bin;
+  int mask;
+
+  h = ((unsigned int) key[0] * 73856093u) ^
+      ((unsigned int) key[1] * 19349663u) ^
+      ((unsigned int) key[2] * 83492791u);
+  mask = self->table_size - 1;
+
+  // Linear probing
+  for (slot = (int) (h & mask); ; slot = (slot + 1) & mask)
+  {
+    bin = self->table[slot];
+    if (bin < 0)
+      return slot;
+    if (self->bins[bin].key[0] == key[0] &&
+        self->bins[bin].key[1] == key[1] &&
+        self->bins[bin].key[2] == key[2])
+      return slot;
+  }
+
+  return -1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Union-find root, with path halving
+int pf_hist_find_root(pf_hist_t *self, int bin)
+{
+  pf_hist_bin_t *bins = self->bins;
+
+  while (bins[bin].parent != bin)
+  {
+    bins[bin].parent = bins[bins[bin].parent].parent;
+    bin = bins[bin].parent;
+  }
+  return bin;
+}
+
+
+
+#ifdef INCLUDE_RTKGUI
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw the histogram
+void pf_hist_draw(pf_hist_t *self, rtk_fig_t *fig)
+{
+  int i;
+  double ox, oy;
+  char text[64];
+  pf_hist_bin_t *bin;
+
+  for (i = 0; i < self->bin_count; i++)
+  {
+    bin = self->bins + i;
+
+    ox = (bin->key[0] + 0.5) * self->size[0];
+    oy = (bin->key[1] + 0.5) * self->size[1];
+
+    rtk_fig_rectangle(fig, ox, oy, 0.0, self->size[0], self->size[1], 0);
+
+    snprintf(text, sizeof(text), "%d", bin->cluster);
+    rtk_fig_text(fig, ox, oy, 0.0, text);
+  }
+
+  return;
+}
+
+#endif
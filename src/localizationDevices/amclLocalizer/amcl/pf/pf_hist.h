@@ -0,0 +1,121 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Sample histogram for KLD sampling and clustering.
+ *       Flat hash table of discretised (x, y, theta) bins; clusters are
+ *       the connected components of occupied bins (union-find).
+ *       Replaces the original kd-tree (pf_kdtree.c).
+ *************************************************************************/
+
+#ifndef PF_HIST_H
+#define PF_HIST_H
+
+#include "pf_vector.h"
+
+#ifdef INCLUDE_RTKGUI
+#include "rtk.h"
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Info for an occupied bin
+typedef struct
+{
+  // The key for this bin
+  int key[3];
+
+  // The value for this bin (sum of the inserted weights)
+  double value;
+
+  // Slot occupied in the hash table
+  int slot;
+
+  // Union-find parent (bin index)
+  int parent;
+
+  // The cluster label
+  int cluster;
+
+} pf_hist_bin_t;
+
+
+// A histogram
+typedef struct
+{
+  // Cell size
+  double size[3];
+
+  // Open addressing hash table (power of two slots); each slot holds a
+  // bin index, or -1 when empty
+  int table_size;
+  int *table;
+
+  // The occupied bins, in insertion order
+  int bin_count, bin_max_count;
+  pf_hist_bin_t *bins;
+
+  // Number of clusters found by the last pf_hist_cluster()
+  int cluster_count;
+
+} pf_hist_t;
+
+
+// Create a histogram able to hold [max_size] occupied bins
+pf_hist_t *pf_hist_alloc(int max_size);
+
+// Destroy a histogram
+void pf_hist_free(pf_hist_t *self);
+
+// Clear all entries from the histogram; cost is proportional to the
+// number of occupied bins, not to the table size
+void pf_hist_clear(pf_hist_t *self);
+
+// Insert a pose into the histogram
+void pf_hist_insert(pf_hist_t *self, pf_vector_t pose, double value);
+
+// Cluster the occupied bins
+void pf_hist_cluster(pf_hist_t *self);
+
+// Determine the probability estimate for the given pose
+double pf_hist_get_prob(pf_hist_t *self, pf_vector_t pose);
+
+// Determine the cluster label for the given pose
+int pf_hist_get_cluster(pf_hist_t *self, pf_vector_t pose);
+
+
+#ifdef INCLUDE_RTKGUI
+
+// Draw the histogram
+void pf_hist_draw(pf_hist_t *self, rtk_fig_t *fig);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -34,6 +34,10 @@
 
 #include "amcl/pf/pf_pdf.h"
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 // Random number generator seed value
 static unsigned int pf_pdf_seed;
 
@@ -49,6 +53,58 @@ static void srand48(long int seedval)
 }
 #endif
 
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+// Seed the generator
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed)
+{
+  int i;
+  uint64_t z;
+
+  // splitmix64, so that nearby seeds give unrelated states
+  for (i = 0; i < 2; i++)
+  {
+    seed += 0x9E3779B97F4A7C15ULL;
+    z = seed;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    rng->s[i] = z ^ (z >> 31);
+  }
+
+  // The all-zero state is a fixed point
+  if (rng->s[0] == 0 && rng->s[1] == 0)
+    rng->s[0] = 1;
+
+  return;
+}
+
+// Fill a buffer with standard normal deviates
+void pf_rng_gaussian_fill(pf_rng_t *rng, double *out, int n)
+{
+  int i;
+  double r, a;
+
+  for (i = 0; i + 1 < n; i += 2)
+  {
+    // 1 - u lies in (0, 1], so the log is always finite
+    r = sqrt(-2.0 * log(1.0 - pf_rng_uniform(rng)));
+    a = 2.0 * M_PI * pf_rng_uniform(rng);
+    out[i] = r * cos(a);
+    out[i + 1] = r * sin(a);
+  }
+  if (i < n)
+  {
+    r = sqrt(-2.0 * log(1.0 - pf_rng_uniform(rng)));
+    a = 2.0 * M_PI * pf_rng_uniform(rng);
+    out[i] = r * cos(a);
+  }
+
+  return;
+}
+
+
 /**************************************************************************
  * Gaussian
  *************************************************************************/
@@ -137,6 +193,28 @@ pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
   return x;
 }
 
+// Generate a sample from the pdf, drawing from [rng] instead of drand48().
+pf_vector_t pf_pdf_gaussian_sample_rng(pf_pdf_gaussian_t *pdf, pf_rng_t *rng)
+{
+  int i, j;
+  pf_vector_t r;
+  pf_vector_t x;
+
+  // Generate a random vector
+  pf_rng_gaussian_fill(rng, r.v, 3);
+  for (i = 0; i < 3; i++)
+    r.v[i] *= pdf->cd.v[i];
+
+  for (i = 0; i < 3; i++)
+  {
+    x.v[i] = pdf->x.v[i];
+    for (j = 0; j < 3; j++)
+      x.v[i] += pdf->cr.m[i][j] * r.v[j];
+  }
+
+  return x;
+}
+
 // Draw randomly from a zero-mean Gaussian distribution, with standard
 // deviation sigma.
 // We use the polar form of the Box-Muller transformation, explained here:
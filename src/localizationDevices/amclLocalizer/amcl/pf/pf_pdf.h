@@ -28,6 +28,8 @@
 #ifndef PF_PDF_H
 #define PF_PDF_H
 
+#include <stdint.h>
+
 #include "pf_vector.h"
 
 //#include <gsl/gsl_rng.h>
@@ -37,6 +39,48 @@
 extern "C" {
 #endif
 
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+// Pseudo-random number generator state (xoroshiro128+).  Every filter
+// owns one, so that filters seeded with the same value produce the same
+// sequence, independently of other users of drand48().
+typedef struct
+{
+  uint64_t s[2];
+} pf_rng_t;
+
+// Seed the generator; the seed is expanded into the state with splitmix64.
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed);
+
+// Draw the next 64 random bits
+static inline uint64_t pf_rng_next(pf_rng_t *rng)
+{
+  uint64_t s0 = rng->s[0];
+  uint64_t s1 = rng->s[1];
+  uint64_t result = s0 + s1;
+
+  s1 ^= s0;
+  rng->s[0] = ((s0 << 24) | (s0 >> 40)) ^ s1 ^ (s1 << 16);
+  rng->s[1] = (s1 << 37) | (s1 >> 27);
+
+  return result;
+}
+
+// Draw uniformly from [0, 1)
+static inline double pf_rng_uniform(pf_rng_t *rng)
+{
+  return (pf_rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Fill [out] with [n] independent zero-mean, unit-variance Gaussian
+// deviates.  Uses the trigonometric Box-Muller transformation, which has
+// no rejection loop and yields two deviates per pair of uniform draws, so
+// batches of particles can be perturbed in a single tight loop.
+void pf_rng_gaussian_fill(pf_rng_t *rng, double *out, int n);
+
+
 /**************************************************************************
  * Gaussian
  *************************************************************************/
@@ -78,6 +122,9 @@ double pf_ran_gaussian(double sigma);
 // Generate a sample from the pdf.
 pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf);
 
+// Generate a sample from the pdf, drawing from [rng] instead of drand48().
+pf_vector_t pf_pdf_gaussian_sample_rng(pf_pdf_gaussian_t *pdf, pf_rng_t *rng);
+
 #ifdef __cplusplus
 }
 #endif
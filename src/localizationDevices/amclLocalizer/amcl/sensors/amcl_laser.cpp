@@ -67,7 +67,8 @@ AMCLLaser::SetModelBeam(double z_hit,
                         double z_rand,
                         double sigma_hit,
                         double lambda_short,
-                        double chi_outlier)
+                        double chi_outlier,
+                        int range_table_angles)
 {
   this->model_type = LASER_MODEL_BEAM;
   this->z_hit = z_hit;
@@ -77,6 +78,11 @@ AMCLLaser::SetModelBeam(double z_hit,
   this->sigma_hit = sigma_hit;
   this->lambda_short = lambda_short;
   this->chi_outlier = chi_outlier;
+
+  // Optionally replace the ray casting with a lookup in the precomputed ranges
+  map_free_range_table(this->map);
+  if (range_table_angles > 0)
+    map_build_range_table(this->map, range_table_angles);
 }
 
 void 
@@ -147,7 +153,6 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
   double map_range;
   double obs_range, obs_bearing;
   double total_weight;
-  pf_sample_t *sample;
   pf_vector_t pose;
 
   self = (AMCLLaser*) data->sensor;
@@ -157,8 +162,7 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
   // Compute the sample weights
   for (j = 0; j < set->sample_count; j++)
   {
-    sample = set->samples + j;
-    pose = sample->pose;
+    pose = pf_sample_get_pose(set, j);
 
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose, pose);
@@ -166,14 +170,23 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
     p = 1.0;
 
     step = (data->range_count - 1) / (self->max_beams - 1);
+
+    // Step size must be at least 1
+    if(step < 1)
+      step = 1;
+
     for (i = 0; i < data->range_count; i += step)
     {
       obs_range = data->ranges[i][0];
       obs_bearing = data->ranges[i][1];
 
       // Compute the range according to the map
-      map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
-                                 pose.v[2] + obs_bearing, data->range_max);
+      if (self->map->range_table)
+        map_range = map_lookup_range(self->map, pose.v[0], pose.v[1],
+                                     pose.v[2] + obs_bearing, data->range_max);
+      else
+        map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
+                                   pose.v[2] + obs_bearing, data->range_max);
       pz = 0.0;
 
       // Part 1: good, but noisy, hit
@@ -202,8 +215,8 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
       p += pz*pz*pz;
     }
 
-    sample->weight *= p;
-    total_weight += sample->weight;
+    set->weights[j] *= p;
+    total_weight += set->weights[j];
   }
 
   return(total_weight);
@@ -217,7 +230,6 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
   double p;
   double obs_range, obs_bearing;
   double total_weight;
-  pf_sample_t *sample;
   pf_vector_t pose;
   pf_vector_t hit;
 
@@ -228,8 +240,7 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
   // Compute the sample weights
   for (j = 0; j < set->sample_count; j++)
   {
-    sample = set->samples + j;
-    pose = sample->pose;
+    pose = pf_sample_get_pose(set, j);
 
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose, pose);
@@ -292,8 +303,8 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
       p += pz*pz*pz;
     }
 
-    sample->weight *= p;
-    total_weight += sample->weight;
+    set->weights[j] *= p;
+    total_weight += set->weights[j];
   }
 
   return(total_weight);
@@ -307,7 +318,6 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
   double log_p;
   double obs_range, obs_bearing;
   double total_weight;
-  pf_sample_t *sample;
   pf_vector_t pose;
   pf_vector_t hit;
 
@@ -369,8 +379,7 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
   // Compute the sample weights
   for (j = 0; j < set->sample_count; j++)
   {
-    sample = set->samples + j;
-    pose = sample->pose;
+    pose = pf_sample_get_pose(set, j);
 
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose, pose);
@@ -438,8 +447,8 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
       }
     }
     if(!do_beamskip){
-      sample->weight *= exp(log_p);
-      total_weight += sample->weight;
+      set->weights[j] *= exp(log_p);
+      total_weight += set->weights[j];
     }
   }
   
@@ -468,8 +477,6 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
 
     for (j = 0; j < set->sample_count; j++)
       {
-	sample = set->samples + j;
-	pose = sample->pose;
 
 	log_p = 0;
 
@@ -479,9 +486,9 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
 	  }
 	}
 	
-	sample->weight *= exp(log_p);
+	set->weights[j] *= exp(log_p);
 	
-	total_weight += sample->weight;
+	total_weight += set->weights[j];
       }      
   }
 
@@ -69,7 +69,8 @@ class AMCLLaser : public AMCLSensor
                             double z_rand,
                             double sigma_hit,
                             double labda_short,
-                            double chi_outlier);
+                            double chi_outlier,
+                            int range_table_angles = 0);
 
   public: void SetModelLikelihoodField(double z_hit,
                                        double z_rand,
@@ -94,6 +95,11 @@ class AMCLLaser : public AMCLSensor
   public: void SetLaserPose(pf_vector_t& laser_pose) 
           {this->laser_pose = laser_pose;}
 
+  // Switch to another map. Its distance field (or range table) must have
+  // already been computed with the parameters of the current model.
+  public: void SetMap(map_t* map)
+          {this->map = map;}
+
   // Determine the probability for the given pose
   private: static double BeamModel(AMCLLaserData *data, 
                                    pf_sample_set_t* set);
@@ -57,6 +57,16 @@ angle_diff(double a, double b)
     return(d2);
 }
 
+// Wrap an angle to [-pi, pi), without trigonometric functions
+static inline double
+wrap_angle(double a)
+{
+  return a - 2*M_PI*floor((a + M_PI) / (2*M_PI));
+}
+
+// Number of particles perturbed per batch of Gaussian draws
+static const int ODOM_BATCH_SIZE = 256;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Default constructor
 AMCLOdom::AMCLOdom() : AMCLSensor()
@@ -109,7 +119,9 @@ AMCLOdom::SetModel( odom_model_t type,
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Apply the action model
+// Apply the action model.  The Gaussian noise of the particles is drawn in
+// batches of ODOM_BATCH_SIZE from the filter random number generator, and
+// the poses are then updated component-wise in a single pass.
 bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
 {
   AMCLOdomData *ndata;
@@ -121,144 +133,84 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
   set = pf->sets + pf->current_set;
   pf_vector_t old_pose = pf_vector_sub(ndata->pose, ndata->delta);
 
+  double *px = set->poses[0];
+  double *py = set->poses[1];
+  double *pa = set->poses[2];
+  double noise[3][ODOM_BATCH_SIZE];
+
   switch( this->model_type )
   {
   case ODOM_MODEL_OMNI:
+  case ODOM_MODEL_OMNI_CORRECTED:
   {
     double delta_trans, delta_rot, delta_bearing;
     double delta_trans_hat, delta_rot_hat, delta_strafe_hat;
+    double trans_hat_stddev, rot_hat_stddev, strafe_hat_stddev;
 
     delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
                        ndata->delta.v[1]*ndata->delta.v[1]);
     delta_rot = ndata->delta.v[2];
 
     // Precompute a couple of things
-    double trans_hat_stddev = (alpha3 * (delta_trans*delta_trans) +
-                               alpha1 * (delta_rot*delta_rot));
-    double rot_hat_stddev = (alpha4 * (delta_rot*delta_rot) +
-                             alpha2 * (delta_trans*delta_trans));
-    double strafe_hat_stddev = (alpha1 * (delta_rot*delta_rot) +
-                                alpha5 * (delta_trans*delta_trans));
-
-    for (int i = 0; i < set->sample_count; i++)
+    if (this->model_type == ODOM_MODEL_OMNI)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      delta_bearing = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                                 old_pose.v[2]) + sample->pose.v[2];
-      double cs_bearing = cos(delta_bearing);
-      double sn_bearing = sin(delta_bearing);
-
-      // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
-                            delta_strafe_hat * sn_bearing);
-      sample->pose.v[1] += (delta_trans_hat * sn_bearing - 
-                            delta_strafe_hat * cs_bearing);
-      sample->pose.v[2] += delta_rot_hat ;
+      trans_hat_stddev = (alpha3 * (delta_trans*delta_trans) +
+                          alpha1 * (delta_rot*delta_rot));
+      rot_hat_stddev = (alpha4 * (delta_rot*delta_rot) +
+                        alpha2 * (delta_trans*delta_trans));
+      strafe_hat_stddev = (alpha1 * (delta_rot*delta_rot) +
+                           alpha5 * (delta_trans*delta_trans));
     }
-  }
-  break;
-  case ODOM_MODEL_DIFF:
-  {
-    // Implement sample_motion_odometry (Prob Rob p 136)
-    double delta_rot1, delta_trans, delta_rot2;
-    double delta_rot1_hat, delta_trans_hat, delta_rot2_hat;
-    double delta_rot1_noise, delta_rot2_noise;
-
-    // Avoid computing a bearing from two poses that are extremely near each
-    // other (happens on in-place rotation).
-    if(sqrt(ndata->delta.v[1]*ndata->delta.v[1] + 
-            ndata->delta.v[0]*ndata->delta.v[0]) < 0.01)
-      delta_rot1 = 0.0;
     else
-      delta_rot1 = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                              old_pose.v[2]);
-    delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
-                       ndata->delta.v[1]*ndata->delta.v[1]);
-    delta_rot2 = angle_diff(ndata->delta.v[2], delta_rot1);
-
-    // We want to treat backward and forward motion symmetrically for the
-    // noise model to be applied below.  The standard model seems to assume
-    // forward motion.
-    delta_rot1_noise = std::min(fabs(angle_diff(delta_rot1,0.0)),
-                                fabs(angle_diff(delta_rot1,M_PI)));
-    delta_rot2_noise = std::min(fabs(angle_diff(delta_rot2,0.0)),
-                                fabs(angle_diff(delta_rot2,M_PI)));
-
-    for (int i = 0; i < set->sample_count; i++)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      // Sample pose differences
-      delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(this->alpha1*delta_rot1_noise*delta_rot1_noise +
-                                                  this->alpha2*delta_trans*delta_trans));
-      delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(this->alpha3*delta_trans*delta_trans +
-                              this->alpha4*delta_rot1_noise*delta_rot1_noise +
-                              this->alpha4*delta_rot2_noise*delta_rot2_noise);
-      delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(this->alpha1*delta_rot2_noise*delta_rot2_noise +
-                                                  this->alpha2*delta_trans*delta_trans));
-
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += delta_trans_hat * 
-              cos(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[1] += delta_trans_hat * 
-              sin(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[2] += delta_rot1_hat + delta_rot2_hat;
+      trans_hat_stddev = sqrt( alpha3 * (delta_trans*delta_trans) +
+                               alpha4 * (delta_rot*delta_rot) );
+      rot_hat_stddev = sqrt( alpha1 * (delta_rot*delta_rot) +
+                             alpha2 * (delta_trans*delta_trans) );
+      strafe_hat_stddev = sqrt( alpha4 * (delta_rot*delta_rot) +
+                                alpha5 * (delta_trans*delta_trans) );
     }
-  }
-  break;
-  case ODOM_MODEL_OMNI_CORRECTED:
-  {
-    double delta_trans, delta_rot, delta_bearing;
-    double delta_trans_hat, delta_rot_hat, delta_strafe_hat;
 
-    delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
-                       ndata->delta.v[1]*ndata->delta.v[1]);
-    delta_rot = ndata->delta.v[2];
-
-    // Precompute a couple of things
-    double trans_hat_stddev = sqrt( alpha3 * (delta_trans*delta_trans) +
-                                    alpha4 * (delta_rot*delta_rot) );
-    double rot_hat_stddev = sqrt( alpha1 * (delta_rot*delta_rot) +
-                                  alpha2 * (delta_trans*delta_trans) );
-    double strafe_hat_stddev = sqrt( alpha4 * (delta_rot*delta_rot) +
-                                     alpha5 * (delta_trans*delta_trans) );
+    // The bearing of the motion relative to the robot is the same for
+    // every particle
+    double bearing = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
+                                old_pose.v[2]);
 
-    for (int i = 0; i < set->sample_count; i++)
+    for (int b = 0; b < set->sample_count; b += ODOM_BATCH_SIZE)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      delta_bearing = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                                 old_pose.v[2]) + sample->pose.v[2];
-      double cs_bearing = cos(delta_bearing);
-      double sn_bearing = sin(delta_bearing);
-
-      // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
-                            delta_strafe_hat * sn_bearing);
-      sample->pose.v[1] += (delta_trans_hat * sn_bearing - 
-                            delta_strafe_hat * cs_bearing);
-      sample->pose.v[2] += delta_rot_hat ;
+      int n = std::min(ODOM_BATCH_SIZE, set->sample_count - b);
+      pf_rng_gaussian_fill(&pf->rng, noise[0], n);
+      pf_rng_gaussian_fill(&pf->rng, noise[1], n);
+      pf_rng_gaussian_fill(&pf->rng, noise[2], n);
+
+      for (int i = 0; i < n; i++)
+      {
+        delta_bearing = bearing + pa[b + i];
+        double cs_bearing = cos(delta_bearing);
+        double sn_bearing = sin(delta_bearing);
+
+        // Sample pose differences
+        delta_trans_hat = delta_trans + trans_hat_stddev * noise[0][i];
+        delta_rot_hat = delta_rot + rot_hat_stddev * noise[1][i];
+        delta_strafe_hat = 0 + strafe_hat_stddev * noise[2][i];
+        // Apply sampled update to particle pose
+        px[b + i] += (delta_trans_hat * cs_bearing + 
+                      delta_strafe_hat * sn_bearing);
+        py[b + i] += (delta_trans_hat * sn_bearing - 
+                      delta_strafe_hat * cs_bearing);
+        pa[b + i] += delta_rot_hat ;
+      }
     }
   }
   break;
+  case ODOM_MODEL_DIFF:
   case ODOM_MODEL_DIFF_CORRECTED:
   {
     // Implement sample_motion_odometry (Prob Rob p 136)
     double delta_rot1, delta_trans, delta_rot2;
     double delta_rot1_hat, delta_trans_hat, delta_rot2_hat;
     double delta_rot1_noise, delta_rot2_noise;
+    double rot1_stddev, trans_stddev, rot2_stddev;
 
     // Avoid computing a bearing from two poses that are extremely near each
     // other (happens on in-place rotation).
@@ -280,28 +232,44 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
     delta_rot2_noise = std::min(fabs(angle_diff(delta_rot2,0.0)),
                                 fabs(angle_diff(delta_rot2,M_PI)));
 
-    for (int i = 0; i < set->sample_count; i++)
-    {
-      pf_sample_t* sample = set->samples + i;
+    rot1_stddev = this->alpha1*delta_rot1_noise*delta_rot1_noise +
+                  this->alpha2*delta_trans*delta_trans;
+    trans_stddev = this->alpha3*delta_trans*delta_trans +
+                   this->alpha4*delta_rot1_noise*delta_rot1_noise +
+                   this->alpha4*delta_rot2_noise*delta_rot2_noise;
+    rot2_stddev = this->alpha1*delta_rot2_noise*delta_rot2_noise +
+                  this->alpha2*delta_trans*delta_trans;
 
-      // Sample pose differences
-      delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot1_noise*delta_rot1_noise +
-                                                       this->alpha2*delta_trans*delta_trans)));
-      delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(sqrt(this->alpha3*delta_trans*delta_trans +
-                                   this->alpha4*delta_rot1_noise*delta_rot1_noise +
-                                   this->alpha4*delta_rot2_noise*delta_rot2_noise));
-      delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot2_noise*delta_rot2_noise +
-                                                       this->alpha2*delta_trans*delta_trans)));
+    // The corrected model treats the above as variances
+    if (this->model_type == ODOM_MODEL_DIFF_CORRECTED)
+    {
+      rot1_stddev = sqrt(rot1_stddev);
+      trans_stddev = sqrt(trans_stddev);
+      rot2_stddev = sqrt(rot2_stddev);
+    }
 
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += delta_trans_hat * 
-              cos(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[1] += delta_trans_hat * 
-              sin(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[2] += delta_rot1_hat + delta_rot2_hat;
+    for (int b = 0; b < set->sample_count; b += ODOM_BATCH_SIZE)
+    {
+      int n = std::min(ODOM_BATCH_SIZE, set->sample_count - b);
+      pf_rng_gaussian_fill(&pf->rng, noise[0], n);
+      pf_rng_gaussian_fill(&pf->rng, noise[1], n);
+      pf_rng_gaussian_fill(&pf->rng, noise[2], n);
+
+      for (int i = 0; i < n; i++)
+      {
+        // Sample pose differences.  delta_rot1 and delta_rot2 are already
+        // normalized, so angle_diff() reduces to a wrap of the difference.
+        delta_rot1_hat = wrap_angle(delta_rot1 - rot1_stddev * noise[0][i]);
+        delta_trans_hat = delta_trans - trans_stddev * noise[1][i];
+        delta_rot2_hat = wrap_angle(delta_rot2 - rot2_stddev * noise[2][i]);
+
+        // Apply sampled update to particle pose
+        px[b + i] += delta_trans_hat * 
+                cos(pa[b + i] + delta_rot1_hat);
+        py[b + i] += delta_trans_hat * 
+                sin(pa[b + i] + delta_rot1_hat);
+        pa[b + i] += delta_rot1_hat + delta_rot2_hat;
+      }
     }
   }
   break;
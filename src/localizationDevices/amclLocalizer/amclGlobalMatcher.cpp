@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "amclGlobalMatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Two hypotheses closer than this are the same place
+static const double HYP_MIN_DISTANCE = 0.5;       //m
+static const double HYP_MIN_ANGLE    = 0.5;       //rad
+
+// Squared euclidean distance transform of a sampled function (Felzenszwalb
+// and Huttenlocher)
+static void edt_1d(const std::vector<float>& f, std::vector<float>& d, std::vector<int>& v, std::vector<float>& z, int n)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -std::numeric_limits<float>::infinity();
+    z[1] = std::numeric_limits<float>::infinity();
+    for (int q = 1; q < n; q++)
+    {
+        float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+        while (s <= z[k])
+        {
+            k--;
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = std::numeric_limits<float>::infinity();
+    }
+    k = 0;
+    for (int q = 0; q < n; q++)
+    {
+        while (z[k + 1] < q) { k++; }
+        d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+static double angle_distance(double a, double b)
+{
+    return fabs(atan2(sin(a - b), cos(a - b)));
+}
+
+void amclGlobalMatcher::clear()
+{
+    m_levels.clear();
+    m_map = nullptr;
+    m_size_x = 0;
+    m_size_y = 0;
+}
+
+bool amclGlobalMatcher::build(map_t* map, double sigma, int levels)
+{
+    clear();
+    if (map == nullptr || map->size_x <= 0 || map->size_y <= 0 || levels < 1 || sigma <= 0)
+    {
+        return false;
+    }
+    m_size_x = map->size_x;
+    m_size_y = map->size_y;
+
+    //squared distance (in cells) from the closest occupied cell
+    int n = std::max(m_size_x, m_size_y);
+    std::vector<float> f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+    std::vector<float> dist2((size_t)m_size_x * m_size_y);
+    for (int j = 0; j < m_size_y; j++)
+    {
+        for (int i = 0; i < m_size_x; i++)
+        {
+            f[i] = (map->cells[MAP_INDEX(map, i, j)].occ_state == +1) ? 0.0f : 1e20f;
+        }
+        edt_1d(f, d, v, z, m_size_x);
+        for (int i = 0; i < m_size_x; i++)
+        {
+            dist2[MAP_INDEX(map, i, j)] = d[i];
+        }
+    }
+    for (int i = 0; i < m_size_x; i++)
+    {
+        for (int j = 0; j < m_size_y; j++)
+        {
+            f[j] = dist2[MAP_INDEX(map, i, j)];
+        }
+        edt_1d(f, d, v, z, m_size_y);
+        for (int j = 0; j < m_size_y; j++)
+        {
+            dist2[MAP_INDEX(map, i, j)] = d[j];
+        }
+    }
+
+    //level 0: score of each cell
+    m_levels.resize(levels);
+    double k = map->scale * map->scale / (2 * sigma * sigma);
+    m_levels[0].resize((size_t)m_size_x * m_size_y);
+    for (size_t c = 0; c < m_levels[0].size(); c++)
+    {
+        m_levels[0][c] = (uint8_t)(255.0 * exp(-dist2[c] * k) + 0.5);
+    }
+
+    //the other levels: maximum of the four blocks of the previous level
+    for (int l = 1; l < levels; l++)
+    {
+        int h = 1 << (l - 1);
+        int pad = (1 << l) - 1;
+        int w = m_size_x + pad;
+        m_levels[l].resize((size_t)w * (m_size_y + pad));
+        for (int y = -pad; y < m_size_y; y++)
+        {
+            for (int x = -pad; x < m_size_x; x++)
+            {
+                uint8_t m = std::max(std::max(get(l - 1, x, y), get(l - 1, x + h, y)),
+                                     std::max(get(l - 1, x, y + h), get(l - 1, x + h, y + h)));
+                m_levels[l][(size_t)(x + pad) + (size_t)(y + pad) * w] = m;
+            }
+        }
+    }
+
+    m_map = map;
+    return true;
+}
+
+uint8_t amclGlobalMatcher::get(int level, int x, int y) const
+{
+    int pad = (1 << level) - 1;
+    if (x < -pad || x >= m_size_x || y < -pad || y >= m_size_y)
+    {
+        return 0;
+    }
+    return m_levels[level][(size_t)(x + pad) + (size_t)(y + pad) * (m_size_x + pad)];
+}
+
+double amclGlobalMatcher::score(int level, const std::vector<cell_offset_t>& scan, int x, int y) const
+{
+    unsigned int sum = 0;
+    for (const auto& p : scan)
+    {
+        sum += get(level, x + p.x, y + p.y);
+    }
+    return sum / (255.0 * scan.size());
+}
+
+void amclGlobalMatcher::insertHypothesis(const amcl_match_t& hyp, size_t max_hyps, std::vector<amcl_match_t>& hyps) const
+{
+    for (auto& h : hyps)
+    {
+        if (hypot(h.x - hyp.x, h.y - hyp.y) < HYP_MIN_DISTANCE && angle_distance(h.theta, hyp.theta) < HYP_MIN_ANGLE)
+        {
+            if (hyp.score > h.score) { h = hyp; }
+            else { return; }
+            std::sort(hyps.begin(), hyps.end(), [](const amcl_match_t& a, const amcl_match_t& b) { return a.score > b.score; });
+            return;
+        }
+    }
+    hyps.push_back(hyp);
+    std::sort(hyps.begin(), hyps.end(), [](const amcl_match_t& a, const amcl_match_t& b) { return a.score > b.score; });
+    if (hyps.size() > max_hyps)
+    {
+        hyps.resize(max_hyps);
+    }
+}
+
+void amclGlobalMatcher::search(int level, const std::vector<cell_offset_t>& scan, const candidate_t& c,
+                               double theta, size_t max_hyps, double min_score, std::vector<amcl_match_t>& hyps) const
+{
+    if (level == 0)
+    {
+        //the robot must be in free space
+        if (m_map->cells[MAP_INDEX(m_map, c.x, c.y)].occ_state != -1)
+        {
+            return;
+        }
+        amcl_match_t hyp;
+        hyp.x = MAP_WXGX(m_map, c.x);
+        hyp.y = MAP_WYGY(m_map, c.y);
+        hyp.theta = theta;
+        hyp.score = c.score;
+        insertHypothesis(hyp, max_hyps, hyps);
+        return;
+    }
+
+    //best first among the four blocks of the lower level
+    int h = 1 << (level - 1);
+    candidate_t children[4];
+    int count = 0;
+    for (int dy = 0; dy <= h; dy += h)
+    {
+        for (int dx = 0; dx <= h; dx += h)
+        {
+            if (c.x + dx < m_size_x && c.y + dy < m_size_y)
+            {
+                children[count].x = c.x + dx;
+                children[count].y = c.y + dy;
+                children[count].score = score(level - 1, scan, c.x + dx, c.y + dy);
+                count++;
+            }
+        }
+    }
+    for (int i = 1; i < count; i++)
+    {
+        for (int j = i; j > 0 && children[j].score > children[j - 1].score; j--)
+        {
+            std::swap(children[j], children[j - 1]);
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        double threshold = (hyps.size() < max_hyps) ? min_score : hyps.back().score;
+        if (children[i].score < threshold)
+        {
+            break;
+        }
+        search(level - 1, scan, children[i], theta, max_hyps, min_score, hyps);
+    }
+}
+
+bool amclGlobalMatcher::match(const std::vector<pf_vector_t>& points, size_t max_hyps, double min_score,
+                              double angular_step, std::vector<amcl_match_t>& hyps) const
+{
+    hyps.clear();
+    if (m_map == nullptr || points.empty() || max_hyps == 0)
+    {
+        return false;
+    }
+
+    //the farthest point moves by about one cell for each rotation step
+    if (angular_step <= 0)
+    {
+        double max_range = 0;
+        for (const auto& p : points)
+        {
+            max_range = std::max(max_range, hypot(p.v[0], p.v[1]));
+        }
+        angular_step = 5.0 * M_PI / 180.0;
+        if (max_range > m_map->scale)
+        {
+            angular_step = std::min(angular_step, acos(1.0 - (m_map->scale * m_map->scale) / (2.0 * max_range * max_range)));
+        }
+    }
+    int angle_count = (int)ceil(2 * M_PI / angular_step);
+    int top = (int)m_levels.size() - 1;
+    int top_step = 1 << top;
+
+    //the rotations are shared among all the cores
+    unsigned int thread_count = std::max(1u, std::thread::hardware_concurrency());
+    thread_count = std::min<unsigned int>(thread_count, angle_count);
+    std::vector<std::vector<amcl_match_t>> thread_hyps(thread_count);
+    auto worker = [&](unsigned int t)
+    {
+        std::vector<cell_offset_t> scan(points.size());
+        std::vector<candidate_t> candidates;
+        for (int a = t; a < angle_count; a += thread_count)
+        {
+            double theta = a * 2 * M_PI / angle_count;
+            double c = cos(theta);
+            double s = sin(theta);
+            for (size_t i = 0; i < points.size(); i++)
+            {
+                scan[i].x = (int)floor((points[i].v[0] * c - points[i].v[1] * s) / m_map->scale + 0.5);
+                scan[i].y = (int)floor((points[i].v[0] * s + points[i].v[1] * c) / m_map->scale + 0.5);
+            }
+
+            candidates.clear();
+            for (int y = 0; y < m_size_y; y += top_step)
+            {
+                for (int x = 0; x < m_size_x; x += top_step)
+                {
+                    candidate_t cand;
+                    cand.x = x;
+                    cand.y = y;
+                    cand.score = score(top, scan, x, y);
+                    if (cand.score >= min_score)
+                    {
+                        candidates.push_back(cand);
+                    }
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const candidate_t& a, const candidate_t& b) { return a.score > b.score; });
+
+            std::vector<amcl_match_t>& local_hyps = thread_hyps[t];
+            for (const auto& cand : candidates)
+            {
+                double threshold = (local_hyps.size() < max_hyps) ? min_score : local_hyps.back().score;
+                if (cand.score < threshold)
+                {
+                    break;
+                }
+                search(top, scan, cand, theta, max_hyps, min_score, local_hyps);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < thread_count; t++)
+    {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+
+    for (const auto& local_hyps : thread_hyps)
+    {
+        for (const auto& hyp : local_hyps)
+        {
+            insertHypothesis(hyp, max_hyps, hyps);
+        }
+    }
+    return hyps.empty() == false;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef AMCL_GLOBAL_MATCHER_H
+#define AMCL_GLOBAL_MATCHER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "./amcl/map/map.h"
+#include "./amcl/pf/pf_vector.h"
+
+// A pose of the robot in the map, and how well the scan matches the map there
+typedef struct
+{
+    double x;
+    double y;
+    double theta; //radians
+    double score; //0..1
+} amcl_match_t;
+
+// Global localization by correlative scan matching (multi-resolution
+// branch and bound, as in Olson 2009 and Hess et al. 2016).
+// The map is converted into a grid which scores each cell according to its
+// distance from the closest obstacle, and into a pyramid of max-pooled
+// copies of it: in level k each cell holds the maximum of the 2^k x 2^k
+// block starting from it, so the score of a scan at level k bounds the
+// score of all the poses in the block. The scan is matched against the
+// whole map for each rotation, exploring the most promising blocks first
+// and pruning the ones which cannot beat the hypotheses found so far.
+class amclGlobalMatcher
+{
+public:
+    // Builds the score grid and the pyramid. sigma is the stddev [m] of the
+    // score of a point with respect to its distance from the closest obstacle.
+    bool build(map_t* map, double sigma, int levels);
+    void clear();
+    bool isReady() const { return m_map != nullptr; }
+
+    // Matches the scan points (robot frame, meters) against the map. Returns
+    // at most max_hyps hypotheses, sorted by score, which are at least
+    // min_score and are far from each other.
+    // angular_step is the rotation step [rad], 0 to select it from the scan size.
+    bool match(const std::vector<pf_vector_t>& points, size_t max_hyps, double min_score,
+               double angular_step, std::vector<amcl_match_t>& hyps) const;
+
+private:
+    struct cell_offset_t
+    {
+        int x;
+        int y;
+    };
+    struct candidate_t
+    {
+        int    x;
+        int    y;
+        double score;
+    };
+
+    uint8_t get(int level, int x, int y) const;
+    double  score(int level, const std::vector<cell_offset_t>& scan, int x, int y) const;
+    void    search(int level, const std::vector<cell_offset_t>& scan, const candidate_t& c,
+                   double theta, size_t max_hyps, double min_score, std::vector<amcl_match_t>& hyps) const;
+    void    insertHypothesis(const amcl_match_t& hyp, size_t max_hyps, std::vector<amcl_match_t>& hyps) const;
+
+    map_t* m_map = nullptr;
+    int    m_size_x = 0;
+    int    m_size_y = 0;
+
+    // level k covers the cells [-(2^k-1), size) in both directions
+    std::vector<std::vector<uint8_t>> m_levels;
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include <random>
 #include <algorithm>
 #include "amclLocalizer.h"
+#include "amclMapConversion.h"
 
 using namespace yarp::os;
 using namespace yarp::dev;
@@ -69,8 +70,92 @@ void amclLocalizerRPCHandler::setInterface(amclLocalizer* iface)
 bool amclLocalizerRPCHandler::respond(const yarp::os::Bottle& command, yarp::os::Bottle& reply)
 {
     reply.clear();
-    reply.addVocab32(Vocab32::encode("many"));
-    reply.addString("Not yet Implemented");
+    if (command.get(0).asString() == "global_localize")
+    {
+        Map2DLocation loc;
+        double score = 0;
+        if (interface->m_thread->globalLocalization(loc, score))
+        {
+            reply.addVocab32(VOCAB_OK);
+            reply.addString(loc.map_id);
+            reply.addFloat64(loc.x);
+            reply.addFloat64(loc.y);
+            reply.addFloat64(loc.theta);
+            reply.addFloat64(score);
+        }
+        else
+        {
+            reply.addVocab32(VOCAB_ERR);
+        }
+    }
+    else if (command.get(0).asString() == "get_predicted_pose")
+    {
+        double t = (command.size() > 1) ? command.get(1).asFloat64() : 0;
+        if (t <= 0) { t = yarp::os::Time::now(); }
+        Map2DLocation loc;
+        if (interface->m_thread->getPredictedLoc(t, loc))
+        {
+            reply.addVocab32(VOCAB_OK);
+            reply.addString(loc.map_id);
+            reply.addFloat64(loc.x);
+            reply.addFloat64(loc.y);
+            reply.addFloat64(loc.theta);
+            reply.addFloat64(t);
+        }
+        else
+        {
+            reply.addVocab32(VOCAB_ERR);
+        }
+    }
+    else if (command.get(0).asString() == "set_particles_stream" && command.size() == 3)
+    {
+        int count = command.get(1).asInt32();
+        double period = command.get(2).asFloat64();
+        if (count >= 0 && period >= 0)
+        {
+            interface->m_thread->setParticlesStream((size_t)count, period);
+            reply.addVocab32(VOCAB_OK);
+        }
+        else
+        {
+            reply.addVocab32(VOCAB_ERR);
+        }
+    }
+    else if (command.get(0).asString() == "load_map" && command.size() == 2)
+    {
+        if (interface->m_thread->preloadMap(command.get(1).asString()))
+        {
+            reply.addVocab32(VOCAB_OK);
+        }
+        else
+        {
+            reply.addVocab32(VOCAB_ERR);
+        }
+    }
+    else if (command.get(0).asString() == "get_resident_maps")
+    {
+        reply.addVocab32(VOCAB_OK);
+        for (const auto& map_id : interface->m_thread->getResidentMaps())
+        {
+            reply.addString(map_id);
+        }
+    }
+    else if (command.get(0).asString() == "help")
+    {
+        reply.addVocab32(Vocab32::encode("many"));
+        reply.addString("global_localize: finds the robot in the whole map matching the current scans, and reinitializes the filter");
+        reply.addString("                 replies: ok <map> <x> <y> <theta> <score>");
+        reply.addString("get_predicted_pose <t>: the pose at time t (default: now), correcting the odometry at that time");
+        reply.addString("                 replies: ok <map> <x> <y> <theta> <t>");
+        reply.addString("set_particles_stream <max_count> <period>: decimation (0 = all the particles) and publish period [s] (0 = disabled) of the particles port");
+        reply.addString("load_map <map>: prepares a map without stopping the localization, so that a later setInitialPose on it switches map immediately");
+        reply.addString("get_resident_maps: the maps which are ready to be used");
+    }
+    else
+    {
+        reply.addVocab32(Vocab32::encode("many"));
+        reply.addString("Not yet Implemented");
+    }
     return true;
 }
 
@@ -96,8 +181,8 @@ ReturnValue    amclLocalizer::stopLocalizationService()
 
 ReturnValue   amclLocalizer::getCurrentPosition(yarp::dev::Nav2D::Map2DLocation& loc, yarp::sig::Matrix& cov)
 {
-    yCError(AMCL_DEV) << "Not yet implemented";
-    return ReturnValue::return_code::return_value_error_not_implemented_by_device;
+    m_thread->getCurrentLoc(loc, cov);
+    return ReturnValue_ok;
 }
 
 ReturnValue   amclLocalizer::getEstimatedOdometry(yarp::dev::OdometryData& odom)
@@ -115,24 +200,211 @@ ReturnValue   amclLocalizer::getEstimatedPoses(std::vector<Map2DLocation>& poses
 
 ReturnValue   amclLocalizer::getCurrentPosition(Map2DLocation& loc)
 {
+    if (m_thread->predictCurrentPose())
+    {
+        m_thread->getPredictedLoc(yarp::os::Time::now(), loc);
+        return ReturnValue_ok;
+    }
     m_thread->getCurrentLoc(loc);
     return ReturnValue_ok;
 }
 
 ReturnValue   amclLocalizer::setInitialPose(const Map2DLocation& loc)
 {
-    m_thread->initializeLocalization(loc);
+    if (m_thread->initializeLocalization(loc) == false)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
     return ReturnValue_ok;
 }
 
 ReturnValue   amclLocalizer::setInitialPose(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov)
 {
-    m_thread->initializeLocalization(loc,cov);
+    if (m_thread->initializeLocalization(loc,cov) == false)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
     return ReturnValue_ok;
 }
 
 //////////////////////////
 
+amclLaserSource::amclLaserSource(double _period, size_t _index, amclLocalizerThread* _owner) :
+    PeriodicThread(_period), m_index(_index), m_owner(_owner)
+{
+    m_laser_pose = pf_vector_zero();
+}
+
+bool amclLaserSource::open(const std::string& local, const std::string& remote, bool event_driven)
+{
+    m_remote_port = remote;
+    m_event_driven = event_driven;
+
+    if (m_event_driven)
+    {
+        //the scan limits are taken from each received scan
+        bool b1 = m_port_scan_input.open(local);
+        bool b2 = yarp::os::Network::connect(remote, local);
+        if (b1 == false || b2 == false)
+        {
+            yCError(AMCL_DEV) << "Unable to initialize laser port connection from" << remote << "to:" << local;
+            return false;
+        }
+        return true;
+    }
+
+    Property options;
+    options.put("device", LIDAR_CLIENT_DEVICE_DEFAULT);
+    options.put("local", local);
+    options.put("remote", remote);
+    if (m_pLas.open(options) == false)
+    {
+        yCError(AMCL_DEV) << "Unable to open laser driver" << remote;
+        return false;
+    }
+    m_pLas.view(m_iLaser);
+    if (m_iLaser == 0)
+    {
+        yCError(AMCL_DEV) << "Unable to open laser interface" << remote;
+        return false;
+    }
+
+    if (m_iLaser->getScanLimits(m_min_laser_angle, m_max_laser_angle) == false)
+    {
+        yCError(AMCL_DEV) << "Unable to obtain laser scan limits (angles)" << remote;
+        return false;
+    }
+
+    if (m_iLaser->getHorizontalResolution(m_horizontal_resolution) == false)
+    {
+        yCError(AMCL_DEV) << "Unable to getHorizontalResolution()" << remote;
+        return false;
+    }
+
+    if (m_iLaser->getDistanceRange(m_min_laser_distance, m_max_laser_distance) == false)
+    {
+        yCError(AMCL_DEV) << "Unable to obtain laser scan limits (distance)" << remote;
+        return false;
+    }
+    return true;
+}
+
+bool amclLaserSource::startReading()
+{
+    if (m_event_driven)
+    {
+        m_port_scan_input.useCallback(*this);
+        return true;
+    }
+    return start();
+}
+
+void amclLaserSource::close()
+{
+    if (m_event_driven)
+    {
+        m_port_scan_input.disableCallback();
+        m_port_scan_input.interrupt();
+        m_port_scan_input.close();
+        return;
+    }
+    stop();
+    m_pLas.close();
+    m_iLaser = nullptr;
+}
+
+void amclLaserSource::run()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_data_mutex);
+        double timestamp = 0;
+        if (m_iLaser->getLaserMeasurement(m_laser_measurement_data, &timestamp) == false)
+        {
+            return;
+        }
+        if (timestamp <= 0)
+        {
+            //the client does not provide timestamps: the scan is new only if its ranges changed,
+            //then it is stamped with the reception time
+            m_ranges.resize(m_laser_measurement_data.size());
+            for (size_t i = 0; i < m_laser_measurement_data.size(); i++)
+            {
+                double theta = 0;
+                m_laser_measurement_data[i].get_polar(m_ranges[i], theta);
+            }
+            if (m_ranges == m_last_ranges)
+            {
+                return;
+            }
+            m_last_ranges.swap(m_ranges);
+            timestamp = yarp::os::Time::now();
+        }
+        else if (timestamp == m_laser_measurement_timestamp)
+        {
+            //nothing new since the last scan
+            return;
+        }
+        m_laser_measurement_timestamp = timestamp;
+    }
+    m_owner->processLaserScan(*this);
+}
+
+void amclLaserSource::onRead(yarp::dev::LaserScan2D& scan)
+{
+    size_t size = scan.scans.size();
+    if (size == 0)
+    {
+        return;
+    }
+    yarp::os::Stamp stamp;
+    m_port_scan_input.getEnvelope(stamp);
+    {
+        std::lock_guard<std::mutex> lock(m_data_mutex);
+        m_laser_measurement_timestamp = stamp.isValid() ? stamp.getTime() : yarp::os::Time::now();
+
+        //same conventions of the rangefinder client
+        m_min_laser_angle = scan.angle_min;
+        m_max_laser_angle = scan.angle_max;
+        m_min_laser_distance = scan.range_min;
+        m_max_laser_distance = scan.range_max;
+        m_horizontal_resolution = (scan.angle_max - scan.angle_min) / size;
+
+        m_laser_measurement_data.resize(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            double angle = (m_min_laser_angle + i * m_horizontal_resolution) * DEG2RAD;
+            m_laser_measurement_data[i].set_polar(scan.scans[i], angle);
+        }
+    }
+    m_owner->processLaserScan(*this);
+}
+
+void amclLaserSource::getScanPoints(std::vector<pf_vector_t>& points) const
+{
+    std::lock_guard<std::mutex> lock(m_data_mutex);
+    double c = cos(m_laser_pose.v[2]);
+    double s = sin(m_laser_pose.v[2]);
+    for (size_t i = 0; i < m_laser_measurement_data.size(); i++)
+    {
+        double rho = 0;
+        double theta = 0;
+        m_laser_measurement_data[i].get_polar(rho, theta);
+        if (std::isfinite(rho) == false || rho <= m_min_laser_distance || rho >= m_max_laser_distance)
+        {
+            continue;
+        }
+        double angle = (m_min_laser_angle + i * m_horizontal_resolution) * DEG2RAD;
+        double lx = rho * cos(angle);
+        double ly = rho * sin(angle);
+        pf_vector_t p = pf_vector_zero();
+        p.v[0] = m_laser_pose.v[0] + lx * c - ly * s;
+        p.v[1] = m_laser_pose.v[1] + lx * s + ly * c;
+        points.push_back(p);
+    }
+}
+
+//////////////////////////
+
 amclLocalizerThread::amclLocalizerThread(double _period, string _name, yarp::os::Searchable& _cfg) : PeriodicThread(_period), m_name (_name), m_cfg(_cfg)
 {
     m_handler_odom = nullptr;
@@ -141,7 +413,7 @@ amclLocalizerThread::amclLocalizerThread(double _period, string _name, yarp::os:
     m_initial_pose_hyp = nullptr;
     m_amcl_map = nullptr;
     m_iMap = nullptr;
-    m_iLaser = nullptr;
+    m_force_update = false;
 
     m_last_odometry_data_received = -1;
     m_last_statistics_printed = -1;
@@ -150,18 +422,19 @@ amclLocalizerThread::amclLocalizerThread(double _period, string _name, yarp::os:
     m_localization_data.x = nan("");
     m_localization_data.y = nan("");
     m_localization_data.theta = nan("");
+    m_pf_cov = pf_matrix_zero();
 
 }
 
-void amclLocalizerThread::updateFilter()
+void amclLocalizerThread::updateFilter(const amclLaserSource& laser, const amcl_odom_sample_t& odom)
 {
-    int laser_index = 0; //@@@always use the first and unique (for now) laser
+    size_t laser_index = laser.m_index;
 
     pf_vector_t delta = pf_vector_zero();
     pf_vector_t pose;
-    pose.v[0] = m_odometry_data.x;
-    pose.v[1] = m_odometry_data.y;
-    pose.v[2] = m_odometry_data.theta*DEG2RAD; //@@@@ CHECK THIS!!!
+    pose.v[0] = odom.x;
+    pose.v[1] = odom.y;
+    pose.v[2] = odom.theta*DEG2RAD; //@@@@ CHECK THIS!!!
 
     if (m_pf_initialized)
     {
@@ -267,35 +540,35 @@ void amclLocalizerThread::updateFilter()
 #endif
         AMCLLaserData ldata;
         ldata.sensor = m_lasers[laser_index];
-        ldata.range_count = m_laser_measurement_data.size(); //@@@ 360? get this form the laser
-        double angle_min = m_min_laser_angle * DEG2RAD; ///@@@ get this from the laser, THIS needs to be expressed in the base frame, in RADIAS
-        double angle_increment = m_horizontal_resolution *DEG2RAD; //@@@ THIS needs to expressed in the base frame, in RADIANS
+        ldata.range_count = laser.m_laser_measurement_data.size();
+        double angle_min = laser.m_min_laser_angle * DEG2RAD; //laser frame, the laser pose is applied by the sensor model
+        double angle_increment = laser.m_horizontal_resolution *DEG2RAD;
         // wrapping angle to [-pi .. pi]
         angle_increment = fmod(angle_increment + 5 * M_PI, 2 * M_PI) - M_PI; //@@@CHEKC THIS
 
 #ifdef  LOWLEVEL_DEBUG 
-        yCDebug(AMCL_DEV,"Laser #%d, angles in base frame: min: %.3f, inc: %.3f, size %d", laser_index, angle_min, angle_increment, ldata.range_count);
+        yCDebug(AMCL_DEV,"Laser #%zu, angles in laser frame: min: %.3f, inc: %.3f, size %d", laser_index, angle_min, angle_increment, ldata.range_count);
 #endif
 
         // Apply range min/max thresholds, if the user supplied them
         if (m_config.m_laser_max_range > 0.0)
         {
-            double tmp = m_max_laser_distance;
+            double tmp = laser.m_max_laser_distance;
             ldata.range_max = std::min(tmp, m_config.m_laser_max_range);
         }
         else
         {
-            ldata.range_max = m_max_laser_distance;
+            ldata.range_max = laser.m_max_laser_distance;
         }
         double range_min;
         if (m_config.m_laser_min_range > 0.0)
         {
-            double tmp = m_min_laser_distance;
+            double tmp = laser.m_min_laser_distance;
             range_min = std::max(tmp, m_config.m_laser_min_range);
         }
         else
         {
-            range_min = m_min_laser_distance;
+            range_min = laser.m_min_laser_distance;
         }
         // The AMCLLaserData destructor will free this memory
         ldata.ranges = new double[ldata.range_count][2];
@@ -305,7 +578,7 @@ void amclLocalizerThread::updateFilter()
             // amcl doesn't (yet) have a concept of min range.  So we'll map short readings to max range.
             double rho = 0;
             double theta = 0;
-            m_laser_measurement_data[i].get_polar(rho,theta); //@@@@ check carefully, i and theta
+            laser.m_laser_measurement_data[i].get_polar(rho,theta); //@@@@ check carefully, i and theta
             if (rho <= range_min)
             {
                 ldata.ranges[i][0] = ldata.range_max;
@@ -316,7 +589,11 @@ void amclLocalizerThread::updateFilter()
             }
             // Compute bearing
             ldata.ranges[i][1] = angle_min + (i * angle_increment);
-            yCDebug(AMCL_DEV) << ldata.ranges[i][1];
+        }
+
+        if (m_config.m_beam_selection)
+        {
+            selectBeams(laser, odom, ldata);
         }
 
         m_lasers[laser_index]->UpdateSensor(m_handler_pf, (AMCLSensorData*)&ldata);
@@ -343,16 +620,17 @@ void amclLocalizerThread::updateFilter()
         {
             //mutex protected vs amclLocalizerThread::getPoses()
             m_particle_poses_mutex.lock();
-            m_particle_poses.clear();
+            m_particle_cloud.map_id = m_pf_data.map_id;
+            m_particle_cloud.resize(set->sample_count);
             for (int i = 0; i < set->sample_count; i++)
             {
-                Map2DLocation ppose;
-                ppose.x = set->samples[i].pose.v[0];
-                ppose.y = set->samples[i].pose.v[1];
-                ppose.theta = set->samples[i].pose.v[2]*RAD2DEG; //@@@@@@@CHECKME
-                m_particle_poses.push_back(ppose);
+                m_particle_cloud.x[i] = (float)set->poses[0][i];
+                m_particle_cloud.y[i] = (float)set->poses[1][i];
+                m_particle_cloud.theta[i] = (float)set->poses[2][i];
+                m_particle_cloud.weight[i] = (float)set->weights[i];
             }
             m_particle_poses_mutex.unlock();
+            publishParticles(odom.timestamp);
         }
     }
 
@@ -394,33 +672,387 @@ void amclLocalizerThread::updateFilter()
                 hyps[max_weight_hyp].pf_pose_mean.v[2],
                 hyps[max_weight_hyp].pf_pose_mean.v[2]*RAD2DEG);
 
+            //align the scan to the map, starting from the cluster mean
+            pf_vector_t best_pose = hyps[max_weight_hyp].pf_pose_mean;
+            if (m_config.m_icp_refinement)
+            {
+                refinePose(laser, best_pose);
+            }
+
+            Map2DLocation scan_loc;
             m_localization_data_mutex.lock();
-                m_pf_data.x = hyps[max_weight_hyp].pf_pose_mean.v[0];
-                m_pf_data.y = hyps[max_weight_hyp].pf_pose_mean.v[1];
-                m_pf_data.theta = hyps[max_weight_hyp].pf_pose_mean.v[2] * RAD2DEG;
-                m_pf_data.x     -= m_odometry_data.x;
-                m_pf_data.y     -= m_odometry_data.y;
-                m_pf_data.theta -= m_odometry_data.theta;
+                m_pf_cov = hyps[max_weight_hyp].pf_pose_cov;
+                m_pf_data.x = best_pose.v[0];
+                m_pf_data.y = best_pose.v[1];
+                m_pf_data.theta = best_pose.v[2] * RAD2DEG;
+                //the estimate refers to the time of the scan
+                m_pf_data.x     -= odom.x;
+                m_pf_data.y     -= odom.y;
+                m_pf_data.theta -= odom.theta;
+                m_pf_offset_cell.publish(m_pf_data, odom.timestamp);
+                scan_loc.map_id = m_pf_data.map_id;
             m_localization_data_mutex.unlock();
 
 
             // odometry estimation from position
 
-            //velocity estimation block
-            if (1) {estimateOdometry(m_localization_data);}
+            //velocity estimation block: the pose of the scan, at the time of its odometry sample
+            scan_loc.x = best_pose.v[0];
+            scan_loc.y = best_pose.v[1];
+            scan_loc.theta = best_pose.v[2] * RAD2DEG;
+            if (1) {estimateOdometry(scan_loc, odom.timestamp);}
+
+        }
+
+    }
+}
+
+// Scan preprocessing, used instead of the fixed beam step of the sensor models.
+// Keeps one beam for each voxel, drops the beams which hit unmapped space or
+// obstacles which are not in the map (only once the filter has converged, since
+// it relies on the current estimate), and then keeps at most laser_max_beams
+// beams, shared among the orientations of the surfaces they hit: beams on
+// differently oriented surfaces constrain different directions of the pose.
+// The beams at max range hit no surface: they are kept in a group of their own
+// (the beam model scores them), unless drop_max_range_beams is set.
+void amclLocalizerThread::selectBeams(const amclLaserSource& laser, const amcl_odom_sample_t& odom, AMCLLaserData& ldata)
+{
+    std::vector<selected_beam_t>& beams = m_beams;
+    beams.clear();
+    m_beam_voxels.clear();
+
+    //valid hits, one for each voxel
+    for (int i = 0; i < ldata.range_count; i++)
+    {
+        double range = ldata.ranges[i][0];
+        if (std::isfinite(range) == false)
+        {
+            continue;
+        }
+        selected_beam_t b;
+        b.index = i;
+        b.max_range = (range >= ldata.range_max);
+        b.x = range * cos(ldata.ranges[i][1]);
+        b.y = range * sin(ldata.ranges[i][1]);
+        if (b.max_range)
+        {
+            if (m_config.m_drop_max_range_beams == false) { beams.push_back(b); }
+            continue;
+        }
+        if (m_config.m_scan_voxel_size > 0)
+        {
+            uint64_t vx = (uint64_t)(int64_t)floor(b.x / m_config.m_scan_voxel_size);
+            uint64_t vy = (uint64_t)(int64_t)floor(b.y / m_config.m_scan_voxel_size);
+            if (m_beam_voxels.insert((vx << 32) ^ (vy & 0xFFFFFFFF)).second == false)
+            {
+                continue;
+            }
+        }
+        beams.push_back(b);
+    }
+
+    //beams which do not hit the map where the robot is expected to be
+    bool check_dynamic = m_config.m_dynamic_obstacle_dist > 0 && m_amcl_map->max_occ_dist > 0;
+    if ((m_config.m_drop_unmapped_beams || check_dynamic) && m_handler_pf->converged)
+    {
+        pf_vector_t robot_pose;
+        robot_pose.v[0] = m_pf_data.x + odom.x;
+        robot_pose.v[1] = m_pf_data.y + odom.y;
+        robot_pose.v[2] = (m_pf_data.theta + odom.theta) * DEG2RAD;
+        pf_vector_t laser_pose = pf_vector_coord_add(laser.m_laser_pose, robot_pose);
+        double c = cos(laser_pose.v[2]);
+        double s = sin(laser_pose.v[2]);
+        std::vector<selected_beam_t>& mapped = m_beams_tmp;
+        mapped.clear();
+        for (const auto& b : beams)
+        {
+            if (b.max_range) { mapped.push_back(b); continue; }
+            double wx = laser_pose.v[0] + c * b.x - s * b.y;
+            double wy = laser_pose.v[1] + s * b.x + c * b.y;
+            map_cell_t* cell = map_get_cell(m_amcl_map, wx, wy, 0);
+            if (cell == nullptr) { continue; }
+            if (m_config.m_drop_unmapped_beams && cell->occ_state == 0) { continue; }
+            if (check_dynamic && cell->occ_dist > m_config.m_dynamic_obstacle_dist) { continue; }
+            mapped.push_back(b);
+        }
+        //most of the scan disagrees with the map: more likely a wrong estimate
+        //than a crowd, keep everything
+        if (mapped.size() >= beams.size() / 4)
+        {
+            beams.swap(mapped);
+        }
+    }
+
+    //budget shared among the orientations of the hit surfaces, and the beams at max range
+    const int orientation_bins = 8;
+    const int max_range_bin = orientation_bins;
+    size_t budget = (size_t)std::max(m_config.m_max_beams, 2.0);
+    if (beams.size() > budget)
+    {
+        std::vector<std::vector<int>>& bins = m_beam_bins;
+        bins.resize(orientation_bins + 1);
+        for (auto& bin : bins) { bin.clear(); }
+        for (size_t k = 0; k < beams.size(); k++)
+        {
+            if (beams[k].max_range)
+            {
+                bins[max_range_bin].push_back((int)k);
+                continue;
+            }
+            //the surface is estimated from the neighbouring hits
+            size_t kp = (k > 0 && !beams[k - 1].max_range) ? k - 1 : k;
+            size_t kn = (k + 1 < beams.size() && !beams[k + 1].max_range) ? k + 1 : k;
+            double tangent = atan2(beams[kn].y - beams[kp].y, beams[kn].x - beams[kp].x);
+            if (tangent < 0) { tangent += M_PI; }
+            int bin = std::min((int)(tangent / M_PI * orientation_bins), orientation_bins - 1);
+            bins[bin].push_back((int)k);
+        }
+
+        //equal quotas, the unused ones go to the bins with more beams
+        size_t quota[orientation_bins + 1] = {};
+        size_t left = budget;
+        while (left > 0)
+        {
+            size_t open_bins = 0;
+            for (int b = 0; b <= max_range_bin; b++)
+            {
+                if (quota[b] < bins[b].size()) { open_bins++; }
+            }
+            if (open_bins == 0) { break; }
+            size_t share = std::max<size_t>(left / open_bins, 1);
+            for (int b = 0; b <= max_range_bin && left > 0; b++)
+            {
+                size_t add = std::min(std::min(share, bins[b].size() - quota[b]), left);
+                quota[b] += add;
+                left -= add;
+            }
+        }
 
+        //evenly spaced along the scan within each bin
+        std::vector<int>& selected = m_beams_selected;
+        selected.clear();
+        for (int b = 0; b <= max_range_bin; b++)
+        {
+            for (size_t q = 0; q < quota[b]; q++)
+            {
+                selected.push_back(bins[b][q * bins[b].size() / quota[b]]);
+            }
         }
+        std::sort(selected.begin(), selected.end());
+        std::vector<selected_beam_t>& chosen = m_beams_tmp;
+        chosen.clear();
+        for (int k : selected) { chosen.push_back(beams[k]); }
+        beams.swap(chosen);
+    }
 
+    //compact the scan, the beams keep their bearing
+    for (size_t k = 0; k < beams.size(); k++)
+    {
+        ldata.ranges[k][0] = ldata.ranges[beams[k].index][0];
+        ldata.ranges[k][1] = ldata.ranges[beams[k].index][1];
     }
+    ldata.range_count = (int)beams.size();
+}
+
+// Distance from the closest obstacle at a point of the map, and its gradient,
+// bilinearly interpolated from the likelihood field
+static double map_distance(map_t* map, double x, double y, double& dx, double& dy)
+{
+    double gx = (x - map->origin_x) / map->scale + map->size_x / 2;
+    double gy = (y - map->origin_y) / map->scale + map->size_y / 2;
+    int i = (int)floor(gx);
+    int j = (int)floor(gy);
+    double fx = gx - i;
+    double fy = gy - j;
+    double d[2][2];
+    for (int a = 0; a < 2; a++)
+    {
+        for (int b = 0; b < 2; b++)
+        {
+            d[a][b] = MAP_VALID(map, i + a, j + b) ? map->cells[MAP_INDEX(map, i + a, j + b)].occ_dist : map->max_occ_dist;
+        }
+    }
+    dx = ((1 - fy) * (d[1][0] - d[0][0]) + fy * (d[1][1] - d[0][1])) / map->scale;
+    dy = ((1 - fx) * (d[0][1] - d[0][0]) + fx * (d[1][1] - d[1][0])) / map->scale;
+    return (1 - fx) * (1 - fy) * d[0][0] + fx * (1 - fy) * d[1][0] + (1 - fx) * fy * d[0][1] + fx * fy * d[1][1];
+}
+
+// Gauss-Newton alignment of the scan to the likelihood field, minimizing the
+// squared distance of the points from the closest obstacle. The pose is
+// changed only if the alignment improves and stays close to the filter estimate.
+bool amclLocalizerThread::refinePose(const amclLaserSource& laser, pf_vector_t& pose)
+{
+    std::vector<pf_vector_t> all_points;
+    laser.getScanPoints(all_points);
+    if (all_points.size() < 3)
+    {
+        return false;
+    }
+    std::vector<pf_vector_t> points;
+    size_t stride = 1;
+    if (m_config.m_icp_max_points > 0 && all_points.size() > (size_t)m_config.m_icp_max_points)
+    {
+        stride = all_points.size() / m_config.m_icp_max_points;
+    }
+    for (size_t i = 0; i < all_points.size(); i += stride)
+    {
+        points.push_back(all_points[i]);
+    }
+
+    //points farther than this from any obstacle are outliers
+    double outlier_dist = 0.9 * m_amcl_map->max_occ_dist;
+    auto cost = [&](const pf_vector_t& p) -> double
+    {
+        double c = cos(p.v[2]);
+        double s = sin(p.v[2]);
+        double sum = 0;
+        for (const auto& pt : points)
+        {
+            double dx, dy;
+            double d = map_distance(m_amcl_map, p.v[0] + c * pt.v[0] - s * pt.v[1], p.v[1] + s * pt.v[0] + c * pt.v[1], dx, dy);
+            sum += std::min(d, outlier_dist) * std::min(d, outlier_dist);
+        }
+        return sum;
+    };
+
+    pf_vector_t refined = pose;
+    double initial_cost = cost(pose);
+    double current_cost = initial_cost;
+    for (int it = 0; it < m_config.m_icp_iterations; it++)
+    {
+        double c = cos(refined.v[2]);
+        double s = sin(refined.v[2]);
+        double H[3][3] = { { 0 } };
+        double g[3] = { 0 };
+        int inliers = 0;
+        for (const auto& pt : points)
+        {
+            double dx, dy;
+            double d = map_distance(m_amcl_map, refined.v[0] + c * pt.v[0] - s * pt.v[1], refined.v[1] + s * pt.v[0] + c * pt.v[1], dx, dy);
+            if (d >= outlier_dist)
+            {
+                continue;
+            }
+            double J[3] = { dx, dy, dx * (-s * pt.v[0] - c * pt.v[1]) + dy * (c * pt.v[0] - s * pt.v[1]) };
+            for (int a = 0; a < 3; a++)
+            {
+                g[a] += J[a] * d;
+                for (int b = 0; b < 3; b++)
+                {
+                    H[a][b] += J[a] * J[b];
+                }
+            }
+            inliers++;
+        }
+        if (inliers < 3)
+        {
+            break;
+        }
+
+        //solve H * delta = -g (Cramer), with a little damping
+        for (int a = 0; a < 3; a++) { H[a][a] *= 1.0 + 1e-3; H[a][a] += 1e-9; }
+        double det = H[0][0] * (H[1][1] * H[2][2] - H[1][2] * H[2][1])
+                   - H[0][1] * (H[1][0] * H[2][2] - H[1][2] * H[2][0])
+                   + H[0][2] * (H[1][0] * H[2][1] - H[1][1] * H[2][0]);
+        if (fabs(det) < 1e-12)
+        {
+            break;
+        }
+        pf_vector_t delta;
+        for (int a = 0; a < 3; a++)
+        {
+            double M[3][3];
+            for (int r = 0; r < 3; r++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    M[r][k] = (k == a) ? -g[r] : H[r][k];
+                }
+            }
+            delta.v[a] = (M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1])
+                        - M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0])
+                        + M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0])) / det;
+        }
+
+        pf_vector_t candidate = refined;
+        candidate.v[0] += delta.v[0];
+        candidate.v[1] += delta.v[1];
+        candidate.v[2] = normalize(candidate.v[2] + delta.v[2]);
+        double candidate_cost = cost(candidate);
+        if (candidate_cost >= current_cost)
+        {
+            break;
+        }
+        refined = candidate;
+        current_cost = candidate_cost;
+        if (fabs(delta.v[0]) < 1e-4 && fabs(delta.v[1]) < 1e-4 && fabs(delta.v[2]) < 1e-4)
+        {
+            break;
+        }
+    }
+
+    if (current_cost >= initial_cost ||
+        hypot(refined.v[0] - pose.v[0], refined.v[1] - pose.v[1]) > m_config.m_icp_max_correction)
+    {
+        return false;
+    }
+    pose = refined;
+    return true;
 }
 
 bool amclLocalizerThread::getPoses(std::vector<Map2DLocation>& poses)
 {
     std::lock_guard<std::mutex> lock(m_particle_poses_mutex);
-    poses = m_particle_poses;
+    poses.resize(m_particle_cloud.size());
+    for (size_t i = 0; i < m_particle_cloud.size(); i++)
+    {
+        poses[i].map_id = m_particle_cloud.map_id;
+        poses[i].x = m_particle_cloud.x[i];
+        poses[i].y = m_particle_cloud.y[i];
+        poses[i].theta = m_particle_cloud.theta[i] * RAD2DEG;
+    }
     return true;
 }
 
+void amclLocalizerThread::setParticlesStream(size_t max_count, double period)
+{
+    m_particles_max_count = max_count;
+    m_particles_publish_period = period;
+}
+
+void amclLocalizerThread::publishParticles(double timestamp)
+{
+    double now = yarp::os::Time::now();
+    double period = m_particles_publish_period;
+    if (period <= 0 || now - m_last_particles_published < period ||
+        m_port_particles_output.getOutputCount() == 0)
+    {
+        return;
+    }
+    m_last_particles_published = now;
+
+    //decimation: a regular subset of the particles, which are not sorted in any way
+    std::lock_guard<std::mutex> lock(m_particle_poses_mutex);
+    size_t total = m_particle_cloud.size();
+    size_t max_count = m_particles_max_count;
+    size_t count = (max_count > 0) ? std::min(total, max_count) : total;
+    amclParticleCloud& cloud = m_port_particles_output.prepare();
+    cloud.map_id = m_particle_cloud.map_id;
+    cloud.resize(count);
+    double weight_scale = (count > 0) ? (double)total / count : 1.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t k = i * total / count;
+        cloud.x[i] = m_particle_cloud.x[k];
+        cloud.y[i] = m_particle_cloud.y[k];
+        cloud.theta[i] = m_particle_cloud.theta[k];
+        cloud.weight[i] = (float)(m_particle_cloud.weight[k] * weight_scale);
+    }
+    yarp::os::Stamp stamp(m_particles_stamp_count++, timestamp);
+    m_port_particles_output.setEnvelope(stamp);
+    m_port_particles_output.write();
+}
+
 void amclLocalizerThread::run()
 {
     double current_time = yarp::os::Time::now();
@@ -436,43 +1068,82 @@ void amclLocalizerThread::run()
         m_last_statistics_printed = yarp::os::Time::now();
     }
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    //read odometry data
+    //read odometry data. The laser scans are processed by their own threads.
     if (current_time - m_last_odometry_data_received > 0.1)
     {
         yCWarning(AMCL_DEV) << "No localization data received for more than 0.1s!";
     }
+    if (m_event_driven)
+    {
+        //odometry and scans are processed by the port callbacks
+        return;
+    }
     yarp::dev::OdometryData* odom = m_port_odometry_input.read(false);
     if (odom)
     {
-        m_last_odometry_data_received = yarp::os::Time::now();
-        m_odometry_data.x = odom->odom_x;
-        m_odometry_data.y = odom->odom_y;
-        m_odometry_data.theta = odom->odom_theta;
+        yarp::os::Stamp stamp;
+        m_port_odometry_input.getEnvelope(stamp);
+        processOdometry(*odom, stamp.isValid() ? stamp.getTime() : yarp::os::Time::now());
+    }
+    publishLocalization();
+}
+
+void amclLocalizerThread::onRead(yarp::dev::OdometryData& odom)
+{
+    yarp::os::Stamp stamp;
+    m_port_odometry_input.getEnvelope(stamp);
+    processOdometry(odom, stamp.isValid() ? stamp.getTime() : yarp::os::Time::now());
+    publishLocalization();
+}
+
+void amclLocalizerThread::processOdometry(const yarp::dev::OdometryData& odom, double timestamp)
+{
+    m_last_odometry_data_received = yarp::os::Time::now();
+
+    amcl_odom_sample_t sample;
+    sample.timestamp = timestamp;
+    sample.x = odom.odom_x;
+    sample.y = odom.odom_y;
+    sample.theta = odom.odom_theta;
+    sample.vel_x = odom.odom_vel_x;
+    sample.vel_y = odom.odom_vel_y;
+    sample.vel_theta = odom.odom_vel_theta;
+
+    std::lock_guard<std::mutex> lock(m_odometry_mutex);
+    m_odometry_data_timestamp = timestamp;
+    m_odometry_data.x = odom.odom_x;
+    m_odometry_data.y = odom.odom_y;
+    m_odometry_data.theta = odom.odom_theta;
+    if (m_odometry_history_count < m_odometry_history.size())
+    {
+        m_odometry_history[(m_odometry_history_first + m_odometry_history_count) % m_odometry_history.size()] = sample;
+        m_odometry_history_count++;
     }
+    else
+    {
+        //full: overwrite the oldest sample
+        m_odometry_history[m_odometry_history_first] = sample;
+        m_odometry_history_first = (m_odometry_history_first + 1) % m_odometry_history.size();
+    }
+}
 
-    //read laser data
-    bool las_ok = m_iLaser->getLaserMeasurement(m_laser_measurement_data);
-    if (las_ok)
+void amclLocalizerThread::publishLocalization()
+{
+    yarp::dev::Nav2D::Map2DLocation current_odom;
+    double current_odom_timestamp;
     {
-        m_laser_measurement_timestamp = yarp::os::Time::now();
-        pf_vector_t pose_v;
-        //@@@@set here the pose of the laser respect to base_frame_id
-        pose_v.v[0] = 0;
-        pose_v.v[1] = 0;
-        pose_v.v[2] = 0;
-        m_lasers[0]->SetLaserPose(pose_v);
+        std::lock_guard<std::mutex> lock(m_odometry_mutex);
+        current_odom = m_odometry_data;
+        current_odom_timestamp = m_odometry_data_timestamp;
     }
 
-    //process data
-    updateFilter();
-
     //add the odometry
     m_localization_data_mutex.lock();
-        m_localization_data.x     = m_pf_data.x     + m_odometry_data.x;
-        m_localization_data.y     = m_pf_data.y     + m_odometry_data.y;
-        m_localization_data.theta = m_pf_data.theta + m_odometry_data.theta;
+        m_localization_data.x     = m_pf_data.x     + current_odom.x;
+        m_localization_data.y     = m_pf_data.y     + current_odom.y;
+        m_localization_data.theta = m_pf_data.theta + current_odom.theta;
+        m_pose_cell.publish(m_localization_data, &m_pf_cov.m[0][0],
+                            current_odom_timestamp > 0 ? current_odom_timestamp : yarp::os::Time::now());
 #if DEBUG_DATA
         auto& od = m_port_odometry_debug_out.prepare();
         od.odom_x = m_localization_data.x;
@@ -488,13 +1159,116 @@ void amclLocalizerThread::run()
     m_localization_data_mutex.unlock();
 }
 
+bool amclLocalizerThread::getOdometryAt(double timestamp, amcl_odom_sample_t& odom)
+{
+    std::lock_guard<std::mutex> lock(m_odometry_mutex);
+    if (m_odometry_history_count == 0)
+    {
+        return false;
+    }
+    auto sample = [this](size_t k) -> const amcl_odom_sample_t& {
+        return m_odometry_history[(m_odometry_history_first + k) % m_odometry_history.size()];
+    };
+
+    //scans older or newer than the buffered odometry use the closest sample
+    if (timestamp <= sample(0).timestamp)
+    {
+        odom = sample(0);
+        return true;
+    }
+    if (timestamp >= sample(m_odometry_history_count - 1).timestamp)
+    {
+        odom = sample(m_odometry_history_count - 1);
+        return true;
+    }
+
+    //binary search of the first sample not older than the scan
+    size_t lo = 1;
+    size_t hi = m_odometry_history_count - 1;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (sample(mid).timestamp < timestamp) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+
+    //linear interpolation between the two samples around the scan time
+    const amcl_odom_sample_t& prev = sample(lo - 1);
+    const amcl_odom_sample_t& next = sample(lo);
+    double dt = next.timestamp - prev.timestamp;
+    double k = (dt > 0) ? (timestamp - prev.timestamp) / dt : 1.0;
+    odom.timestamp = timestamp;
+    odom.x = prev.x + k * (next.x - prev.x);
+    odom.y = prev.y + k * (next.y - prev.y);
+    odom.theta = prev.theta + k * angle_diff(next.theta * DEG2RAD, prev.theta * DEG2RAD) * RAD2DEG;
+    odom.vel_x = next.vel_x;
+    odom.vel_y = next.vel_y;
+    odom.vel_theta = next.vel_theta;
+    return true;
+}
+
+bool amclLocalizerThread::getPredictedLoc(double timestamp, Map2DLocation& loc)
+{
+    pose_cell_snapshot offset;
+    amcl_odom_sample_t odom;
+    if (m_pf_offset_cell.read(offset) == false || getOdometryAt(timestamp, odom) == false)
+    {
+        //no correction or no odometry yet
+        return getCurrentLoc(loc);
+    }
+
+    //after the last odometry sample, the robot keeps moving with its last velocity
+    double dt = std::min(timestamp - odom.timestamp, m_prediction_max_horizon);
+    if (dt > 0)
+    {
+        odom.x     += odom.vel_x * dt;
+        odom.y     += odom.vel_y * dt;
+        odom.theta += odom.vel_theta * dt;
+    }
+
+    //same composition of publishLocalization()
+    loc.map_id = offset.loc.map_id;
+    loc.x      = offset.loc.x     + odom.x;
+    loc.y      = offset.loc.y     + odom.y;
+    loc.theta  = offset.loc.theta + odom.theta;
+    return true;
+}
+
+void amclLocalizerThread::processLaserScan(const amclLaserSource& laser)
+{
+    amcl_odom_sample_t odom;
+    if (getOdometryAt(laser.m_laser_measurement_timestamp, odom) == false)
+    {
+        //the filter cannot be updated without knowing where the robot was
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        updateFilter(laser, odom);
+    }
+    if (m_event_driven)
+    {
+        //do not wait for the next odometry sample to publish the corrected pose
+        publishLocalization();
+    }
+}
+
 bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc, const yarp::sig::Matrix& cov)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_localization_data.map_id = loc.map_id;
-    m_localization_data.x = loc.x;
-    m_localization_data.y = loc.y;
-    m_localization_data.theta = loc.theta;
+    //e.g. the robot reached another floor
+    if (loc.map_id.empty() == false && switchMap(loc.map_id) == false)
+    {
+        return false;
+    }
+    m_localization_data_mutex.lock();
+        m_localization_data.map_id = loc.map_id;
+        m_localization_data.x = loc.x;
+        m_localization_data.y = loc.y;
+        m_localization_data.theta = loc.theta;
+        m_pose_cell.publish(m_localization_data, cov, yarp::os::Time::now());
+    m_localization_data_mutex.unlock();
 
     // Re-initialize the filter
     pf_vector_t pf_init_pose_mean = pf_vector_zero();
@@ -525,14 +1299,28 @@ bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc, const
 bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_pf_data.map_id = loc.map_id;
-    m_pf_data.x = loc.x - m_odometry_data.x;
-    m_pf_data.y = loc.y - m_odometry_data.y;
-    m_pf_data.theta = loc.theta - m_odometry_data.theta;
-    m_localization_data.map_id = loc.map_id;
-    m_localization_data.x      = loc.x;
-    m_localization_data.y      = loc.y;
-    m_localization_data.theta  = loc.theta;
+    //e.g. the robot reached another floor
+    if (loc.map_id.empty() == false && switchMap(loc.map_id) == false)
+    {
+        return false;
+    }
+    Map2DLocation current_odom;
+    {
+        std::lock_guard<std::mutex> odom_lock(m_odometry_mutex);
+        current_odom = m_odometry_data;
+    }
+    m_localization_data_mutex.lock();
+        m_pf_data.map_id = loc.map_id;
+        m_pf_data.x = loc.x - current_odom.x;
+        m_pf_data.y = loc.y - current_odom.y;
+        m_pf_data.theta = loc.theta - current_odom.theta;
+        m_pf_offset_cell.publish(m_pf_data, yarp::os::Time::now());
+        m_localization_data.map_id = loc.map_id;
+        m_localization_data.x      = loc.x;
+        m_localization_data.y      = loc.y;
+        m_localization_data.theta  = loc.theta;
+        m_pose_cell.publish(m_localization_data, m_initial_covariance_msg, yarp::os::Time::now());
+    m_localization_data_mutex.unlock();
 
     // Re-initialize the filter
     pf_vector_t pf_init_pose_mean = pf_vector_zero();
@@ -576,8 +1364,21 @@ bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc)
 
 bool amclLocalizerThread::getCurrentLoc(Map2DLocation& loc)
 {
-    std::lock_guard<std::mutex> lock (m_localization_data_mutex);
-    loc = m_localization_data;
+    if (!m_pose_cell.read(loc))
+    {
+        loc = Map2DLocation("unknown", nan(""), nan(""), nan(""));
+    }
+    return true;
+}
+
+bool amclLocalizerThread::getCurrentLoc(Map2DLocation& loc, yarp::sig::Matrix& cov)
+{
+    if (!m_pose_cell.read(loc, cov))
+    {
+        loc = Map2DLocation("unknown", nan(""), nan(""), nan(""));
+        cov.resize(3, 3);
+        cov.zero();
+    }
     return true;
 }
 
@@ -632,13 +1433,67 @@ bool amclLocalizerThread::threadInit()
         return false;
     }
 
-    //laser group
+    //laser group. `laser_broadcast_port` is either a single port or a list of ports,
+    //one for each laser. `laser_pose` optionally gives the pose (x y theta_deg) of each
+    //laser with respect to the robot, as a list with the same number of entries.
     if (laser_group.check("laser_broadcast_port") == false)
     {
         yCError(AMCL_DEV) << "Missing `laser_broadcast_port` in [LASER] group";
         return false;
     }
-    m_laser_remote_port = laser_group.find("laser_broadcast_port").asString();
+    std::vector<std::string> laser_remote_ports;
+    Value laser_ports_val = laser_group.find("laser_broadcast_port");
+    if (laser_ports_val.isList())
+    {
+        Bottle* laser_ports = laser_ports_val.asList();
+        for (size_t i = 0; i < laser_ports->size(); i++)
+        {
+            laser_remote_ports.push_back(laser_ports->get(i).asString());
+        }
+    }
+    else
+    {
+        laser_remote_ports.push_back(laser_ports_val.asString());
+    }
+    if (laser_remote_ports.empty())
+    {
+        yCError(AMCL_DEV) << "`laser_broadcast_port` in [LASER] group is empty";
+        return false;
+    }
+
+    std::vector<pf_vector_t> laser_poses(laser_remote_ports.size(), pf_vector_zero());
+    if (laser_group.check("laser_pose"))
+    {
+        Bottle* poses = laser_group.find("laser_pose").asList();
+        //a single laser can also be given as a plain (x y theta) triplet
+        if (poses && laser_remote_ports.size() == 1 && poses->size() == 3 && poses->get(0).isList() == false)
+        {
+            laser_poses[0].v[0] = poses->get(0).asFloat64();
+            laser_poses[0].v[1] = poses->get(1).asFloat64();
+            laser_poses[0].v[2] = poses->get(2).asFloat64() * DEG2RAD;
+        }
+        else if (poses && poses->size() == laser_remote_ports.size())
+        {
+            for (size_t i = 0; i < poses->size(); i++)
+            {
+                Bottle* p = poses->get(i).asList();
+                if (p == nullptr || p->size() != 3)
+                {
+                    yCError(AMCL_DEV) << "Invalid `laser_pose` entry" << i << ", expected (x y theta)";
+                    return false;
+                }
+                laser_poses[i].v[0] = p->get(0).asFloat64();
+                laser_poses[i].v[1] = p->get(1).asFloat64();
+                laser_poses[i].v[2] = p->get(2).asFloat64() * DEG2RAD;
+            }
+        }
+        else
+        {
+            yCError(AMCL_DEV) << "`laser_pose` must contain one (x y theta) entry for each laser";
+            return false;
+        }
+    }
+    m_laser_read_period = laser_group.check("laser_read_period", Value(m_laser_read_period)).asFloat64();
 
     //odometry group
     if (odometry_group.check("odometry_broadcast_port") == false)
@@ -655,6 +1510,18 @@ bool amclLocalizerThread::threadInit()
 
     //opens a YARP port to receive odometry data
     std::string odom_portname = m_name + "/odometry:i";
+    m_event_driven = general_group.check("event_driven", Value(false)).asBool();
+    m_predict_current_pose = general_group.check("predict_current_pose", Value(false)).asBool();
+    m_particles_max_count = (size_t)std::max(0, general_group.check("particles_max_count", Value(500)).asInt32());
+    m_particles_publish_period = general_group.check("particles_publish_period", Value(0.2)).asFloat64();
+    if (m_port_particles_output.open(m_name + "/particles:o") == false)
+    {
+        yCError(AMCL_DEV) << "Unable to open port" << m_name + "/particles:o";
+        return false;
+    }
+    m_odometry_history_max_size = odometry_group.check("odometry_history_size", Value((int)m_odometry_history_max_size)).asInt32();
+    m_prediction_max_horizon = odometry_group.check("prediction_max_horizon", Value(m_prediction_max_horizon)).asFloat64();
+    m_odometry_history.resize(std::max<size_t>(m_odometry_history_max_size, 1));
     bool b1 = m_port_odometry_input.open(odom_portname.c_str());
     bool b2 = yarp::os::Network::sync(odom_portname.c_str(), false);
     bool b3 = yarp::os::Network::connect(m_port_broadcast_odometry_name.c_str(), odom_portname.c_str());
@@ -704,6 +1571,7 @@ bool amclLocalizerThread::threadInit()
     m_config.m_sigma_hit = amcl_group.check("laser_sigma_hit", Value(0.2)).asFloat64();
     m_config.m_lambda_short = amcl_group.check("laser_lambda_short", Value(0.1)).asFloat64();
     m_config.m_laser_likelihood_max_dist = amcl_group.check("laser_likelihood_max_dist", Value(2.0)).asFloat64();
+    m_config.m_laser_range_table_angles = amcl_group.check("laser_range_table_angles", Value(0)).asInt32();
     std::string tmp_laser_model_type = amcl_group.check("laser_model_type", Value("likelihood_field")).asString();
 
     m_initial_covariance_msg.resize(3, 3);
@@ -754,6 +1622,36 @@ bool amclLocalizerThread::threadInit()
     m_base_frame_id = amcl_group.check("base_frame_id", Value("base_link")).asString();
     m_global_frame_id = amcl_group.check("global_frame_id", Value("map")).asString();
     m_resample_interval = amcl_group.check("resample_interval", Value(2)).asFloat64();
+
+    std::string tmp_resample_type = amcl_group.check("resample_type", Value("systematic")).asString();
+    if (tmp_resample_type == "systematic")
+        m_resample_type = PF_RESAMPLE_SYSTEMATIC;
+    else if (tmp_resample_type == "stratified")
+        m_resample_type = PF_RESAMPLE_STRATIFIED;
+    else if (tmp_resample_type == "residual")
+        m_resample_type = PF_RESAMPLE_RESIDUAL;
+    else
+    {
+        yCWarning(AMCL_DEV,"Unknown resample type \"%s\"; defaulting to systematic resampling",
+            tmp_resample_type.c_str());
+        m_resample_type = PF_RESAMPLE_SYSTEMATIC;
+    }
+    //0 means: seed from the current time
+    m_config.m_rng_seed = amcl_group.check("rng_seed", Value(0)).asInt32();
+    m_config.m_global_loc_levels = amcl_group.check("global_loc_levels", Value(7)).asInt32();
+    m_config.m_global_loc_max_hyps = amcl_group.check("global_loc_max_hypotheses", Value(5)).asInt32();
+    m_config.m_global_loc_max_points = amcl_group.check("global_loc_max_points", Value(150)).asInt32();
+    m_config.m_global_loc_min_score = amcl_group.check("global_loc_min_score", Value(0.5)).asFloat64();
+    m_config.m_global_loc_angular_step = amcl_group.check("global_loc_angular_step", Value(0.0)).asFloat64();
+    m_config.m_beam_selection = amcl_group.check("beam_selection", Value(false)).asBool();
+    m_config.m_scan_voxel_size = amcl_group.check("scan_voxel_size", Value(0.0)).asFloat64();
+    m_config.m_drop_unmapped_beams = amcl_group.check("drop_unmapped_beams", Value(true)).asBool();
+    m_config.m_drop_max_range_beams = amcl_group.check("drop_max_range_beams", Value(false)).asBool();
+    m_config.m_dynamic_obstacle_dist = amcl_group.check("dynamic_obstacle_dist", Value(0.0)).asFloat64();
+    m_config.m_icp_refinement = amcl_group.check("icp_refinement", Value(false)).asBool();
+    m_config.m_icp_iterations = amcl_group.check("icp_iterations", Value(5)).asInt32();
+    m_config.m_icp_max_points = amcl_group.check("icp_max_points", Value(60)).asInt32();
+    m_config.m_icp_max_correction = amcl_group.check("icp_max_correction", Value(0.2)).asFloat64();
      
     m_config.m_alpha_slow = amcl_group.check("recovery_alpha_slow", Value(0.001)).asFloat64();
     m_config.m_alpha_fast = amcl_group.check("recovery_alpha_fast", Value(0.1)).asFloat64();
@@ -776,21 +1674,15 @@ bool amclLocalizerThread::threadInit()
         return false;
     }
 
-    //get the map
-    yCInfo(AMCL_DEV) << "Asking for map '" << m_initial_loc.map_id << "'...";
-    bool b = m_iMap->get_map(m_initial_loc.map_id, m_yarp_map);
-    //m_yarp_map.crop(-1, -1, -1, -1); ///@@@@@@@@@@@ do not crop for now!
-    if (b)
+    //get the map. Its sensor model data is computed below, by the laser model.
+    m_active_map = loadMap(m_initial_loc.map_id, false);
+    if (m_active_map == nullptr)
     {
-        yCInfo(AMCL_DEV) << "'"<< m_initial_loc.map_id <<"' received";
-    }
-    else
-    {
-        yCError(AMCL_DEV) << "'" << m_initial_loc.map_id << "' not found";
         return false;
     }
-
-    m_amcl_map = convertMap(m_yarp_map);
+    m_active_map->pinned = true;
+    m_resident_maps[m_initial_loc.map_id] = m_active_map;
+    m_amcl_map = m_active_map->amcl_map;
 
     if (m_handler_pf != nullptr)
     {
@@ -799,10 +1691,15 @@ bool amclLocalizerThread::threadInit()
     }
     m_handler_pf = pf_alloc(m_config.m_min_particles, m_config.m_max_particles,
                             m_config.m_alpha_slow, m_config.m_alpha_fast,
-                           (pf_init_model_fn_t)amclLocalizerThread::uniformPoseGenerator,
+                           amclLocalizerThread::uniformPoseGenerator,
                            (void *)m_amcl_map);
     m_handler_pf->pop_err = m_config.m_pf_err;
     m_handler_pf->pop_z = m_config.m_pf_z;
+    m_handler_pf->resample_type = m_resample_type;
+    if (m_config.m_rng_seed != 0)
+    {
+        pf_set_seed(m_handler_pf, m_config.m_rng_seed);
+    }
 
     // Initialize the filter
     pf_vector_t pf_init_pose_mean = pf_vector_zero();
@@ -840,7 +1737,16 @@ bool amclLocalizerThread::threadInit()
     yAssert(m_handler_laser);
     if (m_laser_model_type == LASER_MODEL_BEAM)
     {
-        m_handler_laser->SetModelBeam(m_config.m_z_hit, m_config.m_z_short, m_config.m_z_max, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_lambda_short, 0.0);
+        if (m_config.m_laser_range_table_angles > 0)
+        {
+            yCInfo(AMCL_DEV,"Precomputing the map ranges; this can take some time on large maps...");
+        }
+        m_handler_laser->SetModelBeam(m_config.m_z_hit, m_config.m_z_short, m_config.m_z_max, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_lambda_short, 0.0,
+            m_config.m_laser_range_table_angles);
+        if (m_config.m_laser_range_table_angles > 0 && m_amcl_map->range_table == nullptr)
+        {
+            yCWarning(AMCL_DEV,"Unable to precompute the map ranges, using ray casting");
+        }
     }
     else if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
     {
@@ -857,55 +1763,92 @@ bool amclLocalizerThread::threadInit()
         m_handler_laser->SetModelLikelihoodField(m_config.m_z_hit, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_laser_likelihood_max_dist);
         yCInfo(AMCL_DEV,"Done initializing likelihood field model.");
     }
-
-    //opens the laser client and the corresponding interface
-    Property options;
-    options.put("device", LIDAR_CLIENT_DEVICE_DEFAULT);
-    options.put("local", m_name + "/laser:i");
-    options.put("remote", m_laser_remote_port);
-    if (m_pLas.open(options) == false)
-    {
-        yCError(AMCL_DEV) << "Unable to open laser driver";
-        return false;
-    }
-    m_pLas.view(m_iLaser);
-    if (m_iLaser == 0)
+    if (m_config.m_icp_refinement && m_laser_model_type == LASER_MODEL_BEAM)
     {
-        yCError(AMCL_DEV) << "Unable to open laser interface";
-        return false;
+        //the scan refinement uses the likelihood field also with the beam model
+        map_update_cspace(m_amcl_map, m_config.m_laser_likelihood_max_dist);
     }
 
-    if (m_iLaser->getScanLimits(m_min_laser_angle, m_max_laser_angle) == false)
+    //opens a laser client for each equipped laser device, and the corresponding sensor model
+    for (size_t i = 0; i < laser_remote_ports.size(); i++)
     {
-        yCError(AMCL_DEV) << "Unable to obtain laser scan limits (angles)";
-        return false;
-    }
+        std::string local = (laser_remote_ports.size() == 1) ? m_name + "/laser:i" : m_name + "/laser" + std::to_string(i) + ":i";
+        amclLaserSource* laser = new amclLaserSource(m_laser_read_period, i, this);
+        laser->m_laser_pose = laser_poses[i];
+        m_laser_sources.push_back(laser);
+        if (laser->open(local, laser_remote_ports[i], m_event_driven) == false)
+        {
+            return false;
+        }
 
-    if (m_iLaser->getHorizontalResolution(m_horizontal_resolution) == false)
-    {
-        yCError(AMCL_DEV) << "Unable to getHorizontalResolution()";
-        return false;
+        AMCLLaser* laser_model = new AMCLLaser(*m_handler_laser);
+        laser_model->SetLaserPose(laser_poses[i]);
+        m_lasers.push_back(laser_model);
+        m_lasers_update.push_back(true);
     }
 
-    if (m_iLaser->getDistanceRange(m_min_laser_distance, m_max_laser_distance) == false)
+    //the other maps the robot can move to (e.g. the other floors), ready to be
+    //used as soon as initializeLocalization() asks for them
+    Bottle map_group = m_cfg.findGroup("MAP");
+    m_max_resident_maps = (size_t)std::max(1, map_group.check("max_resident_maps", Value((int)m_max_resident_maps)).asInt32());
+    Bottle* resident_maps = map_group.check("resident_maps") ? map_group.find("resident_maps").asList() : nullptr;
+    for (size_t i = 0; resident_maps && i < resident_maps->size(); i++)
     {
-        yCError(AMCL_DEV) << "Unable to obtain laser scan limits (distance)";
-        return false;
+        std::string map_id = resident_maps->get(i).asString();
+        if (m_resident_maps.count(map_id))
+        {
+            continue;
+        }
+        std::shared_ptr<amcl_resident_map_t> map = loadMap(map_id, true);
+        if (map == nullptr)
+        {
+            yCWarning(AMCL_DEV) << "Unable to load the resident map" << map_id << ", it will be loaded when needed";
+            continue;
+        }
+        map->pinned = true;
+        m_resident_maps[map_id] = map;
     }
 
-    m_laser_angle_of_view = fabs(m_min_laser_angle) + fabs(m_max_laser_angle);
-    
-    //@@@@ add an entry for each equipped laser device
-    m_lasers.push_back(new AMCLLaser(*m_handler_laser));
-    m_lasers_update.push_back(true);
-
     //@@@CHECK the position of this call
     this->initializeLocalization(m_initial_loc);
+
+    //the filter is ready: start feeding it with the scans
+    for (auto laser : m_laser_sources)
+    {
+        if (laser->startReading() == false)
+        {
+            yCError(AMCL_DEV) << "Unable to start reading laser" << laser->m_remote_port;
+            return false;
+        }
+    }
+    if (m_event_driven)
+    {
+        m_port_odometry_input.useCallback(*this);
+    }
     return true;
 }
 
 void amclLocalizerThread::threadRelease()
 {
+    m_port_particles_output.interrupt();
+    m_port_particles_output.close();
+    if (m_event_driven)
+    {
+        m_port_odometry_input.disableCallback();
+    }
+    for (auto laser : m_laser_sources)
+    {
+        laser->close();
+        delete laser;
+    }
+    m_laser_sources.clear();
+    for (auto laser_model : m_lasers)
+    {
+        delete laser_model;
+    }
+    m_lasers.clear();
+    m_lasers_update.clear();
+
     if (m_handler_odom)
     {
         delete m_handler_odom;
@@ -923,18 +1866,23 @@ void amclLocalizerThread::threadRelease()
        pf_free(m_handler_pf);
        m_handler_pf = nullptr;
     }
+
+    m_amcl_map = nullptr;
+    m_active_map.reset();
+    std::lock_guard<std::mutex> maps_lock(m_maps_mutex);
+    m_resident_maps.clear();
 }
 
-pf_vector_t amclLocalizerThread::uniformPoseGenerator(void* arg)
+pf_vector_t amclLocalizerThread::uniformPoseGenerator(void* arg, pf_rng_t* rng)
 {
     map_t* map = (map_t*)arg;
 #if NEW_UNIFORM_SAMPLING
-    unsigned int rand_index = drand48() * free_space_indices.size();
+    unsigned int rand_index = pf_rng_uniform(rng) * free_space_indices.size();
     std::pair<int, int> free_point = free_space_indices[rand_index];
     pf_vector_t p;
     p.v[0] = MAP_WXGX(map, free_point.first);
     p.v[1] = MAP_WYGY(map, free_point.second);
-    p.v[2] = drand48() * 2 * M_PI - M_PI;
+    p.v[2] = pf_rng_uniform(rng) * 2 * M_PI - M_PI;
 #else
     double min_x, max_x, min_y, max_y;
 
@@ -942,33 +1890,18 @@ pf_vector_t amclLocalizerThread::uniformPoseGenerator(void* arg)
     max_x = (map->size_x * map->scale) / 2.0 + map->origin_x;
     min_y = -(map->size_y * map->scale) / 2.0 + map->origin_y;
     max_y = (map->size_y * map->scale) / 2.0 + map->origin_y;
+    if (max_x < min_x) std::swap(min_x, max_x);
+    if (max_y < min_y) std::swap(min_y, max_y);
 
     pf_vector_t p;
 
     yCDebug(AMCL_DEV,"Generating new uniform sample");
-    std::random_device rd;
-    std::mt19937 gen(rd());
-#if 0
-    std::uniform_real_distribution<double> dis_x(min_x, max_x);
-    std::uniform_real_distribution<double> dis_y(min_y, max_y);
-#else
-    if (max_x < min_x) std::swap(min_x, max_x);
-    std::uniform_real_distribution<double> dis_x(min_x, max_x);
-
-    if (max_y < min_y) std::swap(min_y, max_y);
-    std::uniform_real_distribution<double> dis_y(min_y, max_y);
-#endif
-    std::uniform_real_distribution<double> dis_t(-M_PI, +M_PI);
-
+    //drawn from the filter generator, so that a filter with a fixed rng_seed is reproducible
     for (size_t check_counter=0;; check_counter++)
     {
-        //p.v[0] = min_x + drand48() * (max_x - min_x);
-        //p.v[1] = min_y + drand48() * (max_y - min_y);
-        //p.v[2] = drand48() * 2 * M_PI - M_PI;
-
-        p.v[0] = dis_x(gen);
-        p.v[1] = dis_y(gen);
-        p.v[2] = dis_t(gen);
+        p.v[0] = min_x + pf_rng_uniform(rng) * (max_x - min_x);
+        p.v[1] = min_y + pf_rng_uniform(rng) * (max_y - min_y);
+        p.v[2] = pf_rng_uniform(rng) * 2 * M_PI - M_PI;
         // Check that it's a free cell
         int i, j;
         i = MAP_GXWX(map, p.v[0]);
@@ -987,65 +1920,169 @@ pf_vector_t amclLocalizerThread::uniformPoseGenerator(void* arg)
     return p;
 }
 
-map_t* amclLocalizerThread::convertMap(MapGrid2D& yarp_map)
+std::shared_ptr<amcl_resident_map_t> amclLocalizerThread::loadMap(const std::string& map_id, bool prepare_sensor_model)
 {
-    map_t* map = map_alloc();
-    yAssert(map);
-
-    map->size_x = yarp_map.width();
-    map->size_y = yarp_map.height();
-    yarp_map.getResolution(map->scale);
-    double x_orig;
-    double y_orig;
-    double t_orig;
-    yarp_map.getOrigin(x_orig, y_orig, t_orig);
-    map->origin_x = x_orig + (map->size_x / 2) * map->scale;
-    map->origin_y = y_orig + (map->size_y / 2) * map->scale;
-
-    map->cells = (map_cell_t*)malloc(sizeof(map_cell_t)*map->size_x*map->size_y);
-    yAssert(map->cells);
-    //for (int i = 0; i<map->size_x * map->size_y; i++)
-    for (int y = 0; y < map->size_y; y++)
-        for (int x = 0; x < map->size_x; x++)
-    {
-        int i = y * map->size_x + x;
-        double occupancy;
-        Nav2D::XYCell cell(x,y);
-
-        yarp_map.getOccupancyData(cell, occupancy);
-
-#if 0
-        if (occupancy == 0)
-            map->cells[i].occ_state = -1;
-        else if (occupancy == 100)
-            map->cells[i].occ_state = +1;
-        else
-            map->cells[i].occ_state = 0;
-#else
-        //@@@@check me
-        if (occupancy >= 0)
+    std::shared_ptr<amcl_resident_map_t> map = std::make_shared<amcl_resident_map_t>();
+    map->map_id = map_id;
+
+    yCInfo(AMCL_DEV) << "Asking for map '" << map_id << "'...";
+    bool b = m_iMap->get_map(map_id, map->yarp_map);
+    //map->yarp_map.crop(-1, -1, -1, -1); ///@@@@@@@@@@@ do not crop for now!
+    if (b)
+    {
+        yCInfo(AMCL_DEV) << "'" << map_id << "' received";
+    }
+    else
+    {
+        yCError(AMCL_DEV) << "'" << map_id << "' not found";
+        return nullptr;
+    }
+
+    double t0 = yarp::os::Time::now();
+    map->amcl_map = amclConvertMap(map->yarp_map);
+
+    //pyramid used by the global_localize command
+    if (map->global_matcher.build(map->amcl_map, m_config.m_sigma_hit, m_config.m_global_loc_levels) == false)
+    {
+        yCWarning(AMCL_DEV) << "Unable to initialize the global localization on" << map_id << ", global_localize will not be available";
+    }
+
+    //the same data the laser model computes for the map it is created with
+    if (prepare_sensor_model)
+    {
+        if (m_laser_model_type == LASER_MODEL_BEAM)
         {
-            if (occupancy > 50)
+            if (m_config.m_laser_range_table_angles > 0 &&
+                map_build_range_table(map->amcl_map, m_config.m_laser_range_table_angles) != 0)
             {
-                map->cells[i].occ_state = +1;
+                yCWarning(AMCL_DEV) << "Unable to precompute the ranges of" << map_id << ", using ray casting";
             }
-            else
+            if (m_config.m_icp_refinement)
             {
-                map->cells[i].occ_state = -1;
+                map_update_cspace(map->amcl_map, m_config.m_laser_likelihood_max_dist);
             }
         }
         else
         {
-            map->cells[i].occ_state = 0;
+            map_update_cspace(map->amcl_map, m_config.m_laser_likelihood_max_dist);
         }
-#endif
+    }
+    yCInfo(AMCL_DEV, "'%s' ready in %.3fs", map_id.c_str(), yarp::os::Time::now() - t0);
+    return map;
+}
+
+std::shared_ptr<amcl_resident_map_t> amclLocalizerThread::getResidentMap(const std::string& map_id)
+{
+    {
+        std::lock_guard<std::mutex> maps_lock(m_maps_mutex);
+        auto it = m_resident_maps.find(map_id);
+        if (it != m_resident_maps.end())
+        {
+            it->second->last_used = yarp::os::Time::now();
+            return it->second;
+        }
+    }
+
+    //not resident: load it without blocking the lookups of the other maps
+    std::shared_ptr<amcl_resident_map_t> map = loadMap(map_id, true);
+    if (map == nullptr)
+    {
+        return nullptr;
+    }
 
-        
+    std::lock_guard<std::mutex> maps_lock(m_maps_mutex);
+    auto it = m_resident_maps.find(map_id);
+    if (it != m_resident_maps.end())
+    {
+        //loaded meanwhile by another thread
+        map = it->second;
+    }
+    else
+    {
+        m_resident_maps[map_id] = map;
     }
+    map->last_used = yarp::os::Time::now();
 
+    //drop the least recently used maps which are not configured and not in use
+    while (m_resident_maps.size() > m_max_resident_maps)
+    {
+        auto lru = m_resident_maps.end();
+        for (auto m = m_resident_maps.begin(); m != m_resident_maps.end(); m++)
+        {
+            if (m->second->pinned || m->second == map || m->second.use_count() > 1)
+            {
+                continue;
+            }
+            if (lru == m_resident_maps.end() || m->second->last_used < lru->second->last_used)
+            {
+                lru = m;
+            }
+        }
+        if (lru == m_resident_maps.end())
+        {
+            break;
+        }
+        yCInfo(AMCL_DEV) << "Map" << lru->first << "is no more resident";
+        m_resident_maps.erase(lru);
+    }
     return map;
 }
 
+bool amclLocalizerThread::switchMap(const std::string& map_id)
+{
+    //called with m_mutex locked
+    if (m_active_map != nullptr && m_active_map->map_id == map_id)
+    {
+        return true;
+    }
+
+    bool resident = false;
+    {
+        std::lock_guard<std::mutex> maps_lock(m_maps_mutex);
+        resident = m_resident_maps.count(map_id) > 0;
+    }
+    if (resident == false)
+    {
+        yCWarning(AMCL_DEV) << "Map" << map_id << "is not resident, the localization stops while it is loaded."
+                            << "Add it to `resident_maps` in [MAP] group, or preload it with the `load_map` rpc command";
+    }
+    std::shared_ptr<amcl_resident_map_t> map = getResidentMap(map_id);
+    if (map == nullptr)
+    {
+        yCError(AMCL_DEV) << "Unable to switch to map" << map_id;
+        return false;
+    }
+
+    //the sensor models, the uniform pose generator and the scan preprocessing
+    //only keep a pointer to the map, and its data is already computed
+    m_active_map = map;
+    m_amcl_map = map->amcl_map;
+    m_handler_laser->SetMap(m_amcl_map);
+    for (auto laser_model : m_lasers)
+    {
+        laser_model->SetMap(m_amcl_map);
+    }
+    m_handler_pf->random_pose_data = m_amcl_map;
+    yCInfo(AMCL_DEV) << "Localizing in map" << map_id;
+    return true;
+}
+
+bool amclLocalizerThread::preloadMap(const std::string& map_id)
+{
+    return getResidentMap(map_id) != nullptr;
+}
+
+std::vector<std::string> amclLocalizerThread::getResidentMaps()
+{
+    std::vector<std::string> maps;
+    std::lock_guard<std::mutex> maps_lock(m_maps_mutex);
+    for (const auto& m : m_resident_maps)
+    {
+        maps.push_back(m.first);
+    }
+    return maps;
+}
+
 bool amclLocalizer::open(yarp::os::Searchable& config)
 {
     string cfg_temp = config.toString();
@@ -1106,6 +2143,105 @@ bool amclLocalizer::close()
     return true;
 }
  
+bool amclLocalizerThread::globalLocalization(Map2DLocation& loc, double& score)
+{
+    //the search is long: it does not hold m_mutex, and keeps the map alive if it is switched meanwhile
+    std::shared_ptr<amcl_resident_map_t> map;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        map = m_active_map;
+    }
+    if (map == nullptr || map->global_matcher.isReady() == false)
+    {
+        yCError(AMCL_DEV) << "Global localization is not available";
+        return false;
+    }
+
+    std::vector<pf_vector_t> points;
+    for (auto laser : m_laser_sources)
+    {
+        laser->getScanPoints(points);
+    }
+    if (points.empty())
+    {
+        yCError(AMCL_DEV) << "Global localization: no laser data";
+        return false;
+    }
+    if (m_config.m_global_loc_max_points > 0 && points.size() > (size_t)m_config.m_global_loc_max_points)
+    {
+        std::vector<pf_vector_t> decimated;
+        double step = (double)points.size() / m_config.m_global_loc_max_points;
+        for (int i = 0; i < m_config.m_global_loc_max_points; i++)
+        {
+            decimated.push_back(points[(size_t)(i * step)]);
+        }
+        points.swap(decimated);
+    }
+
+    double t0 = yarp::os::Time::now();
+    std::vector<amcl_match_t> hyps;
+    if (map->global_matcher.match(points, m_config.m_global_loc_max_hyps, m_config.m_global_loc_min_score,
+                               m_config.m_global_loc_angular_step * DEG2RAD, hyps) == false)
+    {
+        yCWarning(AMCL_DEV) << "Global localization: the scan does not match the map anywhere";
+        return false;
+    }
+    yCInfo(AMCL_DEV, "Global localization: %zu hypotheses found in %.3fs, best score %.3f",
+        hyps.size(), yarp::os::Time::now() - t0, hyps[0].score);
+
+    loc.map_id = map->map_id;
+    loc.x = hyps[0].x;
+    loc.y = hyps[0].y;
+    loc.theta = hyps[0].theta * RAD2DEG;
+    score = hyps[0].score;
+
+    Map2DLocation current_odom;
+    {
+        std::lock_guard<std::mutex> odom_lock(m_odometry_mutex);
+        current_odom = m_odometry_data;
+    }
+
+    //seed the filter with all the hypotheses
+    std::vector<pf_vector_t> means(hyps.size());
+    std::vector<double> weights(hyps.size());
+    for (size_t i = 0; i < hyps.size(); i++)
+    {
+        means[i] = pf_vector_zero();
+        means[i].v[0] = hyps[i].x;
+        means[i].v[1] = hyps[i].y;
+        means[i].v[2] = hyps[i].theta;
+        weights[i] = hyps[i].score;
+    }
+    //about the resolution of the search
+    pf_matrix_t cov = pf_matrix_zero();
+    cov.m[0][0] = 4 * map->amcl_map->scale * map->amcl_map->scale;
+    cov.m[1][1] = 4 * map->amcl_map->scale * map->amcl_map->scale;
+    cov.m[2][2] = pow(2.0 * DEG2RAD, 2);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_active_map != map)
+    {
+        yCError(AMCL_DEV) << "Global localization: the map changed during the search";
+        return false;
+    }
+    pf_init_multi(m_handler_pf, (int)hyps.size(), means.data(), weights.data(), cov);
+    m_pf_initialized = false;
+    m_localization_data_mutex.lock();
+        m_pf_data.map_id = loc.map_id;
+        m_pf_data.x = loc.x - current_odom.x;
+        m_pf_data.y = loc.y - current_odom.y;
+        m_pf_data.theta = loc.theta - current_odom.theta;
+        m_pf_offset_cell.publish(m_pf_data, yarp::os::Time::now());
+        m_pf_cov = cov;
+        m_localization_data.map_id = loc.map_id;
+        m_localization_data.x = loc.x;
+        m_localization_data.y = loc.y;
+        m_localization_data.theta = loc.theta;
+        m_pose_cell.publish(m_localization_data, &m_pf_cov.m[0][0], yarp::os::Time::now());
+    m_localization_data_mutex.unlock();
+    return true;
+}
+
 void amclLocalizerThread::applyInitialPose()
 {
     if (m_initial_pose_hyp != nullptr && m_amcl_map != nullptr)
@@ -20,15 +20,26 @@
 #include <yarp/os/PeriodicThread.h>
 #include <yarp/dev/PolyDriver.h>
 #include <yarp/dev/IRangefinder2D.h>
+#include <yarp/dev/LaserScan2D.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/TypedReaderCallback.h>
 #include <yarp/dev/IMap2D.h>
 #include <yarp/dev/ReturnValue.h>
 #include <cmath>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <map>
+#include <memory>
 
 #include "./amcl/map/map.h"
 #include "./amcl/pf/pf.h"
 #include "./amcl/sensors/amcl_odom.h"
 #include "./amcl/sensors/amcl_laser.h"
+#include "amclGlobalMatcher.h"
+#include "amclParticleCloud.h"
 #include <localization_device_with_estimated_odometry.h>
+#include <pose_cell.h>
 #include "navigation_defines.h"
 
 
@@ -52,6 +63,71 @@ typedef struct
 
 } amcl_hyp_t;
 
+// Odometry pose received at a given time, used to align the laser scans
+typedef struct
+{
+    double timestamp;
+    double x;
+    double y;
+    double theta; //degrees
+    double vel_x; //odometry frame
+    double vel_y;
+    double vel_theta; //degrees/s
+} amcl_odom_sample_t;
+
+// A map kept in memory together with the data precomputed for it (distance
+// field or range table of the sensor model, global localization pyramid),
+// so that the filter can be moved to it without any recomputation.
+struct amcl_resident_map_t
+{
+    std::string                  map_id;
+    yarp::dev::Nav2D::MapGrid2D  yarp_map;
+    map_t*                       amcl_map = nullptr;
+    amclGlobalMatcher            global_matcher;
+    bool                         pinned = false;   //listed in the configuration, never evicted
+    double                       last_used = -1;
+
+    ~amcl_resident_map_t() { if (amcl_map) { map_free(amcl_map); } }
+};
+
+// A rangefinder used by the filter. Each one has its own client, its own
+// pose with respect to the robot, and feeds the filter as soon as a new scan
+// arrives: either polling the rangefinder client from its own thread, or
+// (event driven mode) from the callback of a port connected to the scan stream.
+class amclLaserSource : public yarp::os::PeriodicThread,
+                        public yarp::os::TypedReaderCallback<yarp::dev::LaserScan2D>
+{
+public:
+    size_t                                       m_index;
+    amclLocalizerThread*                         m_owner;
+    std::string                                  m_remote_port;
+    bool                                         m_event_driven = false;
+    yarp::dev::PolyDriver                        m_pLas;
+    yarp::dev::IRangefinder2D*                   m_iLaser = nullptr;
+    yarp::os::BufferedPort<yarp::dev::LaserScan2D> m_port_scan_input;
+    mutable std::mutex                           m_data_mutex; //vs getScanPoints()
+    std::vector<yarp::sig::LaserMeasurementData> m_laser_measurement_data;
+    double                                       m_laser_measurement_timestamp = -1;
+    std::vector<double>                          m_last_ranges; //of the last scan without timestamp, to tell a new scan from the same one
+    std::vector<double>                          m_ranges;
+    double                                       m_min_laser_angle = 0;
+    double                                       m_max_laser_angle = 0;
+    double                                       m_horizontal_resolution = 0;
+    double                                       m_min_laser_distance = 0;
+    double                                       m_max_laser_distance = 0;
+    pf_vector_t                                  m_laser_pose; //pose in the robot frame, radians
+
+public:
+    amclLaserSource(double _period, size_t _index, amclLocalizerThread* _owner);
+    bool open(const std::string& local, const std::string& remote, bool event_driven);
+    bool startReading();
+    void close();
+    virtual void run() override;
+    virtual void onRead(yarp::dev::LaserScan2D& scan) override;
+    //the valid points of the last scan, in the robot frame
+    void getScanPoints(std::vector<pf_vector_t>& points) const;
+};
+
 class amclLocalizerRPCHandler : public yarp::dev::DeviceResponder
 {
 protected:
@@ -95,6 +171,7 @@ public:
 };
 
 class amclLocalizerThread : public yarp::os::PeriodicThread,
+                            public yarp::os::TypedReaderCallback<yarp::dev::OdometryData>,
                             public localization_device_with_estimated_odometry
 {
 protected:
@@ -111,6 +188,20 @@ protected:
     std::string                  m_port_broadcast_odometry_name;
     yarp::os::BufferedPort<yarp::dev::OdometryData>  m_port_odometry_input;
     double                       m_last_odometry_data_received;
+    bool                         m_event_driven = false;
+
+    //recent odometry, used to compute the robot pose at the time of each scan.
+    //Fixed size ring buffer: m_odometry_history_count samples starting from m_odometry_history_first
+    std::mutex                          m_odometry_mutex;
+    std::vector<amcl_odom_sample_t>     m_odometry_history;
+    double                              m_odometry_data_timestamp = -1;
+    size_t                              m_odometry_history_max_size = 500;
+    size_t                              m_odometry_history_first = 0;
+    size_t                              m_odometry_history_count = 0;
+    //the odometry is extrapolated at most by this time [s] after the last sample
+    double                              m_prediction_max_horizon = 0.5;
+    //getCurrentPosition() returns the pose predicted at the time of the call
+    bool                                m_predict_current_pose = false;
 
 #ifdef DEBUG_DATA
     yarp::os::BufferedPort<yarp::dev::OdometryData> m_port_odometry_debug_out;
@@ -120,20 +211,18 @@ protected:
     //map interface
     yarp::dev::PolyDriver        m_pMap;
     yarp::dev::Nav2D::IMap2D*    m_iMap;
-    yarp::dev::Nav2D::MapGrid2D  m_yarp_map;
 
-    //laser client
-    yarp::dev::PolyDriver                        m_pLas;
-    yarp::dev::IRangefinder2D*                   m_iLaser;
-    std::vector<yarp::sig::LaserMeasurementData> m_laser_measurement_data;
-    double                                       m_laser_measurement_timestamp;
-    double                                       m_min_laser_angle;
-    double                                       m_max_laser_angle;
-    double                                       m_horizontal_resolution;
-    double                                       m_min_laser_distance;
-    double                                       m_max_laser_distance;
-    double                                       m_laser_angle_of_view;
-    std::string                                  m_laser_remote_port;
+    //maps ready to be used by the filter, by name. m_active_map is the one in use,
+    //m_amcl_map its occupancy grid. The maps not listed in the configuration are
+    //loaded on demand, and the least recently used are dropped beyond m_max_resident_maps.
+    std::map<std::string, std::shared_ptr<amcl_resident_map_t>> m_resident_maps;
+    std::shared_ptr<amcl_resident_map_t>                       m_active_map;
+    size_t                                                     m_max_resident_maps = 4;
+    std::mutex                                                 m_maps_mutex;
+
+    //laser clients, one for each equipped rangefinder
+    std::vector<amclLaserSource*>                m_laser_sources;
+    double                                       m_laser_read_period = 0.005;
 
     bool m_use_map_topic;
     bool m_first_map_only;
@@ -163,10 +252,26 @@ protected:
         double m_sigma_hit;
         double m_lambda_short;
         double m_laser_likelihood_max_dist;
+        int    m_laser_range_table_angles;
         double m_alpha_slow;
         double m_alpha_fast;
         double m_d_thresh;
         double m_a_thresh;
+        int    m_rng_seed;
+        int    m_global_loc_levels;
+        int    m_global_loc_max_hyps;
+        int    m_global_loc_max_points;
+        double m_global_loc_min_score;
+        double m_global_loc_angular_step;
+        bool   m_icp_refinement;
+        int    m_icp_iterations;
+        int    m_icp_max_points;
+        double m_icp_max_correction;
+        bool   m_beam_selection;
+        double m_scan_voxel_size;
+        bool   m_drop_unmapped_beams;
+        bool   m_drop_max_range_beams;
+        double m_dynamic_obstacle_dist;
     } m_config;
 
     amcl::laser_model_t m_laser_model_type;
@@ -176,6 +281,7 @@ protected:
     std::string m_global_frame_id;
     int m_resample_interval;
     int m_resample_count;
+    pf_resample_type_t m_resample_type;
     std::vector< bool > m_lasers_update;
     std::vector< amcl::AMCLLaser* > m_lasers;
 
@@ -193,29 +299,77 @@ protected:
 
     //all the estimated particles
     std::mutex m_particle_poses_mutex;
-    std::vector<yarp::dev::Nav2D::Map2DLocation> m_particle_poses;
+    amclParticleCloud m_particle_cloud;
+
+    //particle cloud stream, decimated to at most m_particles_max_count particles
+    yarp::os::BufferedPort<amclParticleCloud> m_port_particles_output;
+    std::atomic<size_t>          m_particles_max_count{ 500 };
+    std::atomic<double>          m_particles_publish_period{ 0.2 }; //s, 0 = disabled
+    double                       m_last_particles_published = -1;
+    int                          m_particles_stamp_count = 0;
 
-    //the robot most probable position
+    //the robot most probable position. The mutex only serializes the writers,
+    //the clients read the pose from m_pose_cell without waiting.
     std::mutex                          m_localization_data_mutex;
     yarp::dev::Nav2D::Map2DLocation     m_localization_data;
     yarp::dev::Nav2D::Map2DLocation     m_pf_data;
+    pf_matrix_t                         m_pf_cov;
+    pose_cell                           m_pose_cell;
+    //m_pf_data (map to odometry offset) for getPredictedLoc(), written under m_mutex
+    pose_cell                           m_pf_offset_cell;
 
     yarp::sig::Matrix    m_initial_covariance_msg;
+
+    //buffers of selectBeams(), reused at each scan (under m_mutex)
+    struct selected_beam_t
+    {
+        int    index;
+        double x;
+        double y;
+        bool   max_range;
+    };
+    std::vector<selected_beam_t>   m_beams;
+    std::vector<selected_beam_t>   m_beams_tmp;
+    std::unordered_set<uint64_t>   m_beam_voxels;
+    std::vector<std::vector<int>>  m_beam_bins;
+    std::vector<int>               m_beams_selected;
 public:
     amclLocalizerThread(double _period, std::string _name, yarp::os::Searchable& _cfg);
     virtual bool threadInit() override;
     virtual void threadRelease() override;
     virtual void run() override;
+    virtual void onRead(yarp::dev::OdometryData& odom) override;
 
 public:
     bool initializeLocalization(const yarp::dev::Nav2D::Map2DLocation& loc);
     bool initializeLocalization(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov);
     bool getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc);
+    bool getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc, yarp::sig::Matrix& cov);
+    //the pose at the given time: the latest correction of the filter plus the odometry
+    //at that time (interpolated, or extrapolated after the last sample)
+    bool getPredictedLoc(double timestamp, yarp::dev::Nav2D::Map2DLocation& loc);
+    bool predictCurrentPose() const { return m_predict_current_pose; }
     bool getPoses(std::vector<yarp::dev::Nav2D::Map2DLocation>& poses);
+    bool globalLocalization(yarp::dev::Nav2D::Map2DLocation& loc, double& score);
+    void setParticlesStream(size_t max_count, double period);
+    //makes a map resident, without changing the one used by the filter
+    bool preloadMap(const std::string& map_id);
+    std::vector<std::string> getResidentMaps();
+
+    //called by the laser threads when a new scan is available
+    void processLaserScan(const amclLaserSource& laser);
 
 private:
-    static pf_vector_t uniformPoseGenerator(void* arg);
-    map_t* convertMap(yarp::dev::Nav2D::MapGrid2D& yarp_map);
-    void updateFilter();
+    static pf_vector_t uniformPoseGenerator(void* arg, pf_rng_t* rng);
+    std::shared_ptr<amcl_resident_map_t> loadMap(const std::string& map_id, bool prepare_sensor_model);
+    std::shared_ptr<amcl_resident_map_t> getResidentMap(const std::string& map_id);
+    bool switchMap(const std::string& map_id);
+    void updateFilter(const amclLaserSource& laser, const amcl_odom_sample_t& odom);
     void applyInitialPose();
+    bool refinePose(const amclLaserSource& laser, pf_vector_t& pose);
+    void selectBeams(const amclLaserSource& laser, const amcl_odom_sample_t& odom, amcl::AMCLLaserData& ldata);
+    bool getOdometryAt(double timestamp, amcl_odom_sample_t& odom);
+    void processOdometry(const yarp::dev::OdometryData& odom, double timestamp);
+    void publishLocalization();
+    void publishParticles(double timestamp);
 };
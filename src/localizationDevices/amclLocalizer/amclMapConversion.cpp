@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "amclMapConversion.h"
+#include <yarp/os/Log.h>
+#include <cstdlib>
+
+using namespace yarp::dev::Nav2D;
+
+map_t* amclConvertMap(MapGrid2D& yarp_map)
+{
+    map_t* map = map_alloc();
+    yAssert(map);
+
+    map->size_x = yarp_map.width();
+    map->size_y = yarp_map.height();
+    yarp_map.getResolution(map->scale);
+    double x_orig;
+    double y_orig;
+    double t_orig;
+    yarp_map.getOrigin(x_orig, y_orig, t_orig);
+    map->origin_x = x_orig + (map->size_x / 2) * map->scale;
+    map->origin_y = y_orig + (map->size_y / 2) * map->scale;
+
+    map->cells = (map_cell_t*)malloc(sizeof(map_cell_t)*map->size_x*map->size_y);
+    yAssert(map->cells);
+    //for (int i = 0; i<map->size_x * map->size_y; i++)
+    for (int y = 0; y < map->size_y; y++)
+        for (int x = 0; x < map->size_x; x++)
+    {
+        int i = y * map->size_x + x;
+        double occupancy;
+        XYCell cell(x,y);
+
+        yarp_map.getOccupancyData(cell, occupancy);
+
+#if 0
+        if (occupancy == 0)
+            map->cells[i].occ_state = -1;
+        else if (occupancy == 100)
+            map->cells[i].occ_state = +1;
+        else
+            map->cells[i].occ_state = 0;
+#else
+        //@@@@check me
+        if (occupancy >= 0)
+        {
+            if (occupancy > 50)
+            {
+                map->cells[i].occ_state = +1;
+            }
+            else
+            {
+                map->cells[i].occ_state = -1;
+            }
+        }
+        else
+        {
+            map->cells[i].occ_state = 0;
+        }
+#endif
+    }
+
+    return map;
+}
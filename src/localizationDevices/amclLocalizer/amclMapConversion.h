@@ -0,0 +1,20 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef AMCL_MAP_CONVERSION_H
+#define AMCL_MAP_CONVERSION_H
+
+#include <yarp/dev/MapGrid2D.h>
+#include "./amcl/map/map.h"
+
+// Converts a yarp map into an amcl map, allocated with map_alloc() (to be released with map_free()).
+// The cells with occupancy above 50 are occupied, the other known cells are free, the unknown ones
+// are unknown. The amcl origin is the center of the map.
+map_t* amclConvertMap(yarp::dev::Nav2D::MapGrid2D& yarp_map);
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "amclParticleCloud.h"
+
+// Increased when the layout of the message changes
+static const int32_t PARTICLE_CLOUD_VERSION = 1;
+
+void amclParticleCloud::resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    theta.resize(count);
+    weight.resize(count);
+}
+
+bool amclParticleCloud::write(yarp::os::ConnectionWriter& connection) const
+{
+    connection.appendInt32(PARTICLE_CLOUD_VERSION);
+    connection.appendInt32((int32_t)map_id.size());
+    connection.appendBlock(map_id.data(), map_id.size());
+    connection.appendInt32((int32_t)x.size());
+    size_t bytes = x.size() * sizeof(float);
+    connection.appendBlock((const char*)x.data(), bytes);
+    connection.appendBlock((const char*)y.data(), bytes);
+    connection.appendBlock((const char*)theta.data(), bytes);
+    connection.appendBlock((const char*)weight.data(), bytes);
+    return !connection.isError();
+}
+
+bool amclParticleCloud::read(yarp::os::ConnectionReader& connection)
+{
+    if (connection.expectInt32() != PARTICLE_CLOUD_VERSION)
+    {
+        return false;
+    }
+    int32_t len = connection.expectInt32();
+    if (len < 0)
+    {
+        return false;
+    }
+    map_id.assign((size_t)len, '\0');
+    if (len > 0 && !connection.expectBlock(&map_id[0], (size_t)len))
+    {
+        return false;
+    }
+    int32_t count = connection.expectInt32();
+    if (count < 0)
+    {
+        return false;
+    }
+    resize((size_t)count);
+    size_t bytes = (size_t)count * sizeof(float);
+    if (count > 0)
+    {
+        if (!connection.expectBlock((char*)x.data(), bytes) ||
+            !connection.expectBlock((char*)y.data(), bytes) ||
+            !connection.expectBlock((char*)theta.data(), bytes) ||
+            !connection.expectBlock((char*)weight.data(), bytes))
+        {
+            return false;
+        }
+    }
+    return !connection.isError();
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef AMCL_PARTICLE_CLOUD_H
+#define AMCL_PARTICLE_CLOUD_H
+
+#include <yarp/os/Portable.h>
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/ConnectionWriter.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The particles of the filter, streamed as a compact binary message:
+// the map name, the particle count and then four float arrays
+// (x [m], y [m], theta [rad], weight), without any per particle overhead.
+class amclParticleCloud : public yarp::os::Portable
+{
+public:
+    std::string         map_id;
+    std::vector<float>  x;
+    std::vector<float>  y;
+    std::vector<float>  theta;
+    std::vector<float>  weight;
+
+    size_t size() const { return x.size(); }
+    void   resize(size_t count);
+
+    bool read(yarp::os::ConnectionReader& connection) override;
+    bool write(yarp::os::ConnectionWriter& connection) const override;
+};
+
+#endif
@@ -141,14 +141,20 @@ void gazeboLocalizerThread::run()
     }
 
     //@@@@COMPUTE LOCALIZATION DATA here
+    compute_localization_data();
+
+    estimateOdometry(m_localization_data);
+    m_pose_cell.publish(m_localization_data, current_time);
+}
+
+void gazeboLocalizerThread::compute_localization_data()
+{
     double angle_rad = m_map_to_gazebo_transform.theta;
     m_localization_data.x     = m_map_to_gazebo_transform.x + cos (angle_rad) * m_gazebo_data.x - sin (angle_rad) * m_gazebo_data.y;
     m_localization_data.y     = m_map_to_gazebo_transform.y + sin (angle_rad) * m_gazebo_data.x + cos (angle_rad) * m_gazebo_data.y;
     m_localization_data.theta = m_gazebo_data.theta*RAD2DEG + m_map_to_gazebo_transform.theta;
     if      (m_localization_data.theta >= +360) m_localization_data.theta -= 360;
     else if (m_localization_data.theta <= -360) m_localization_data.theta += 360;
-
-    estimateOdometry(m_localization_data);
 }
 
 bool gazeboLocalizerThread::initializeLocalization(const Map2DLocation& loc)
@@ -162,11 +168,19 @@ bool gazeboLocalizerThread::initializeLocalization(const Map2DLocation& loc)
     m_map_to_gazebo_transform.y = loc.y;
     m_map_to_gazebo_transform.theta = loc.theta;
 
+    //the clients see the new pose without waiting for the next run()
+    compute_localization_data();
+    m_pose_cell.publish(m_localization_data, yarp::os::Time::now());
+
     return true;
 }
 
 bool gazeboLocalizerThread::getCurrentLoc(Map2DLocation& loc)
 {
+    if (m_pose_cell.read(loc))
+    {
+        return true;
+    }
     lock_guard<std::mutex> lock(m_mutex);
     loc = m_localization_data;
     return true;
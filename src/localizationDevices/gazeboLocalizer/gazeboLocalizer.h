@@ -34,6 +34,7 @@
 #include <mutex>
 #include <yarp/dev/IMap2D.h>
 #include <localization_device_with_estimated_odometry.h>
+#include <pose_cell.h>
 
 #ifndef GAZEBO_LOCALIZER_H
 #define GAZEBO_LOCALIZER_H
@@ -94,6 +95,7 @@ protected:
     yarp::dev::Nav2D::Map2DLocation     m_localization_data;
     yarp::dev::Nav2D::Map2DLocation     m_gazebo_data;
     std::mutex                   m_mutex;
+    pose_cell                    m_pose_cell; //m_localization_data, for the clients
     yarp::os::Searchable&        m_cfg;
     std::string                  m_local_gazebo_port_name;
     std::string                  m_remote_gazebo_port_name;
@@ -104,6 +106,8 @@ protected:
 
 private:
     bool open_gazebo();
+    //m_localization_data from m_gazebo_data and m_map_to_gazebo_transform, with m_mutex locked
+    void compute_localization_data();
 
 public:
     gazeboLocalizerThread(double _period, std::string _name, yarp::os::Searchable& _cfg);
@@ -161,6 +161,10 @@ void odomLocalizerThread::run()
 
         if      (m_current_loc.theta >= +360) m_current_loc.theta -= 360;
         else if (m_current_loc.theta <= -360) m_current_loc.theta += 360;
+
+        yarp::os::Stamp stamp;
+        m_port_odometry_input.getEnvelope(stamp);
+        m_pose_cell.publish(m_current_loc, stamp.isValid() ? stamp.getTime() : m_last_port_odometryData_time);
     }
     if (current_time - m_last_port_odometryData_time > 0.1)
     {
@@ -189,11 +193,16 @@ bool odomLocalizerThread::initializeLocalization(const Map2DLocation& loc)
         m_current_loc.y = 0+m_initial_loc.y;
         m_current_loc.theta = 0+m_initial_loc.theta;
     }
+    m_pose_cell.publish(m_current_loc, yarp::os::Time::now());
     return true;
 }
 
 bool odomLocalizerThread::getCurrentLoc(Map2DLocation& loc)
 {
+    if (m_pose_cell.read(loc))
+    {
+        return true;
+    }
     lock_guard<std::mutex> lock(m_mutex);
     loc = m_current_loc;
     return true;
@@ -33,6 +33,7 @@
 #include <mutex>
 #include <math.h>
 #include <localization_device_with_estimated_odometry.h>
+#include <pose_cell.h>
 
 using namespace yarp::os;
 
@@ -106,6 +107,7 @@ protected:
     yarp::dev::Nav2D::Map2DLocation     m_current_loc;
     yarp::dev::Nav2D::Map2DLocation     m_current_odom;
     std::mutex                   m_mutex;
+    pose_cell                    m_pose_cell; //m_current_loc, for the clients
     yarp::os::Searchable&        m_cfg;
     std::string                  m_name;
 
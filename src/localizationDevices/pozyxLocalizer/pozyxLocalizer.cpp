@@ -126,6 +126,12 @@ void pozyxLocalizerThread::run()
     m_pozyx_data.theta=0;
 
     //@@@@COMPUTE LOCALIZATION DATA here
+    compute_localization_data();
+    m_pose_cell.publish(m_localization_data, current_time);
+}
+
+void pozyxLocalizerThread::compute_localization_data()
+{
     double angle = m_map_to_pozyx_transform.theta * DEG2RAD;
     m_localization_data.x     = m_map_to_pozyx_transform.x + cos (angle) * m_pozyx_data.x - sin (angle) * m_pozyx_data.y;
     m_localization_data.y     = m_map_to_pozyx_transform.y + sin (angle) * m_pozyx_data.x + cos (angle) * m_pozyx_data.y;
@@ -145,6 +151,10 @@ bool pozyxLocalizerThread::initializeLocalization(const Map2DLocation& loc)
     m_map_to_pozyx_transform.y = loc.y;
     m_map_to_pozyx_transform.theta = loc.theta;
 
+    //the clients see the new pose without waiting for the next run()
+    compute_localization_data();
+    m_pose_cell.publish(m_localization_data, yarp::os::Time::now());
+
     if (get_anchors_location())
     {
         double angle = m_map_to_pozyx_transform.theta * DEG2RAD;
@@ -174,6 +184,10 @@ bool pozyxLocalizerThread::initializeLocalization(const Map2DLocation& loc)
 
 bool pozyxLocalizerThread::getCurrentLoc(Map2DLocation& loc)
 {
+    if (m_pose_cell.read(loc))
+    {
+        return true;
+    }
     lock_guard<std::mutex> lock(m_mutex);
     loc = m_localization_data;
     return true;
@@ -20,6 +20,7 @@
 #include <math.h>
 #include <yarp/dev/IMap2D.h>
 #include <localization_device_with_estimated_odometry.h>
+#include <pose_cell.h>
 #include "navigation_defines.h"
 
 #ifndef POZYX_LOCALIZER_H
@@ -82,6 +83,7 @@ protected:
     yarp::dev::Nav2D::Map2DLocation     m_pozyx_data;
     std::vector<yarp::dev::Nav2D::Map2DLocation> m_anchors_pos;
     std::mutex                   m_mutex;
+    pose_cell                    m_pose_cell; //m_localization_data, for the clients
     yarp::os::Searchable&        m_cfg;
 
     //publish anchors onto map as locations
@@ -95,6 +97,8 @@ private:
     bool publish_anchors_location();
     bool get_anchors_location();
     bool open_pozyx();
+    //m_localization_data from m_pozyx_data and m_map_to_pozyx_transform, with m_mutex locked
+    void compute_localization_data();
 
 public:
     pozyxLocalizerThread(double _period, std::string _name, yarp::os::Searchable& _cfg);
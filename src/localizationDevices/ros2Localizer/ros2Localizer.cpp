@@ -607,6 +607,7 @@ void ros2LocalizerThread::run()
 
             //velocity estimation block
             if (1) { estimateOdometry(m_localization_data); }
+            m_pose_cell.publish(m_localization_data, m_tf_data_received);
 
         }
     }
@@ -669,6 +670,11 @@ bool ros2LocalizerThread::initializeLocalization(const yarp::dev::Nav2D::Map2DLo
 
 bool ros2LocalizerThread::getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc)
 {
+    if (m_pose_cell.read(loc))
+    {
+        return true;
+    }
+    lock_guard<std::mutex> lock(m_mutex);
     loc = m_localization_data;
     return true;
 }
@@ -728,6 +734,7 @@ void ros2LocalizerThread::currPose_callback(const geometry_msgs::msg::PoseWithCo
             return;
         }
 
+        lock_guard<std::mutex> lock(m_mutex);
         m_tf_data_received = yarp::os::Time::now();
         m_localization_data.x = inputPose.pose.pose.position.x;
         m_localization_data.y = inputPose.pose.pose.position.y;
@@ -742,6 +749,14 @@ void ros2LocalizerThread::currPose_callback(const geometry_msgs::msg::PoseWithCo
 
         //velocity estimation block
         if (1) { estimateOdometry(m_localization_data); }
+
+        //x, y and yaw of the 6x6 ROS covariance
+        const size_t ros_idx[3] = { 0, 1, 5 };
+        double cov[9];
+        for (size_t r = 0; r < 3; r++)
+            for (size_t c = 0; c < 3; c++)
+                cov[r * 3 + c] = inputPose.pose.covariance[ros_idx[r] * 6 + ros_idx[c]];
+        m_pose_cell.publish(m_localization_data, cov, m_tf_data_received);
     }
 }
 
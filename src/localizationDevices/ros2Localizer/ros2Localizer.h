@@ -39,6 +39,7 @@
 #include <geometry_msgs/msg/pose_array.hpp>
 #include <yarp/math/Math.h>
 #include <localization_device_with_estimated_odometry.h>
+#include <pose_cell.h>
 #include "Ros2Spinner.h"
 #include "Ros2Utils.h"
 #include "navigation_defines.h"
@@ -132,6 +133,7 @@ protected:
     yarp::dev::Nav2D::MapGrid2D      m_current_map;
     yarp::dev::Nav2D::Map2DLocation  m_localization_data;
     std::mutex                       m_mutex;
+    pose_cell                        m_pose_cell; //m_localization_data, for the clients
     yarp::os::Searchable&            m_cfg;
 
 
@@ -21,6 +21,7 @@
 #include <yarp/rosmsg/geometry_msgs/PoseStamped.h>
 #include <yarp/rosmsg/geometry_msgs/PoseWithCovarianceStamped.h>
 #include <yarp/rosmsg/nav_msgs/OccupancyGrid.h>
+#include <yarp/math/Quaternion.h>
 #include <math.h>
 #include <mutex>
 #include "rosLocalizer.h"
@@ -197,6 +198,7 @@ void rosLocalizerThread::run()
 
             //velocity estimation block
             if (1) { estimateOdometry(m_localization_data); }
+            m_pose_cell.publish(m_localization_data, m_tf_data_received);
         }
     }
     else if (m_loc_mode == use_ros_loc)
@@ -218,6 +220,14 @@ void rosLocalizerThread::run()
 
             //velocity estimation block
             if (1) { estimateOdometry(m_localization_data); }
+
+            //x, y and yaw of the 6x6 ROS covariance
+            const size_t ros_idx[3] = { 0, 1, 5 };
+            double cov[9];
+            for (size_t r = 0; r < 3; r++)
+                for (size_t c = 0; c < 3; c++)
+                    cov[r * 3 + c] = rospose->pose.covariance[ros_idx[r] * 6 + ros_idx[c]];
+            m_pose_cell.publish(m_localization_data, cov, m_tf_data_received);
         }
     }
     else
@@ -294,6 +304,11 @@ bool rosLocalizerThread::initializeLocalization(const yarp::dev::Nav2D::Map2DLoc
 
 bool rosLocalizerThread::getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc)
 {
+    if (m_pose_cell.read(loc))
+    {
+        return true;
+    }
+    lock_guard<std::mutex> lock(m_mutex);
     loc = m_localization_data;
     return true;
 }
@@ -28,6 +28,7 @@
 #include <math.h>
 
 #include <localization_device_with_estimated_odometry.h>
+#include <pose_cell.h>
 #include "navigation_defines.h"
 
 using namespace yarp::os;
@@ -116,6 +117,7 @@ protected:
     yarp::dev::Nav2D::MapGrid2D         m_current_map;
     yarp::dev::Nav2D::Map2DLocation     m_localization_data;
     std::mutex                   m_mutex;
+    pose_cell                    m_pose_cell; //m_localization_data, for the clients
     yarp::os::Searchable&        m_cfg;
 
     //configuration options
@@ -253,6 +253,7 @@ void t265LocalizerThread::run()
 
     //velocity estimation block
     if (1) {estimateOdometry(m_current_loc);}
+    m_pose_cell.publish(m_current_loc, current_time);
 }
 
 bool t265LocalizerThread::initializeLocalization(const Map2DLocation& loc)
@@ -270,17 +271,20 @@ bool t265LocalizerThread::initializeLocalization(const Map2DLocation& loc)
     if (m_current_loc.map_id != m_initial_loc.map_id)
     {
         yCInfo(T265_LOC) << "Map changed from: " << m_current_loc.map_id << " to: " << m_initial_loc.map_id;
-        m_current_loc.map_id = m_initial_loc.map_id;
-        //@@@TO BE COMPLETED
-        m_current_loc.x = 0 + m_initial_loc.x;
-        m_current_loc.y = 0 + m_initial_loc.y;
-        m_current_loc.theta = 0 + m_initial_loc.theta;
     }
+    //the device has not moved from m_initial_device_data yet: the pose is the requested one.
+    //The clients see it without waiting for the next run()
+    m_current_loc = m_initial_loc;
+    m_pose_cell.publish(m_current_loc, yarp::os::Time::now());
     return true;
 }
 
 bool t265LocalizerThread::getCurrentLoc(Map2DLocation& loc)
 {
+    if (m_pose_cell.read(loc))
+    {
+        return true;
+    }
     lock_guard<std::mutex> lock(m_mutex);
     loc = m_current_loc;
     return true;
@@ -22,6 +22,7 @@
 #include <movable_localization_device.h>
 #include <iCub/ctrl/adaptWinPolyEstimator.h>
 #include <localization_device_with_estimated_odometry.h>
+#include <pose_cell.h>
 
 #include <yarp/dev/IFrameTransform.h>
 #include "navigation_defines.h"
@@ -101,6 +102,7 @@ protected:
     double                       m_last_statistics_printed;
     yarp::dev::Nav2D::Map2DLocation     m_map_to_device_transform;
     std::mutex                   m_mutex;
+    pose_cell                    m_pose_cell; //m_current_loc, for the clients
     yarp::os::Searchable&        m_cfg;
 
     yarp::dev::Nav2D::Map2DLocation     m_initial_loc;
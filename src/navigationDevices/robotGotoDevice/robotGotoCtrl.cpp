@@ -190,6 +190,14 @@ bool GotoThread::threadInit()
         yCError(GOTO_CTRL) << "Unable to open module ports";
         return false;
     }
+    if (general_group.check("shm_output"))
+    {
+        if (m_shm_commands_output.open(general_group.find("shm_output").asString()) == false)
+        {
+            yCError(GOTO_CTRL) << "Unable to open the shared memory output";
+            return false;
+        }
+    }
 
     //open the localization client and the corresponding interface
     Property loc_options;
@@ -278,6 +286,7 @@ void GotoThread::threadRelease()
     
     m_port_commands_output.interrupt();
     m_port_commands_output.close();
+    m_shm_commands_output.close();
     
     m_port_status_output.interrupt();
     m_port_status_output.close();
@@ -650,6 +659,27 @@ void GotoThread::sendOutput()
         b.addFloat64(100);
         m_port_commands_output.write();
     }
+    if (m_shm_commands_output.isOpen())
+    {
+        bool ok = true;
+        if (m_status == navigation_status_moving)
+        {
+            ok = m_shm_commands_output.write(m_control_out.linear_vel * cos(m_control_out.linear_dir * DEG2RAD),
+                                             m_control_out.linear_vel * sin(m_control_out.linear_dir * DEG2RAD),
+                                             m_control_out.angular_vel);
+            m_shm_stopped = false;
+        }
+        else if (m_shm_stopped == false)
+        {
+            //stop the robot at once, instead of waiting for the timeout of the last command
+            m_shm_stopped = m_shm_commands_output.write(0, 0, 0);
+            ok = m_shm_stopped;
+        }
+        if (ok == false)
+        {
+            yCWarningThrottle(GOTO_CTRL, 1.0) << "Unable to write to the shared memory output" << m_shm_commands_output.name();
+        }
+    }
 
     if (m_port_status_output.getOutputCount()>0)
     {
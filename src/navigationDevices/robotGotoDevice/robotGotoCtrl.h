@@ -28,6 +28,7 @@
 #include <math.h>
 #include <mutex>
 #include "obstacles.h"
+#include <velocity_shm.h>
 
 using namespace std;
 using namespace yarp::os;
@@ -119,6 +120,8 @@ protected:
     BufferedPort<yarp::os::Bottle>  m_port_status_output;
     BufferedPort<yarp::os::Bottle>  m_port_speak_output;
     BufferedPort<yarp::os::Bottle>  m_port_gui_output;
+    velocity_shm                    m_shm_commands_output;   //optional, read by a baseControl2 on the same machine
+    bool                            m_shm_stopped = true;    //a zero command has been written to m_shm_commands_output
 
     Property                           m_robotCtrl_options;
     Searchable                         &m_cfg;
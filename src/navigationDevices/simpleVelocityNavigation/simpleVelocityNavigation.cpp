@@ -42,10 +42,16 @@ simpleVelocityNavigation::simpleVelocityNavigation() : PeriodicThread(DEFAULT_TH
 {
     m_localName = "simpleVelocityNavigation";
     m_send_zero_when_expired = false;
+    m_refresh_period = 0.05;
+    m_last_send_time = -1;
 }
 
 bool simpleVelocityNavigation::open(yarp::os::Searchable& config)
 {
+    //the command is sent when it changes. Meanwhile it is sent again every refresh_period seconds
+    //(0 = never), only to feed the watchdog of the receivers and to recover lost udp messages
+    m_refresh_period = config.check("refresh_period", yarp::os::Value(0.05)).asFloat64();
+
     bool ret = true;
     ret &= m_port_commands_output.open((std::string("/")+m_localName + "/control:o").c_str());
 
@@ -83,68 +89,73 @@ void simpleVelocityNavigation::threadRelease()
 
 void simpleVelocityNavigation::run()
 {
-
     double current_time = yarp::os::Time::now();
 
     if (m_port_commands_output.getOutputCount() > 0)
     {
-        if (m_control_out.timeout == std::numeric_limits<double>::infinity())
-        {
-            send_command(m_control_out);
-            //m_navigation_status = navigation_status_moving;
-        }
-        else
+        deadline_command_data cmd;
+        switch (m_command_reader.poll(m_command, current_time, cmd))
         {
-            if ((current_time - m_control_out.reception_time) < m_control_out.timeout)
-            {
-                send_command(m_control_out);
+            case DEADLINE_CHANGED:
+                send_command(cmd);
                 //m_navigation_status = navigation_status_moving;
-            }
-            else
-            {
+            break;
+            case DEADLINE_UNCHANGED:
+                if (m_refresh_period > 0 && current_time - m_last_send_time >= m_refresh_period)
+                {
+                    send_command(cmd);
+                }
+            break;
+            case DEADLINE_EXPIRED:
                 //control timeout expired
                 if (m_send_zero_when_expired)
                 {
                     //send a zero command
-                    send_command(control_type());
-                }
-                else
-                {
-                    //do not send anything
+                    send_command(deadline_command_data());
                 }
                 //m_navigation_status = navigation_status_idle;
-            }
+            break;
+            default:
+                //nothing received yet, or already expired: do not send anything
+            break;
         }
     }
 }
 
-void simpleVelocityNavigation::send_command(control_type control_data)
+void simpleVelocityNavigation::send_command(const deadline_command_data& control_data)
 {
     static yarp::os::Stamp stamp;
     stamp.update();
+    m_last_send_time = stamp.getTime();
     Bottle &b = m_port_commands_output.prepare();
     m_port_commands_output.setEnvelope(stamp);
     b.clear();
     b.addInt32(BASECONTROL_COMMAND_VELOCIY_CARTESIAN);
-    b.addFloat64(control_data.linear_xvel);    // lin_vel in m/s
-    b.addFloat64(control_data.linear_yvel);    // lin_vel in m/s
-    b.addFloat64(control_data.angular_vel);    // ang_vel in deg/s
+    b.addFloat64(control_data.x_vel);        // lin_vel in m/s
+    b.addFloat64(control_data.y_vel);        // lin_vel in m/s
+    b.addFloat64(control_data.theta_vel);    // ang_vel in deg/s
     b.addFloat64(100);
     m_port_commands_output.write();
 }
 
 ReturnValue simpleVelocityNavigation::applyVelocityCommand(double x_vel, double y_vel, double theta_vel, double timeout)
 {
-    m_control_out.linear_xvel = x_vel;
-    m_control_out.linear_yvel = y_vel;
-    m_control_out.angular_vel = theta_vel;
-    m_control_out.timeout = timeout;
-    m_control_out.reception_time = yarp::os::Time::now();
+    if (m_command.post(x_vel, y_vel, theta_vel, timeout, yarp::os::Time::now()) == false)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
     return ReturnValue_ok;
 }
 
 ReturnValue simpleVelocityNavigation::getLastVelocityCommand(double& x_vel, double& y_vel, double& theta_vel)
 {
-    yCError(SIMPLE_VEL_NAV) << "getLastVelocityCommand() not yet implemented";
-    return ReturnValue::return_code::return_value_error_not_implemented_by_device;
+    deadline_command_data cmd;
+    if (m_command.read(cmd) == false)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
+    x_vel = cmd.x_vel;
+    y_vel = cmd.y_vel;
+    theta_vel = cmd.theta_vel;
+    return ReturnValue_ok;
 }
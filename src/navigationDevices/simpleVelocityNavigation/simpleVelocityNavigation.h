@@ -26,6 +26,7 @@
 #include <yarp/dev/INavigation2D.h>
 #include <yarp/dev/ILocalization2D.h>
 #include <math.h>
+#include <deadline_command.h>
 
 #ifndef NAV_DEVICE_TEMPLATE_H
 #define NAV_DEVICE_TEMPLATE_H
@@ -40,26 +41,18 @@ protected:
     std::string                                 m_localName;
     yarp::os::BufferedPort<yarp::os::Bottle>    m_port_commands_output;
     bool                                        m_send_zero_when_expired;
-    //internal type definition to store control output
-    struct control_type
-    {
-        double linear_xvel;
-        double linear_yvel;
-        double angular_vel;
-        double timeout;
-        double reception_time;
-        control_type()
-        {
-            linear_xvel = 0; linear_yvel = 0; angular_vel = 0; timeout = 0; reception_time = 0;
-        }
-    }
-    m_control_out;
+    double                                      m_refresh_period;
+    double                                      m_last_send_time;
+
+    //the latest command received by applyVelocityCommand(), with its expiry time
+    deadline_command                            m_command;
+    deadline_command_reader                     m_command_reader;
 
 public:
     simpleVelocityNavigation();
 
 private:
-    void send_command(control_type control_data);
+    void send_command(const deadline_command_data& control_data);
 
 public:
     virtual bool open(yarp::os::Searchable& config) override;
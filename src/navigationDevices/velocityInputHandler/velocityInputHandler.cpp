@@ -40,31 +40,30 @@ bool VelocityInputHandler::close()
 
 ReturnValue VelocityInputHandler::applyVelocityCommand(double x_vel, double y_vel, double theta_vel, double timeout)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_control_out.linear_xvel = x_vel;
-    m_control_out.linear_yvel = y_vel;
-    m_control_out.angular_vel = theta_vel;
-    m_control_out.timeout = timeout;
-    m_control_out.reception_time = yarp::os::Time::now();
-    timeout_printable = true;
+    //the command is valid for max_timeout seconds, regardless the timeout given by the sender
+    if (m_command.post(x_vel, y_vel, theta_vel, m_max_timeout, yarp::os::Time::now()) == false)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
     return ReturnValue_ok;
 }
 
 ReturnValue VelocityInputHandler::getLastVelocityCommand(double& x_vel, double& y_vel, double& theta_vel)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
     double current_time = yarp::os::Time::now();
-    if (current_time - m_control_out.reception_time > m_max_timeout)
+    deadline_command_data cmd;
+    deadline_event_enum event = m_command_reader.poll(m_command, current_time, cmd);
+    if (event == DEADLINE_EMPTY || event == DEADLINE_STALE)
+    {
+        return ReturnValue::return_code::return_value_error_method_failed;
+    }
+    if (event == DEADLINE_EXPIRED)
     {
-        if (timeout_printable)
-        {
-            yCWarning(VEL_INPUT_HANDLER) << "[" << m_localName << "] timeout:" << current_time-m_control_out.reception_time;
-            timeout_printable = false;
-        }
+        yCWarning(VEL_INPUT_HANDLER) << "[" << m_localName << "] timeout:" << current_time-cmd.timestamp;
         return ReturnValue::return_code::return_value_error_method_failed;
     }
-    x_vel = m_control_out.linear_xvel;
-    y_vel = m_control_out.linear_yvel;
-    theta_vel = m_control_out.angular_vel;
+    x_vel = cmd.x_vel;
+    y_vel = cmd.y_vel;
+    theta_vel = cmd.theta_vel;
     return ReturnValue_ok;
 }
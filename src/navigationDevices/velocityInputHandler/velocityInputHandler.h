@@ -5,6 +5,7 @@
 
 #include <yarp/dev/PolyDriver.h>
 #include <yarp/dev/INavigation2D.h>
+#include <deadline_command.h>
 
 #ifndef NAV_VEL_INPUT_HANDLER_H
 #define NAV_VEL_INPUT_HANDLER_H
@@ -14,20 +15,11 @@ class VelocityInputHandler :     public yarp::dev::Nav2D::INavigation2DVelocityA
 {
 protected:
     std::string                                 m_localName;
-    std::mutex                                  m_mutex;
-
-    //internal type definition to store control output
-    struct control_type
-    {
-        double linear_xvel = 0;
-        double linear_yvel = 0;
-        double angular_vel = 0;
-        double timeout = 0;
-        double reception_time =0;
-    }
-    m_control_out;
+
+    //the latest command, which expires max_timeout seconds after its reception
+    deadline_command                            m_command;
+    deadline_command_reader                     m_command_reader;
     double   m_max_timeout = 0.1;
-    bool     timeout_printable = false;
 
 public:
     VelocityInputHandler();
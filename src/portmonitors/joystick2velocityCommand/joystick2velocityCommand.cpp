@@ -12,14 +12,18 @@
 #include <yarp/os/LogStream.h>
 #include <yarp/os/Value.h>
 #include <yarp/os/Bottle.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
 #include <cmath>
 #define _USE_MATH_DEFINES
 //example
 //yarp connect /joystickCtrl:o /baseControl /input /joystick:i tcp+recv.portmonitor+type.dll+file.joy2vel
+//optional parameters (see getparam()), appended to the carrier:
+//yarp connect /joystickCtrl:o /baseControl/input/joystick:i tcp+recv.portmonitor+type.dll+file.joy2vel+deadzone.0.05+expo.0.4+max_lin_acc.0.5+max_ang_acc.60
 
 YARP_LOG_COMPONENT(JOY2VEL, "navigation.Joy2Vel")
 
-bool isNumeric(yarp::os::Value& val)
+bool isNumeric(const yarp::os::Value& val)
 {
     if (val.isFloat32() ||
         val.isFloat64() ||
@@ -36,6 +40,64 @@ Joy2vel::Joy2vel()
     this->m_things.setPortWriter(&this->m_command);
 }
 
+bool Joy2vel::create(const yarp::os::Property& options)
+{
+    //the parameters can be given in the carrier string, e.g. ...+file.joy2vel+deadzone.0.1+expo.0.3
+    std::string carrier = options.find("carrier").asString();
+    yarp::os::Property params;
+    size_t start = 0;
+    while (start < carrier.size())
+    {
+        size_t end = carrier.find('+', start);
+        if (end == std::string::npos) { end = carrier.size(); }
+        std::string item = carrier.substr(start, end - start);
+        size_t dot = item.find('.');
+        if (dot != std::string::npos)
+        {
+            params.put(item.substr(0, dot), yarp::os::Value::makeValue(item.substr(dot + 1)));
+        }
+        start = end + 1;
+    }
+    return setparam(params);
+}
+
+bool Joy2vel::setparam(const yarp::os::Property& params)
+{
+    double max_lin_vel = params.check("max_lin_vel", yarp::os::Value(m_max_lin_vel)).asFloat64();
+    double max_ang_vel = params.check("max_ang_vel", yarp::os::Value(m_max_ang_vel)).asFloat64();
+    double deadzone = params.check("deadzone", yarp::os::Value(m_deadzone)).asFloat64();
+    double expo = params.check("expo", yarp::os::Value(m_expo)).asFloat64();
+    double max_lin_acc = params.check("max_lin_acc", yarp::os::Value(m_max_lin_acc)).asFloat64();
+    double max_ang_acc = params.check("max_ang_acc", yarp::os::Value(m_max_ang_acc)).asFloat64();
+
+    if (max_lin_vel <= 0 || max_ang_vel <= 0 ||
+        deadzone < 0 || deadzone >= 1 ||
+        expo < 0 || expo > 1 ||
+        max_lin_acc < 0 || max_ang_acc < 0)
+    {
+        yCError(JOY2VEL, "Invalid parameters: max_lin_vel, max_ang_vel >0; 0<= deadzone <1; 0<= expo <=1; max_lin_acc, max_ang_acc >=0");
+        return false;
+    }
+    m_max_lin_vel = max_lin_vel;
+    m_max_ang_vel = max_ang_vel;
+    m_deadzone = deadzone;
+    m_expo = expo;
+    m_max_lin_acc = max_lin_acc;
+    m_max_ang_acc = max_ang_acc;
+    return true;
+}
+
+bool Joy2vel::getparam(yarp::os::Property& params)
+{
+    params.put("max_lin_vel", m_max_lin_vel);
+    params.put("max_ang_vel", m_max_ang_vel);
+    params.put("deadzone", m_deadzone);
+    params.put("expo", m_expo);
+    params.put("max_lin_acc", m_max_lin_acc);
+    params.put("max_ang_acc", m_max_ang_acc);
+    return true;
+}
+
 bool Joy2vel::accept(yarp::os::Things& thing)
 {
     yarp::os::Bottle *bot = thing.cast_as<yarp::os::Bottle>();
@@ -44,64 +106,127 @@ bool Joy2vel::accept(yarp::os::Things& thing)
         return false;
     }
 
-    return validate_bot(bot);
+    return parse_bot(bot);
 }
 
-bool Joy2vel::validate_bot(const yarp::os::Bottle* bot)
+bool Joy2vel::parse_bot(const yarp::os::Bottle* bot)
 {
-    if (!bot)
-    {
-        yCError(JOY2VEL, "Invalid bottle format: empty bottle");
-        return false;
-    }
-
     if (bot->size() < 5)
     {
         yCError(JOY2VEL, "Invalid bottle format: Size <5 or invalid data type");
         return false;
     }
 
-    if ( isNumeric(bot->get(0))  == false ||
-         bot->get(1).isFloat64() == false ||
-         bot->get(2).isFloat64() == false ||
-         bot->get(3).isFloat64() == false ||
-         bot->get(4).isFloat64() == false )
+    //the values are checked and read in a single pass
+    if (isNumeric(bot->get(0)) == false)
     {
         yCError(JOY2VEL, "Invalid bottle format: invalid data type");
         return false;
     }
+    int type = bot->get(0).asInt32();
+    double v[4];
+    for (size_t i = 0; i < 4; i++)
+    {
+        const yarp::os::Value& val = bot->get(i + 1);
+        if (val.isFloat64() == false)
+        {
+            yCError(JOY2VEL, "Invalid bottle format: invalid data type");
+            return false;
+        }
+        v[i] = val.asFloat64();
+    }
 
     //when the joystick button is not pressed, filter out the message.
     //This will eventually trigger a timeout on the receiver and
     //the control will be give to a different input source
-    double percent = bot->get(4).asFloat64();
+    double percent = v[3];
     if (percent < 10) {return false;}
+    percent = percent / 100.0;
 
+    if (type == 3)
+    {
+        m_vel_x = v[0] * percent;
+        m_vel_y = v[1] * percent;
+        m_vel_theta = v[2] * percent;
+    }
+    else if (type == 2)
+    {
+        m_vel_x = v[1] * percent * cos(v[0] / 180 * M_PI);
+        m_vel_y = v[1] * percent * sin(v[0] / 180 * M_PI);
+        m_vel_theta = v[2] * percent;
+    }
+    else
+    {
+        yCError(JOY2VEL, "Unsupported bottle format: Type!=2,3");
+        return false;
+    }
     return true;
 }
 
-yarp::os::Things& Joy2vel::update(yarp::os::Things& thing)
+double Joy2vel::shape(double value, double full_scale) const
 {
-    yarp::os::Bottle *bot = thing.cast_as<yarp::os::Bottle>();
-    yAssert(bot);
-    validate_bot(bot);
+    double u = fabs(value) / full_scale;
+    if (u <= m_deadzone) { return 0; }
+    u = (u - m_deadzone) / (1 - m_deadzone);
+    //beyond the full scale the curve goes on linearly
+    if (u < 1) { u = (1 - m_expo) * u + m_expo * u * u * u; }
+    return (value < 0 ? -u : u) * full_scale;
+}
 
-    if (bot->get(0).asInt32()==3)
+void Joy2vel::apply_rate_limit()
+{
+    double now = yarp::os::Time::now();
+    double dt = now - m_last_time;
+    if (m_last_time < 0 || dt > 0.5)
     {
-        double percent = bot->get(4).asFloat64()/100.0;
-        this->m_command.vel_x = bot->get(1).asFloat64() * percent;
-        this->m_command.vel_y = bot->get(2).asFloat64() * percent;
-        this->m_command.vel_theta = bot->get(3).asFloat64() * percent;
-    } else if (bot->get(0).asInt32()==2)
+        //the messages have been interrupted (button released): the receiver has already stopped the robot
+        m_command.vel_x = 0;
+        m_command.vel_y = 0;
+        m_command.vel_theta = 0;
+    }
+    m_last_time = now;
+    if (dt > 0.1 || dt < 0) { dt = 0.1; }
+
+    if (m_max_lin_acc > 0)
+    {
+        double dx = m_vel_x - m_command.vel_x;
+        double dy = m_vel_y - m_command.vel_y;
+        double dv = sqrt(dx * dx + dy * dy);
+        double dv_max = m_max_lin_acc * dt;
+        if (dv > dv_max)
+        {
+            m_vel_x = m_command.vel_x + dx / dv * dv_max;
+            m_vel_y = m_command.vel_y + dy / dv * dv_max;
+        }
+    }
+    if (m_max_ang_acc > 0)
     {
-        double percent = bot->get(4).asFloat64()/100.0;
-        this->m_command.vel_x = bot->get(2).asFloat64() * percent  *  cos(bot->get(1).asFloat64()/ 180 * M_PI)  ;
-        this->m_command.vel_y = bot->get(2).asFloat64() * percent * sin(bot->get(1).asFloat64() / 180 * M_PI);
-        this->m_command.vel_theta = bot->get(3).asFloat64() * percent;
-    } else
+        double dt_max = m_max_ang_acc * dt;
+        double dtheta = m_vel_theta - m_command.vel_theta;
+        if (dtheta > dt_max)  { m_vel_theta = m_command.vel_theta + dt_max; }
+        if (dtheta < -dt_max) { m_vel_theta = m_command.vel_theta - dt_max; }
+    }
+}
+
+yarp::os::Things& Joy2vel::update(yarp::os::Things& thing)
+{
+    //the bottle has been already parsed by accept()
+    if (m_deadzone > 0 || m_expo > 0)
     {
-        yCError(JOY2VEL, "Unsupported bottle format: Type!=3");
+        //the linear velocity is shaped along its direction
+        double lin = sqrt(m_vel_x * m_vel_x + m_vel_y * m_vel_y);
+        if (lin > 0)
+        {
+            double k = shape(lin, m_max_lin_vel) / lin;
+            m_vel_x *= k;
+            m_vel_y *= k;
+        }
+        m_vel_theta = shape(m_vel_theta, m_max_ang_vel);
     }
+    apply_rate_limit();
 
+    this->m_command.vel_x = m_vel_x;
+    this->m_command.vel_y = m_vel_y;
+    this->m_command.vel_theta = m_vel_theta;
     return this->m_things;
 }
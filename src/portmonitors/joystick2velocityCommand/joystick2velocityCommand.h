@@ -17,13 +17,34 @@ class Joy2vel : public yarp::os::MonitorObject
 {
 public:
     Joy2vel();
+    virtual bool create(const yarp::os::Property& options);
+    virtual bool setparam(const yarp::os::Property& params);
+    virtual bool getparam(yarp::os::Property& params);
     virtual bool accept(yarp::os::Things& thing);
     virtual yarp::os::Things& update(yarp::os::Things& thing);
 private:
     yarp::os::Things              m_things;
     yarp::dev::MobileBaseVelocity m_command;
 
-    bool validate_bot(const yarp::os::Bottle* bot);
+    //the velocity parsed by accept(), used by the following update()
+    double                        m_vel_x = 0;
+    double                        m_vel_y = 0;
+    double                        m_vel_theta = 0;
+
+    //shaping parameters, all disabled by default
+    double                        m_max_lin_vel = 1.0;     //m/s, full scale of the deadzone and of the expo curve
+    double                        m_max_ang_vel = 30.0;    //deg/s, full scale of the deadzone and of the expo curve
+    double                        m_deadzone = 0;          //fraction of the full scale
+    double                        m_expo = 0;              //0 = linear, 1 = cubic
+    double                        m_max_lin_acc = 0;       //m/s^2, 0 = no rate limit
+    double                        m_max_ang_acc = 0;       //deg/s^2, 0 = no rate limit
+
+    //output of the previous update(), for the rate limit
+    double                        m_last_time = -1;
+
+    bool parse_bot(const yarp::os::Bottle* bot);
+    double shape(double value, double full_scale) const;
+    void apply_rate_limit();
 };
 
 #endif
@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "amcl/pf/pf_hist.h"
+#include "amcl/pf/pf_pdf.h"
+extern "C" {
+#include "amcl_reference/pf_kdtree.h"
+}
+#include <map>
+#include <set>
+#include <vector>
+
+#include <harness.h>
+
+namespace {
+
+//Three blobs, two of them bridged by a line of samples, and samples spread over the whole map
+std::vector<pf_vector_t> make_samples()
+{
+    pf_rng_t rng;
+    pf_rng_seed(&rng, 1234);
+    std::vector<pf_vector_t> samples;
+
+    const double blobs[3][4] = { { 0, 0, 0, 0.3 }, { 3, 1, 1, 0.2 }, { -2, -2, -3, 0.4 } };
+    double noise[3];
+    for (const auto& blob : blobs)
+    {
+        for (int i = 0; i < 300; i++)
+        {
+            pf_rng_gaussian_fill(&rng, noise, 3);
+            pf_vector_t pose;
+            pose.v[0] = blob[0] + blob[3] * noise[0];
+            pose.v[1] = blob[1] + blob[3] * noise[1];
+            pose.v[2] = blob[2] + 0.2 * noise[2];
+            samples.push_back(pose);
+        }
+    }
+    for (int i = 0; i <= 20; i++)
+    {
+        pf_vector_t pose;
+        pose.v[0] = i * 0.15;
+        pose.v[1] = i * 0.05;
+        pose.v[2] = i * 0.05;
+        samples.push_back(pose);
+    }
+    for (int i = 0; i < 200; i++)
+    {
+        pf_vector_t pose;
+        pose.v[0] = 20 * pf_rng_uniform(&rng) - 10;
+        pose.v[1] = 20 * pf_rng_uniform(&rng) - 10;
+        pose.v[2] = 2 * M_PI * pf_rng_uniform(&rng) - M_PI;
+        samples.push_back(pose);
+    }
+    return samples;
+}
+
+} // namespace
+
+TEST_CASE("misc::amcl_hist", "[amcl]")
+{
+    std::vector<pf_vector_t> samples = make_samples();
+    const double weight = 1.0 / samples.size();
+
+    pf_hist_t* hist = pf_hist_alloc((int)samples.size());
+    pf_kdtree_t* kdtree = pf_kdtree_alloc(3 * (int)samples.size());
+    //a cleared histogram is reused, as by the resampling
+    pf_hist_insert(hist, samples[0], 1);
+    pf_hist_clear(hist);
+    for (const auto& pose : samples)
+    {
+        pf_hist_insert(hist, pose, weight);
+        pf_kdtree_insert(kdtree, pose, weight);
+    }
+    pf_hist_cluster(hist);
+    pf_kdtree_cluster(kdtree);
+
+    SECTION("the histogram has the bins of the kd-tree")
+    {
+        CHECK(hist->bin_count == kdtree->leaf_count);
+        for (const auto& pose : samples)
+        {
+            CHECK(pf_hist_get_prob(hist, pose) == Approx(pf_kdtree_get_prob(kdtree, pose)));
+        }
+    }
+
+    SECTION("the clusters of the histogram are the clusters of the kd-tree")
+    {
+        //the labels are numbered in a different order: they must match one to one
+        std::map<int, int> hist_to_kdtree;
+        std::map<int, int> kdtree_to_hist;
+        std::set<int> labels;
+        for (const auto& pose : samples)
+        {
+            int h = pf_hist_get_cluster(hist, pose);
+            int k = pf_kdtree_get_cluster(kdtree, pose);
+            REQUIRE(h >= 0);
+            REQUIRE(h < hist->cluster_count);
+            REQUIRE(k >= 0);
+            auto hk = hist_to_kdtree.emplace(h, k).first;
+            auto kh = kdtree_to_hist.emplace(k, h).first;
+            CHECK(hk->second == k);
+            CHECK(kh->second == h);
+            labels.insert(h);
+        }
+        CHECK((int)labels.size() == hist->cluster_count);
+
+        //the bridged blobs are one cluster, the third blob is another one
+        pf_vector_t a = { { 0, 0, 0 } };
+        pf_vector_t b = { { 3, 1, 1 } };
+        pf_vector_t c = { { -2, -2, -3 } };
+        CHECK(pf_hist_get_cluster(hist, a) == pf_hist_get_cluster(hist, b));
+        CHECK(pf_hist_get_cluster(hist, a) != pf_hist_get_cluster(hist, c));
+        CHECK(hist->cluster_count > 2);
+    }
+
+    pf_kdtree_free(kdtree);
+    pf_hist_free(hist);
+}
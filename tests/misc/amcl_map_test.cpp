@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "amcl/map/map.h"
+#include <cmath>
+#include <cstdlib>
+
+#include <harness.h>
+
+namespace {
+
+//A 4m x 3m room, 5cm cells, with a pillar and an unknown area
+map_t* make_map()
+{
+    map_t* map = map_alloc();
+    map->scale = 0.05;
+    map->size_x = 80;
+    map->size_y = 60;
+    map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * map->size_x * map->size_y);
+    for (int j = 0; j < map->size_y; j++)
+    {
+        for (int i = 0; i < map->size_x; i++)
+        {
+            int state = -1;
+            if (i == 0 || j == 0 || i == map->size_x - 1 || j == map->size_y - 1) state = 1;
+            if (i >= 50 && i < 55 && j >= 20 && j < 28) state = 1;
+            if (i >= 10 && i < 20 && j >= 40 && j < 50) state = 0;
+            map->cells[MAP_INDEX(map, i, j)].occ_state = state;
+            map->cells[MAP_INDEX(map, i, j)].occ_dist = 0;
+        }
+    }
+    return map;
+}
+
+} // namespace
+
+TEST_CASE("misc::amcl_map_range", "[amcl]")
+{
+    map_t* map = make_map();
+    const int angles = 360;
+    REQUIRE(map_build_range_table(map, angles) == 0);
+    const double max_range = 10;
+
+    SECTION("the precomputed ranges match the ray casting")
+    {
+        //the lookup and the Bresenham walk cross the cells differently by a fraction of a cell:
+        //at grazing angles, or next to a corner, this can move the hit by several cells
+        int count = 0;
+        int within_one_cell = 0;
+        int within_two_cells = 0;
+        for (double y = -1.3; y <= 1.3; y += 0.23)
+        {
+            for (double x = -1.8; x <= 1.8; x += 0.31)
+            {
+                map_cell_t* cell = map_get_cell(map, x, y, 0);
+                if (cell == nullptr || cell->occ_state != -1) continue;
+                for (int a = 0; a < angles; a++)
+                {
+                    //the table directions, so that the lookup does not quantize the angle
+                    double oa = a * 2 * M_PI / angles - M_PI;
+                    double error = fabs(map_lookup_range(map, x, y, oa, max_range) - map_calc_range(map, x, y, oa, max_range));
+                    //perpendicular to the walls
+                    if (a % (angles / 4) == 0)
+                    {
+                        CHECK(error <= 0.5 * map->scale);
+                    }
+                    if (error <= map->scale) within_one_cell++;
+                    if (error <= 2 * map->scale) within_two_cells++;
+                    count++;
+                }
+            }
+        }
+        REQUIRE(count > 0);
+        CHECK(within_one_cell >= 0.9 * count);
+        CHECK(within_two_cells >= 0.97 * count);
+    }
+
+    SECTION("the ranges are limited to the max range")
+    {
+        CHECK(map_calc_range(map, 0, 0, 0, 0.5) == 0.5);
+        CHECK(map_lookup_range(map, 0, 0, 0, 0.5) == 0.5);
+    }
+
+    SECTION("a ray starting from a non free cell has zero range")
+    {
+        //on the pillar, and in the unknown area
+        CHECK(map_calc_range(map, 0.6, -0.4, 0, max_range) == 0);
+        CHECK(map_lookup_range(map, 0.6, -0.4, 0, max_range) == 0);
+        CHECK(map_calc_range(map, -1.25, 0.75, 0, max_range) == 0);
+        CHECK(map_lookup_range(map, -1.25, 0.75, 0, max_range) == 0);
+    }
+
+    map_free(map);
+}
@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "amcl/pf/pf.h"
+#include "amcl/pf/pf_pdf.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <harness.h>
+
+namespace {
+
+//A random pose drawn from the filter generator, in a 10m x 10m square
+pf_vector_t random_pose(void*, pf_rng_t* rng)
+{
+    pf_vector_t pose;
+    pose.v[0] = 10 * pf_rng_uniform(rng) - 5;
+    pose.v[1] = 10 * pf_rng_uniform(rng) - 5;
+    pose.v[2] = 2 * M_PI * pf_rng_uniform(rng) - M_PI;
+    return pose;
+}
+
+//Weights the samples by their distance from the origin
+double sensor_model(void*, pf_sample_set_t* set)
+{
+    double total = 0;
+    for (int i = 0; i < set->sample_count; i++)
+    {
+        double d2 = set->poses[0][i] * set->poses[0][i] + set->poses[1][i] * set->poses[1][i];
+        set->weights[i] = exp(-d2);
+        total += set->weights[i];
+    }
+    return total;
+}
+
+//Runs a few sensor updates and resamplings of a filter seeded with [seed]
+pf_t* run_filter(uint64_t seed, pf_resample_type_t type)
+{
+    pf_t* pf = pf_alloc(100, 1000, 0.001, 0.1, random_pose, nullptr);
+    pf->resample_type = type;
+    pf_set_seed(pf, seed);
+
+    pf_vector_t mean = pf_vector_zero();
+    mean.v[0] = 0.5;
+    pf_matrix_t cov = pf_matrix_zero();
+    cov.m[0][0] = 0.5;
+    cov.m[1][1] = 0.5;
+    cov.m[2][2] = 0.1;
+    pf_init(pf, mean, cov);
+
+    for (int k = 0; k < 5; k++)
+    {
+        pf_update_sensor(pf, sensor_model, nullptr);
+        //the long term average above the short term one adds random poses
+        pf->w_slow = 2 * pf->w_fast;
+        pf_update_resample(pf);
+    }
+    return pf;
+}
+
+bool same_samples(const pf_sample_set_t* a, const pf_sample_set_t* b)
+{
+    if (a->sample_count != b->sample_count) return false;
+    size_t size = a->sample_count * sizeof(double);
+    for (int k = 0; k < 3; k++)
+    {
+        if (memcmp(a->poses[k], b->poses[k], size) != 0) return false;
+    }
+    return memcmp(a->weights, b->weights, size) == 0;
+}
+
+//Resamples [weights] into a set of [count] samples, and counts the copies of each sample
+std::vector<int> resample_copies(pf_resample_type_t type, uint64_t seed, const std::vector<double>& weights, int count)
+{
+    //min_samples = max_samples: the KLD sampling keeps all the drawn ancestors
+    pf_t* pf = pf_alloc(count, count, 0.001, 0.1, random_pose, nullptr);
+    pf->resample_type = type;
+    pf_set_seed(pf, seed);
+    //no random poses
+    pf->w_slow = pf->w_fast = 1;
+
+    //the sample i is at x = i
+    pf_sample_set_t* set = pf->sets + pf->current_set;
+    set->sample_count = (int)weights.size();
+    for (int i = 0; i < set->sample_count; i++)
+    {
+        pf_vector_t pose = pf_vector_zero();
+        pose.v[0] = i;
+        pf_sample_put_pose(set, i, pose);
+        set->weights[i] = weights[i];
+    }
+
+    pf_update_resample(pf);
+
+    std::vector<int> copies(weights.size(), 0);
+    set = pf->sets + pf->current_set;
+    for (int i = 0; i < set->sample_count; i++)
+    {
+        copies[(size_t)set->poses[0][i]]++;
+    }
+    pf_free(pf);
+    return copies;
+}
+
+} // namespace
+
+TEST_CASE("misc::amcl_pf", "[amcl]")
+{
+    const pf_resample_type_t types[3] = { PF_RESAMPLE_SYSTEMATIC, PF_RESAMPLE_STRATIFIED, PF_RESAMPLE_RESIDUAL };
+
+    SECTION("two filters with the same seed give the same samples")
+    {
+        for (auto type : types)
+        {
+            pf_t* a = run_filter(42, type);
+            pf_t* b = run_filter(42, type);
+            pf_t* c = run_filter(43, type);
+            CHECK(same_samples(a->sets + a->current_set, b->sets + b->current_set));
+            CHECK_FALSE(same_samples(a->sets + a->current_set, c->sets + c->current_set));
+            pf_free(a);
+            pf_free(b);
+            pf_free(c);
+        }
+    }
+
+    SECTION("every strategy gives count * weight copies when they are integers")
+    {
+        //exactly representable weights and cumulative sums
+        const std::vector<double> weights = { 0.5, 0.25, 0, 0.125, 0.125 };
+        const std::vector<int> expected = { 8, 4, 0, 2, 2 };
+        for (auto type : types)
+        {
+            for (uint64_t seed = 1; seed <= 20; seed++)
+            {
+                CHECK(resample_copies(type, seed, weights, 16) == expected);
+            }
+        }
+    }
+
+    SECTION("the systematic and residual strategies give the floor or the ceil of count * weight")
+    {
+        const std::vector<double> weights = { 0.37, 0.05, 0.21, 0.3, 0.07 };
+        const int count = 50;
+        for (auto type : { PF_RESAMPLE_SYSTEMATIC, PF_RESAMPLE_RESIDUAL })
+        {
+            for (uint64_t seed = 1; seed <= 50; seed++)
+            {
+                std::vector<int> copies = resample_copies(type, seed, weights, count);
+                for (size_t i = 0; i < weights.size(); i++)
+                {
+                    double expected = count * weights[i];
+                    CHECK(copies[i] >= floor(expected) - 1e-9);
+                    CHECK(copies[i] <= ceil(expected) + 1e-9);
+                }
+            }
+        }
+    }
+}
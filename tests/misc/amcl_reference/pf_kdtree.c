@@ -20,6 +20,8 @@
  */
 /**************************************************************************
  * Desc: kd-tree functions
+ *       The original amcl histogram, replaced by pf_hist.c: kept only as
+ *       the reference of the clustering in amcl_hist_test.cpp.
  * Author: Andrew Howard
  * Date: 18 Dec 2002
  * CVS: $Id: pf_kdtree.c 7057 2008-10-02 00:44:06Z gbiggs $
@@ -32,7 +34,7 @@
 
 
 #include "amcl/pf/pf_vector.h"
-#include "amcl/pf/pf_kdtree.h"
+#include "pf_kdtree.h"
 
 
 // Compare keys to see if they are equal
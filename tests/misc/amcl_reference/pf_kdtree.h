@@ -20,6 +20,8 @@
  */
 /**************************************************************************
  * Desc: KD tree functions
+ *       The original amcl histogram, replaced by pf_hist.h: kept only as
+ *       the reference of the clustering in amcl_hist_test.cpp.
  * Author: Andrew Howard
  * Date: 18 Dec 2002
  * CVS: $Id: pf_kdtree.h 6532 2008-06-11 02:45:56Z gbiggs $
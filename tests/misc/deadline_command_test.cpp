@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <deadline_command.h>
+#include <limits>
+
+#include <harness.h>
+
+TEST_CASE("misc::deadline_command", "[navigation_lib]")
+{
+    deadline_command channel;
+    deadline_command_reader reader;
+    deadline_command_data cmd;
+
+    SECTION("the reader reports each command once, and its expiry once")
+    {
+        CHECK(reader.poll(channel, 10.0, cmd) == DEADLINE_EMPTY);
+
+        REQUIRE(channel.post(0.1, 0.2, 5, 1.0, 10.0));
+        CHECK(reader.poll(channel, 10.5, cmd) == DEADLINE_CHANGED);
+        CHECK(cmd.x_vel == 0.1);
+        CHECK(cmd.y_vel == 0.2);
+        CHECK(cmd.theta_vel == 5);
+        CHECK(cmd.timestamp == 10.0);
+        CHECK(cmd.expiry == 11.0);
+        CHECK(cmd.sequence == 1);
+        CHECK(reader.poll(channel, 10.6, cmd) == DEADLINE_UNCHANGED);
+        CHECK(reader.poll(channel, 11.0, cmd) == DEADLINE_EXPIRED);
+        CHECK(reader.poll(channel, 11.1, cmd) == DEADLINE_STALE);
+        CHECK(reader.poll(channel, 12.0, cmd) == DEADLINE_STALE);
+
+        REQUIRE(channel.post(0.3, 0, 0, 1.0, 12.0));
+        CHECK(reader.poll(channel, 12.1, cmd) == DEADLINE_CHANGED);
+        CHECK(cmd.x_vel == 0.3);
+        CHECK(cmd.sequence == 2);
+        CHECK(channel.sequence() == 2);
+    }
+
+    SECTION("a command posted with an infinite timeout never expires")
+    {
+        REQUIRE(channel.post(0.1, 0, 0, std::numeric_limits<double>::infinity(), 10.0));
+        CHECK(reader.poll(channel, 10.0, cmd) == DEADLINE_CHANGED);
+        CHECK(reader.poll(channel, 1e9, cmd) == DEADLINE_UNCHANGED);
+    }
+
+    SECTION("after reset() the current command is reported again")
+    {
+        REQUIRE(channel.post(0.1, 0, 0, 1.0, 10.0));
+        CHECK(reader.poll(channel, 10.0, cmd) == DEADLINE_CHANGED);
+        reader.reset();
+        CHECK(reader.poll(channel, 10.1, cmd) == DEADLINE_CHANGED);
+        CHECK(reader.poll(channel, 11.5, cmd) == DEADLINE_EXPIRED);
+        reader.reset();
+        CHECK(reader.poll(channel, 11.6, cmd) == DEADLINE_EXPIRED);
+    }
+
+    SECTION("each reader keeps its own state")
+    {
+        deadline_command_reader other;
+        REQUIRE(channel.post(0.1, 0, 0, 1.0, 10.0));
+        CHECK(reader.poll(channel, 10.0, cmd) == DEADLINE_CHANGED);
+        CHECK(other.poll(channel, 10.0, cmd) == DEADLINE_CHANGED);
+        CHECK(reader.poll(channel, 10.1, cmd) == DEADLINE_UNCHANGED);
+    }
+}
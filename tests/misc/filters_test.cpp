@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <filters.h>
+#include <math.h>
+
+#include <harness.h>
+
+using namespace control_filters;
+
+namespace {
+
+//The low pass filters used before lp_filter, with the coefficients hard coded for a sampling frequency of 50Hz (20ms)
+struct old_lp_filter
+{
+    double gain;
+    double pole;
+    double xv[2] = { 0, 0 };
+    double yv[2] = { 0, 0 };
+
+    double filter(double input)
+    {
+        xv[0] = xv[1];
+        xv[1] = input / gain;
+        yv[0] = yv[1];
+        yv[1] = (xv[0] + xv[1]) + (pole * yv[0]);
+        return yv[1];
+    }
+};
+
+//The rate limiter used before ratelim_filter, the rates are given per step
+struct old_ratelim_filter
+{
+    double prev = 0;
+
+    double filter(double input, double rate_pos, double rate_neg, double max_val, double min_val)
+    {
+        if (prev > max_val) prev = max_val;
+        if (prev < min_val) prev = min_val;
+        double rate;
+        if (input * prev >= 0)
+        {
+            if (input == 0) rate = rate_neg;
+            else rate = (fabs(input) > fabs(prev)) ? rate_pos : rate_neg;
+        }
+        else
+        {
+            rate = (input > 0) ? rate_pos : rate_neg;
+        }
+        if (fabs(input - prev) > rate) prev = (input > prev) ? prev + rate : prev - rate;
+        else prev = input;
+        return prev;
+    }
+};
+
+//steps, ramps and sign changes
+double test_input(int i)
+{
+    if (i < 50)  return 1.0;
+    if (i < 100) return -0.5;
+    if (i < 150) return 0.02 * (i - 100);
+    if (i < 200) return 0;
+    return sin(0.3 * i);
+}
+
+} // namespace
+
+TEST_CASE("misc::baseControl2_filters", "[baseControl2]")
+{
+    const double period = 0.02;
+
+    SECTION("lp_filter at 20ms gives the output of the 50Hz filters")
+    {
+        const double cutoff[5] = { 0.5, 1, 2, 4, 8 };
+        const double gain[5] = { 3.282051595e+01, 1.689454484e+01, 8.915815088e+00, 4.894742855e+00, 2.818993247e+00 };
+        const double pole[5] = { 0.9390625058, 0.8816185924, 0.7756795110, 0.5913983514, 0.2905268567 };
+        for (size_t f = 0; f < 5; f++)
+        {
+            lp_filter filter;
+            REQUIRE(filter.set(cutoff[f], period));
+            old_lp_filter old = { gain[f], pole[f] };
+            for (int i = 0; i < 300; i++)
+            {
+                double in = test_input(i);
+                CHECK(fabs(filter.filter(in) - old.filter(in)) < 1e-8);
+            }
+        }
+    }
+
+    SECTION("lp_filter_multi filters each channel as lp_filter")
+    {
+        lp_filter_multi multi(3);
+        lp_filter single[3];
+        REQUIRE(multi.set(4, period));
+        for (size_t c = 0; c < 3; c++)
+        {
+            REQUIRE(single[c].set(4, period));
+        }
+        for (int i = 0; i < 300; i++)
+        {
+            double data[3] = { test_input(i), -test_input(i), test_input(i + 20) };
+            double expected[3];
+            for (size_t c = 0; c < 3; c++)
+            {
+                expected[c] = single[c].filter(data[c]);
+            }
+            multi.filter(data);
+            for (size_t c = 0; c < 3; c++)
+            {
+                CHECK(data[c] == expected[c]);
+            }
+        }
+    }
+
+    SECTION("lp_filter refuses a cut off frequency not below the Nyquist frequency")
+    {
+        lp_filter filter;
+        CHECK_FALSE(filter.set(25, period));
+        CHECK_FALSE(filter.is_enabled());
+        CHECK(filter.filter(3.0) == 3.0);
+        CHECK(filter.set(0, period));
+        CHECK_FALSE(filter.is_enabled());
+    }
+
+    SECTION("ratelim_filter at 20ms gives the output of the per step rate limiter")
+    {
+        const double rate_pos = 2.5;   //units/s
+        const double rate_neg = 5.0;   //units/s
+        ratelim_filter filter;
+        old_ratelim_filter old;
+        for (int i = 0; i < 300; i++)
+        {
+            double in = test_input(i);
+            double out = filter.filter(in, rate_pos, rate_neg, 0.8, -0.8, period);
+            double out_old = old.filter(in, rate_pos * period, rate_neg * period, 0.8, -0.8);
+            CHECK(fabs(out - out_old) < 1e-9);
+        }
+    }
+
+    SECTION("jerk_filter respects the velocity, acceleration and jerk limits")
+    {
+        const double acc_pos = 0.5;
+        const double acc_neg = 1.0;
+        const double max_vel = 0.8;
+        //the second case has jerk*period larger than the acceleration limits
+        const double jerk[2] = { 2.0, 60.0 };
+        const double jerk_period[2] = { 0.02, 0.05 };
+        for (size_t c = 0; c < 2; c++)
+        {
+            const double p = jerk_period[c];
+            jerk_filter filter;
+            double vel_prev = 0;
+            double acc_prev = 0;
+            bool reached = false;
+            for (int i = 0; i < 1000; i++)
+            {
+                //a reference above the maximum velocity, then back to zero
+                double ref = (i < 500) ? 1.0 : 0.0;
+                double vel = filter.filter(ref, acc_pos, acc_neg, jerk[c], max_vel, -max_vel, p);
+                double acc = (vel - vel_prev) / p;
+                CHECK(vel <= max_vel + 1e-9);
+                CHECK(vel >= -1e-9);
+                CHECK(fabs(acc) <= acc_neg + 1e-6);
+                if (i < 500) CHECK(acc <= acc_pos + 1e-6);
+                CHECK(fabs(acc - acc_prev) <= jerk[c] * p + 1e-6);
+                if (i == 499) reached = (fabs(vel - max_vel) < 1e-9);
+                vel_prev = vel;
+                acc_prev = acc;
+            }
+            CHECK(reached);
+            CHECK(fabs(vel_prev) < 1e-9);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <input.h>
+#include <inputMailbox.h>
+#include <velocity_shm.h>
+#include <yarp/os/Time.h>
+#include <string>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <harness.h>
+
+namespace {
+
+//An Input with one mailbox without the nws, or with one shared memory segment
+class InputTest : public Input
+{
+public:
+    InputMailbox mailbox;
+
+    InputTest(double max_timeout, double hold_time, const std::string& shm_name = "")
+    {
+        inputManager in;
+        in.m_name = "test";
+        in.m_max_timeout = max_timeout;
+        in.m_hold_time = hold_time;
+        if (shm_name.empty())
+        {
+            in.m_mailbox = &mailbox;
+        }
+        else
+        {
+            //deleted by close()
+            in.m_shm = new velocity_shm();
+            in.m_shm->open(shm_name);
+        }
+        m_input.push_back(in);
+    }
+};
+
+} // namespace
+
+TEST_CASE("misc::baseControl2_input", "[baseControl2]")
+{
+    //the outputs still hold the command of the previous cycle
+    double linear_speed = 1;
+    double angular_speed = 10;
+    double desired_direction = 45;
+    double pwm_gain = 100;
+
+    SECTION("without commands the speed is zero")
+    {
+        InputTest input(0.1, 0);
+        input.read_inputs(linear_speed, angular_speed, desired_direction, pwm_gain);
+        CHECK(linear_speed == 0);
+        CHECK(angular_speed == 0);
+        CHECK(desired_direction == 0);
+        CHECK(pwm_gain == 0);
+    }
+
+    SECTION("an expired command gives zero speed")
+    {
+        const double hold_time[2] = { 0, 0.1 };
+        for (size_t h = 0; h < 2; h++)
+        {
+            InputTest input(0.05, hold_time[h]);
+            REQUIRE(input.mailbox.applyVelocityCommand(0.3, 0, 5, 0.05));
+            input.read_inputs(linear_speed, angular_speed, desired_direction, pwm_gain);
+            CHECK(fabs(linear_speed - 0.3) < 1e-9);
+            CHECK(angular_speed == 5);
+            CHECK(pwm_gain == 100);
+
+            //expired, within the hold time (if any)
+            yarp::os::Time::delay(0.08);
+            linear_speed = 1;
+            angular_speed = 10;
+            input.read_inputs(linear_speed, angular_speed, desired_direction, pwm_gain);
+            CHECK(linear_speed == 0);
+            CHECK(angular_speed == 0);
+
+            //expired, after the hold time
+            yarp::os::Time::delay(0.15);
+            linear_speed = 1;
+            angular_speed = 10;
+            pwm_gain = 100;
+            input.read_inputs(linear_speed, angular_speed, desired_direction, pwm_gain);
+            CHECK(linear_speed == 0);
+            CHECK(angular_speed == 0);
+            CHECK(pwm_gain == 0);
+        }
+    }
+
+#if !defined(_WIN32)
+    SECTION("an expired command of a shared memory input gives zero speed")
+    {
+        const std::string name = "/navigation_test_input_shm_" + std::to_string(getpid());
+        shm_unlink(name.c_str());
+        {
+            InputTest input(0.05, 0, name);
+            velocity_shm writer;
+            REQUIRE(writer.open(name));
+            REQUIRE(writer.write(0.3, 0, 5));
+            input.read_inputs(linear_speed, angular_speed, desired_direction, pwm_gain);
+            CHECK(fabs(linear_speed - 0.3) < 1e-9);
+            CHECK(angular_speed == 5);
+
+            yarp::os::Time::delay(0.08);
+            input.read_inputs(linear_speed, angular_speed, desired_direction, pwm_gain);
+            CHECK(linear_speed == 0);
+            CHECK(angular_speed == 0);
+            CHECK(pwm_gain == 0);
+        }
+        shm_unlink(name.c_str());
+    }
+#endif
+}
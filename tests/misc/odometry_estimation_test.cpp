@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <localization_device_with_estimated_odometry.h>
+#include <cmath>
+
+#include <harness.h>
+
+using yarp::dev::Nav2D::Map2DLocation;
+
+namespace {
+
+//Irregular sampling, between 10ms and 50ms
+double sample_period(int i)
+{
+    return 0.01 + 0.01 * (i % 5);
+}
+
+Map2DLocation make_loc(double x, double y, double theta)
+{
+    Map2DLocation loc;
+    loc.map_id = "map";
+    loc.x = x;
+    loc.y = y;
+    loc.theta = theta;
+    return loc;
+}
+
+} // namespace
+
+TEST_CASE("misc::velocity_filter_1d", "[navigation_lib]")
+{
+    velocity_filter_1d filter;
+    filter.meas_var = 1e-4;
+    filter.acc_var = 4;
+
+    SECTION("reset starts from the measured position, at rest")
+    {
+        filter.vel = 3;
+        filter.reset(2.5);
+        CHECK(filter.pos == 2.5);
+        CHECK(filter.vel == 0);
+        CHECK(filter.P[0][0] == filter.meas_var);
+        CHECK(filter.P[0][1] == 0);
+        CHECK(filter.P[1][1] == filter.acc_var);
+    }
+
+    SECTION("predict moves the position with the velocity, and increases the uncertainty")
+    {
+        filter.reset(1);
+        filter.vel = 2;
+        double p00 = filter.P[0][0];
+        filter.predict(0.5);
+        CHECK(filter.pos == Approx(2));
+        CHECK(filter.vel == 2);
+        CHECK(filter.P[0][0] > p00);
+        CHECK(filter.P[0][1] == filter.P[1][0]);
+    }
+
+    SECTION("the velocity of a constant velocity motion is found with irregular sampling")
+    {
+        const double vel = 0.7;
+        double t = 0;
+        filter.reset(0);
+        for (int i = 0; i < 200; i++)
+        {
+            double dt = sample_period(i);
+            t += dt;
+            filter.predict(dt);
+            filter.update(vel * t - filter.pos);
+            CHECK(filter.P[0][0] > 0);
+            CHECK(filter.P[1][1] > 0);
+            CHECK(filter.P[0][0] * filter.P[1][1] >= filter.P[0][1] * filter.P[0][1]);
+        }
+        CHECK(filter.vel == Approx(vel).margin(1e-3));
+        CHECK(filter.pos == Approx(vel * t).margin(1e-3));
+    }
+
+    SECTION("a zero residual leaves the state unchanged")
+    {
+        filter.reset(1);
+        filter.vel = 0.5;
+        filter.update(0);
+        CHECK(filter.pos == 1);
+        CHECK(filter.vel == 0.5);
+    }
+}
+
+TEST_CASE("misc::estimated_odometry", "[navigation_lib]")
+{
+    localization_device_with_estimated_odometry estimator;
+
+    SECTION("the velocity is estimated with the given timestamps, in the world and in the robot frame")
+    {
+        //moving along y at 0.4 m/s, rotating at 20 deg/s across +-180 deg
+        double t = 1000;
+        yarp::dev::OdometryData odom;
+        for (int i = 0; i < 200; i++)
+        {
+            double theta = 170 + 20 * (t - 1000);
+            odom = estimator.estimateOdometry(make_loc(1, 0.4 * (t - 1000), remainder(theta, 360.0)), t);
+            t += sample_period(i);
+        }
+        CHECK(odom.odom_vel_x == Approx(0).margin(1e-3));
+        CHECK(odom.odom_vel_y == Approx(0.4).margin(1e-3));
+        CHECK(odom.odom_vel_theta == Approx(20).margin(0.1));
+        double theta = odom.odom_theta * M_PI / 180;
+        CHECK(odom.base_vel_x == Approx(0.4 * sin(theta)).margin(1e-3));
+        CHECK(odom.base_vel_y == Approx(0.4 * cos(theta)).margin(1e-3));
+    }
+
+    SECTION("the estimation restarts after a gap, or when time goes back")
+    {
+        double t = 1000;
+        yarp::dev::OdometryData odom;
+        for (int i = 0; i < 50; i++)
+        {
+            odom = estimator.estimateOdometry(make_loc(0.5 * (t - 1000), 0, 0), t);
+            t += 0.02;
+        }
+        CHECK(odom.odom_vel_x == Approx(0.5).margin(1e-2));
+
+        odom = estimator.estimateOdometry(make_loc(5, 0, 0), t + 2);
+        CHECK(odom.odom_vel_x == 0);
+
+        estimator.estimateOdometry(make_loc(5.01, 0, 0), t + 2.02);
+        odom = estimator.estimateOdometry(make_loc(5, 0, 0), t);
+        CHECK(odom.odom_vel_x == 0);
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <pose_cell.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <harness.h>
+
+using yarp::dev::Nav2D::Map2DLocation;
+
+namespace {
+
+Map2DLocation make_loc(const std::string& map_id, double x, double y, double theta)
+{
+    Map2DLocation loc;
+    loc.map_id = map_id;
+    loc.x = x;
+    loc.y = y;
+    loc.theta = theta;
+    return loc;
+}
+
+} // namespace
+
+TEST_CASE("misc::pose_cell", "[navigation_lib]")
+{
+    pose_cell cell;
+    pose_cell_snapshot snapshot;
+    Map2DLocation loc;
+
+    SECTION("nothing is read before the first publish")
+    {
+        CHECK(cell.sequence() == 0);
+        CHECK_FALSE(cell.read(snapshot));
+        CHECK_FALSE(cell.read(loc));
+        CHECK_FALSE(cell.readIfNewer(0, snapshot));
+        CHECK(cell.age(10) < 0);
+    }
+
+    SECTION("the pose and the covariance are read as published")
+    {
+        const double cov[9] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+        cell.publish(make_loc("map_1", 1.5, -2, 90), cov, 100);
+        REQUIRE(cell.read(snapshot));
+        CHECK(snapshot.loc.map_id == "map_1");
+        CHECK(snapshot.loc.x == 1.5);
+        CHECK(snapshot.loc.y == -2);
+        CHECK(snapshot.loc.theta == 90);
+        CHECK(snapshot.timestamp == 100);
+        for (size_t i = 0; i < 9; i++)
+        {
+            CHECK(snapshot.cov[i] == cov[i]);
+        }
+        CHECK(snapshot.sequence == 1);
+        CHECK(cell.age(100.5) == Approx(0.5));
+
+        yarp::sig::Matrix m;
+        REQUIRE(cell.read(loc, m));
+        CHECK(loc.map_id == "map_1");
+        REQUIRE(m.rows() == 3);
+        REQUIRE(m.cols() == 3);
+        CHECK(m[1][2] == 6);
+
+        //without covariance it is zero
+        cell.publish(make_loc("map_2", 0, 0, 0), 101);
+        REQUIRE(cell.read(snapshot));
+        CHECK(snapshot.loc.map_id == "map_2");
+        CHECK(snapshot.cov[0] == 0);
+        CHECK(snapshot.sequence == 2);
+    }
+
+    SECTION("a map name longer than the buffer is truncated")
+    {
+        std::string long_name(pose_cell::POSE_CELL_MAP_ID_SIZE + 10, 'a');
+        cell.publish(make_loc(long_name, 0, 0, 0), 1);
+        REQUIRE(cell.read(loc));
+        CHECK(loc.map_id == long_name.substr(0, pose_cell::POSE_CELL_MAP_ID_SIZE - 1));
+    }
+
+    SECTION("readIfNewer reads each pose once")
+    {
+        cell.publish(make_loc("map", 1, 0, 0), 1);
+        REQUIRE(cell.readIfNewer(0, snapshot));
+        CHECK(snapshot.loc.x == 1);
+        uint64_t last = snapshot.sequence;
+        CHECK_FALSE(cell.readIfNewer(last, snapshot));
+
+        cell.publish(make_loc("map", 2, 0, 0), 2);
+        cell.publish(make_loc("map", 3, 0, 0), 3);
+        CHECK(cell.sequence() == last + 2);
+        //only the latest pose is kept
+        REQUIRE(cell.readIfNewer(last, snapshot));
+        CHECK(snapshot.loc.x == 3);
+        CHECK(snapshot.sequence == last + 2);
+        CHECK_FALSE(cell.readIfNewer(snapshot.sequence, snapshot));
+    }
+
+    SECTION("a reader never sees a pose written in part")
+    {
+        //every published pose has x == y == theta == timestamp
+        std::atomic<bool> done(false);
+        std::thread writer([&]() {
+            for (int i = 1; i <= 20000; i++)
+            {
+                cell.publish(make_loc("map", i, i, i), i);
+            }
+            done = true;
+        });
+        uint64_t last = 0;
+        size_t torn = 0;
+        size_t backwards = 0;
+        while (!done)
+        {
+            if (cell.readIfNewer(last, snapshot))
+            {
+                if (snapshot.loc.x != snapshot.loc.y || snapshot.loc.x != snapshot.loc.theta || snapshot.loc.x != snapshot.timestamp) torn++;
+                if (snapshot.sequence <= last) backwards++;
+                last = snapshot.sequence;
+            }
+        }
+        writer.join();
+        CHECK(torn == 0);
+        CHECK(backwards == 0);
+        REQUIRE(cell.read(snapshot));
+        CHECK(snapshot.loc.x == 20000);
+        CHECK(snapshot.sequence == 20000);
+    }
+}
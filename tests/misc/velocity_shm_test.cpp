@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Istituto Italiano di Tecnologia (IIT)
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <velocity_shm.h>
+#include <yarp/os/Time.h>
+#include <atomic>
+#include <string>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <harness.h>
+
+#if !defined(_WIN32)
+
+namespace {
+
+//The layout of the segment: version, sequence, 5 words
+struct raw_segment
+{
+    std::atomic<uint64_t> version;
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> data[5];
+};
+
+//Maps the segment as a writer which dies in the middle of a write would see it
+raw_segment* map_raw(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return nullptr;
+    void* p = mmap(nullptr, sizeof(raw_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    return (p == MAP_FAILED) ? nullptr : static_cast<raw_segment*>(p);
+}
+
+} // namespace
+
+TEST_CASE("misc::velocity_shm", "[navigation_lib]")
+{
+    const std::string name = "/navigation_test_velocity_shm_" + std::to_string(getpid());
+    shm_unlink(name.c_str());
+
+    velocity_shm writer;
+    velocity_shm reader;
+    velocity_shm_command cmd;
+
+    SECTION("a command written to the segment is read through another mapping")
+    {
+        REQUIRE(reader.open(name));
+        REQUIRE(writer.open(name));
+        CHECK_FALSE(reader.read(cmd));
+        CHECK(reader.sequence() == 0);
+
+        double before = yarp::os::Time::now();
+        REQUIRE(writer.write(0.1, -0.2, 5, 0.3));
+        REQUIRE(reader.read(cmd));
+        CHECK(cmd.x_vel == 0.1);
+        CHECK(cmd.y_vel == -0.2);
+        CHECK(cmd.theta_vel == 5);
+        CHECK(cmd.timeout == 0.3);
+        CHECK(cmd.timestamp >= before);
+        CHECK(cmd.timestamp <= yarp::os::Time::now());
+        CHECK(cmd.sequence == 1);
+
+        REQUIRE(writer.write(0, 0, 0));
+        REQUIRE(reader.read(cmd));
+        CHECK(cmd.x_vel == 0);
+        CHECK(cmd.sequence == 2);
+        CHECK(reader.sequence() == 2);
+    }
+
+    SECTION("the segment is kept when it is closed")
+    {
+        REQUIRE(writer.open(name));
+        REQUIRE(writer.write(0.1, 0, 0, 0.3));
+        writer.close();
+        CHECK_FALSE(writer.write(0.1, 0, 0, 0.3));
+        REQUIRE(reader.open(name));
+        REQUIRE(reader.read(cmd));
+        CHECK(cmd.x_vel == 0.1);
+    }
+
+    SECTION("a segment left locked by a dead writer fails at once and it is recovered by open()")
+    {
+        REQUIRE(writer.open(name));
+        REQUIRE(reader.open(name));
+        REQUIRE(writer.write(0.1, 0, 0, 0.3));
+        raw_segment* raw = map_raw(name);
+        REQUIRE(raw != nullptr);
+        raw->seq.fetch_add(1);
+
+        double start = yarp::os::Time::now();
+        CHECK_FALSE(reader.read(cmd));
+        CHECK_FALSE(writer.write(0.2, 0, 0, 0.3));
+        CHECK(yarp::os::Time::now() - start < 0.05);
+
+        velocity_shm other;
+        REQUIRE(other.open(name));
+        REQUIRE(reader.read(cmd));
+        CHECK(cmd.x_vel == 0);
+        CHECK(cmd.timestamp == 0);
+        REQUIRE(writer.write(0.2, 0, 0, 0.3));
+        REQUIRE(reader.read(cmd));
+        CHECK(cmd.x_vel == 0.2);
+        munmap(raw, sizeof(raw_segment));
+    }
+
+    writer.close();
+    reader.close();
+    shm_unlink(name.c_str());
+}
+
+#endif